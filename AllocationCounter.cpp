@@ -0,0 +1,74 @@
+#include "AllocationCounter.h"
+
+#ifdef RASTERIZER_COUNT_ALLOCATIONS
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	std::atomic<uint64_t> g_NrAllocations{};
+
+	void* AllocateCounted(size_t size, size_t alignment)
+	{
+		g_NrAllocations.fetch_add(1, std::memory_order_relaxed);
+		if (size == 0) size = 1;
+
+		void* pMemory{};
+		if (alignment <= alignof(std::max_align_t))
+		{
+			pMemory = std::malloc(size);
+		}
+		else
+		{
+#ifdef _WIN32
+			pMemory = _aligned_malloc(size, alignment);
+#else
+			//aligned_alloc wants a multiple of the alignment
+			pMemory = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+		}
+
+		if (!pMemory) throw std::bad_alloc{};
+		return pMemory;
+	}
+
+	void FreeCounted(void* pMemory, size_t alignment)
+	{
+#ifdef _WIN32
+		if (alignment > alignof(std::max_align_t))
+		{
+			_aligned_free(pMemory);
+			return;
+		}
+#else
+		(void)alignment;
+#endif
+		std::free(pMemory);
+	}
+}
+
+//The array and nothrow forms forward to these
+void* operator new(size_t size) { return AllocateCounted(size, alignof(std::max_align_t)); }
+void* operator new(size_t size, std::align_val_t alignment) { return AllocateCounted(size, static_cast<size_t>(alignment)); }
+void operator delete(void* pMemory) noexcept { FreeCounted(pMemory, alignof(std::max_align_t)); }
+void operator delete(void* pMemory, size_t) noexcept { FreeCounted(pMemory, alignof(std::max_align_t)); }
+void operator delete(void* pMemory, std::align_val_t alignment) noexcept { FreeCounted(pMemory, static_cast<size_t>(alignment)); }
+void operator delete(void* pMemory, size_t, std::align_val_t alignment) noexcept { FreeCounted(pMemory, static_cast<size_t>(alignment)); }
+#endif
+
+namespace dae
+{
+	namespace AllocationCounter
+	{
+		uint64_t GetNrAllocations()
+		{
+#ifdef RASTERIZER_COUNT_ALLOCATIONS
+			return g_NrAllocations.load(std::memory_order_relaxed);
+#else
+			return 0;
+#endif
+		}
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+
+//Counts every call of the global operator new, to verify that steady state frames stay off the heap.
+//Only compiled in when RASTERIZER_COUNT_ALLOCATIONS is defined, it replaces the global operator new/delete.
+
+namespace dae
+{
+	namespace AllocationCounter
+	{
+		constexpr bool IsCompiledIn()
+		{
+#ifdef RASTERIZER_COUNT_ALLOCATIONS
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		//Process wide, so allocations of other threads (other views) are included. Always 0 when not compiled in
+		uint64_t GetNrAllocations();
+	}
+}
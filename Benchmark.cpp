@@ -0,0 +1,363 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "AllocationCounter.h"
+#include "CameraPath.h"
+#include "Renderer.h"
+#include "Timer.h"
+#include "Trace.h"
+
+namespace dae
+{
+	namespace
+	{
+		struct Percentiles
+		{
+			float mean{};
+			float p50{};
+			float p95{};
+			float p99{};
+			float min{};
+			float max{};
+		};
+
+		//Nearest-rank percentiles of one stage over all samples
+		Percentiles CalculatePercentiles(const std::vector<StageTimings>& samples, float StageTimings::* pStage)
+		{
+			std::vector<float> values{};
+			values.reserve(samples.size());
+			for (const StageTimings& sample : samples)
+			{
+				values.emplace_back(sample.*pStage);
+			}
+			std::sort(values.begin(), values.end());
+
+			const auto rank = [&values](float percentile)
+			{
+				const size_t index{ static_cast<size_t>(percentile * static_cast<float>(values.size() - 1) + 0.5f) };
+				return values[index];
+			};
+
+			Percentiles result{};
+			for (const float value : values)
+			{
+				result.mean += value;
+			}
+			result.mean /= static_cast<float>(values.size());
+			result.p50 = rank(0.50f);
+			result.p95 = rank(0.95f);
+			result.p99 = rank(0.99f);
+			result.min = values.front();
+			result.max = values.back();
+
+			return result;
+		}
+
+		void WritePercentiles(std::ostream& stream, const Percentiles& percentiles)
+		{
+			stream << "{ "
+				<< "\"mean\": " << percentiles.mean << ", "
+				<< "\"p50\": " << percentiles.p50 << ", "
+				<< "\"p95\": " << percentiles.p95 << ", "
+				<< "\"p99\": " << percentiles.p99 << ", "
+				<< "\"min\": " << percentiles.min << ", "
+				<< "\"max\": " << percentiles.max << " }";
+		}
+
+		//Over the color channels of two images of 0x00RRGGBB pixels, identical images get 100 dB
+		float CalculatePsnr(const uint32_t* pPixels, const uint32_t* pReferencePixels, size_t nrPixels)
+		{
+			double squaredError{};
+			for (size_t pixelIdx{}; pixelIdx < nrPixels; ++pixelIdx)
+			{
+				for (int shift{}; shift < 24; shift += 8)
+				{
+					const double difference{ static_cast<double>((pPixels[pixelIdx] >> shift) & 0xFFu) - static_cast<double>((pReferencePixels[pixelIdx] >> shift) & 0xFFu) };
+					squaredError += difference * difference;
+				}
+			}
+			if (squaredError == 0.0)
+				return 100.f;
+
+			const double meanSquaredError{ squaredError / (3.0 * static_cast<double>(nrPixels)) };
+			return static_cast<float>(10.0 * std::log10(255.0 * 255.0 / meanSquaredError));
+		}
+
+		void WriteStage(std::ostream& stream, const char* name, const Percentiles& percentiles, bool isLast)
+		{
+			stream << "    \"" << name << "\": ";
+			WritePercentiles(stream, percentiles);
+			stream << (isLast ? "\n" : ",\n");
+		}
+	}
+
+	Benchmark::Benchmark(const BenchmarkSettings& settings)
+		: m_Settings{ settings }
+	{
+	}
+
+	bool Benchmark::Run()
+	{
+		CameraPath path{};
+		if (m_Settings.pathFile.empty())
+		{
+			path = CameraPath::CreateDefault(m_Settings.nrFrames);
+		}
+		else if (!path.LoadFromFile(m_Settings.pathFile))
+		{
+			std::cerr << "Could not load camera path " << m_Settings.pathFile << std::endl;
+			return false;
+		}
+
+		//Everything that changes the image, the quality reference shares it
+		const auto configureScene = [this](Renderer& renderer)
+		{
+			if (m_Settings.nrInstances > 1)
+				renderer.SetInstanceGrid(m_Settings.nrInstances);
+			renderer.SetOcclusionCulling(m_Settings.isOcclusionCulling);
+			renderer.SetLodPixelError(m_Settings.lodPixelError);
+			renderer.SetDrawSorting(m_Settings.isSortingDraws);
+			renderer.SetMaxShadingRate(m_Settings.maxShadingRate);
+			renderer.SetMaterialAtlas(m_Settings.isMaterialAtlas);
+			renderer.SetMultisampling(m_Settings.isMultisampling);
+			renderer.SetLocalLights(m_Settings.nrLocalLights);
+		};
+
+		Renderer renderer{ m_Settings.width, m_Settings.height, m_Settings.vertexFormat };
+		configureScene(renderer);
+		renderer.SetCheckerboard(m_Settings.isCheckerboard);
+		if (m_Settings.isDynamicResolution)
+			renderer.SetDynamicResolution(m_Settings.dynamicResolution);
+		renderer.SetOverdrawTracking(m_Settings.isTrackingOverdraw);
+		if (m_Settings.nrWorkers > 0 || m_Settings.isPinningWorkers)
+			renderer.SetNrWorkers(m_Settings.nrWorkers > 0 ? m_Settings.nrWorkers : renderer.GetNrWorkers(), m_Settings.isPinningWorkers);
+		m_NrWorkers = renderer.GetNrWorkers();
+
+		m_Samples.clear();
+		m_RenderScales.clear();
+		m_TotalStats = {};
+		m_OtherOrderStats = {};
+		m_CheckerboardPsnrs.clear();
+		m_Samples.reserve(m_Settings.nrFrames);
+		m_RenderScales.reserve(m_Settings.nrFrames);
+
+		//Drives the dynamic resolution like the viewer does, the warmup frames let it settle
+		Timer timer{};
+		timer.Start();
+
+		//Warmup frames walk the same path but are not recorded
+		for (int frame{ -m_Settings.nrWarmupFrames }; frame < m_Settings.nrFrames; ++frame)
+		{
+			//Only the measured frames end up in the trace
+			if (frame == 0 && !m_Settings.traceFile.empty())
+			{
+				TRACE_THREAD_NAME("Main");
+				Trace::BeginCapture();
+			}
+
+			//Every frame pays for the full pipeline, also when the path holds still
+			renderer.ApplyCameraKey(path.GetKey(std::max(frame, 0)));
+			renderer.Advance(0.f);
+			renderer.Invalidate();
+			renderer.Render();
+			timer.Update();
+
+			if (frame >= 0)
+			{
+				m_Samples.emplace_back(renderer.GetStageTimings());
+				m_RenderScales.emplace_back(renderer.GetRenderScale());
+				m_TotalStats += renderer.GetPipelineStats();
+			}
+			renderer.UpdateDynamicResolution(timer.GetElapsed());
+		}
+
+		Trace::EndCapture();
+
+		//Overdraw of the same frames in the other order, not timed
+		if (m_Settings.isTrackingOverdraw)
+		{
+			renderer.SetDrawSorting(!m_Settings.isSortingDraws);
+			for (int frame{}; frame < m_Settings.nrFrames; ++frame)
+			{
+				renderer.ApplyCameraKey(path.GetKey(frame));
+				renderer.Advance(0.f);
+				renderer.Invalidate();
+				renderer.Render();
+				m_OtherOrderStats += renderer.GetPipelineStats();
+			}
+			renderer.SetDrawSorting(m_Settings.isSortingDraws);
+		}
+
+		//The same frames next to a full render of every pixel, not timed. The history carries over from the last measured frame
+		if (m_Settings.isCheckerboard)
+		{
+			Renderer reference{ m_Settings.width, m_Settings.height, m_Settings.vertexFormat };
+			configureScene(reference);
+			for (int frame{}; frame < m_Settings.nrFrames; ++frame)
+			{
+				for (Renderer* pRenderer : { &renderer, &reference })
+				{
+					pRenderer->ApplyCameraKey(path.GetKey(frame));
+					pRenderer->Advance(0.f);
+					pRenderer->Invalidate();
+					pRenderer->Render();
+				}
+				m_CheckerboardPsnrs.emplace_back(CalculatePsnr(renderer.GetOutputPixels(), reference.GetOutputPixels(),
+					static_cast<size_t>(m_Settings.width) * m_Settings.height));
+			}
+		}
+
+		//The warmup frames grew the arenas, a measured frame that still allocates is a regression
+		if (m_TotalStats.heapAllocations > 0)
+		{
+			std::cerr << "Measured frames did " << m_TotalStats.heapAllocations << " heap allocations" << std::endl;
+			return false;
+		}
+		m_SourceVertexBytes = renderer.GetSourceVertexBytes();
+		m_TransformedVertexBytes = renderer.GetTransformedVertexBytes();
+		return !m_Samples.empty();
+	}
+
+	void Benchmark::WriteReport(std::ostream& stream) const
+	{
+#ifdef NDEBUG
+		constexpr const char* configuration{ "Release" };
+#else
+		constexpr const char* configuration{ "Debug" };
+#endif
+
+		stream << "{\n"
+			<< "  \"configuration\": \"" << configuration << "\",\n"
+			<< "  \"width\": " << m_Settings.width << ",\n"
+			<< "  \"height\": " << m_Settings.height << ",\n"
+			<< "  \"frames\": " << m_Samples.size() << ",\n"
+			<< "  \"warmupFrames\": " << m_Settings.nrWarmupFrames << ",\n"
+			<< "  \"workers\": " << m_NrWorkers << ",\n"
+			<< "  \"instances\": " << m_Settings.nrInstances << ",\n"
+			<< "  \"occlusionCulling\": " << (m_Settings.isOcclusionCulling ? "true" : "false") << ",\n"
+			<< "  \"lodPixelError\": " << m_Settings.lodPixelError << ",\n"
+			<< "  \"drawSorting\": " << (m_Settings.isSortingDraws ? "true" : "false") << ",\n"
+			<< "  \"maxShadingRate\": " << m_Settings.maxShadingRate << ",\n"
+			<< "  \"checkerboard\": " << (m_Settings.isCheckerboard ? "true" : "false") << ",\n"
+			<< "  \"materialAtlas\": " << (m_Settings.isMaterialAtlas ? "true" : "false") << ",\n"
+			<< "  \"msaa\": " << (m_Settings.isMultisampling ? "true" : "false") << ",\n"
+			<< "  \"localLights\": " << m_Settings.nrLocalLights << ",\n"
+			<< "  \"dynamicResolution\": ";
+		if (m_Settings.isDynamicResolution)
+		{
+			const DynamicResolutionSettings& dynamicResolution{ m_Settings.dynamicResolution };
+			float meanScale{};
+			for (const float scale : m_RenderScales)
+			{
+				meanScale += scale;
+			}
+			meanScale /= static_cast<float>(std::max(m_RenderScales.size(), size_t{ 1 }));
+			const auto [minScale, maxScale] { std::minmax_element(m_RenderScales.begin(), m_RenderScales.end()) };
+			stream << "{ \"budgetMs\": " << dynamicResolution.frameBudgetMs
+				<< ", \"minScale\": " << dynamicResolution.minScale
+				<< ", \"maxScale\": " << dynamicResolution.maxScale
+				<< ", \"upscale\": \"" << (dynamicResolution.upscaleFilter == UpscaleFilter::EdgeAware ? "edge" : "bilinear") << "\""
+				<< ", \"renderScale\": { \"mean\": " << meanScale
+				<< ", \"min\": " << (m_RenderScales.empty() ? 1.f : *minScale)
+				<< ", \"max\": " << (m_RenderScales.empty() ? 1.f : *maxScale) << " } },\n";
+		}
+		else
+		{
+			stream << "null,\n";
+		}
+		stream
+			<< "  \"vertexFormat\": \"" << (m_Settings.vertexFormat == VertexFormat::Compact ? "compact" : "float") << "\",\n"
+			<< "  \"vertexMemory\": { \"sourceBytes\": " << m_SourceVertexBytes << ", \"transformedBytes\": " << m_TransformedVertexBytes << " },\n"
+			<< "  \"path\": \"" << (m_Settings.pathFile.empty() ? "default" : m_Settings.pathFile) << "\",\n"
+			<< "  \"unit\": \"ms\",\n"
+			<< "  \"stages\": {\n";
+
+		WriteStage(stream, "clear", CalculatePercentiles(m_Samples, &StageTimings::clear), false);
+		WriteStage(stream, "cull", CalculatePercentiles(m_Samples, &StageTimings::cull), false);
+		WriteStage(stream, "vertexTransform", CalculatePercentiles(m_Samples, &StageTimings::vertexTransform), false);
+		WriteStage(stream, "triangleSetup", CalculatePercentiles(m_Samples, &StageTimings::triangleSetup), false);
+		WriteStage(stream, "raster", CalculatePercentiles(m_Samples, &StageTimings::raster), false);
+		WriteStage(stream, "shade", CalculatePercentiles(m_Samples, &StageTimings::shade), false);
+		WriteStage(stream, "reconstruct", CalculatePercentiles(m_Samples, &StageTimings::reconstruct), false);
+		WriteStage(stream, "resolve", CalculatePercentiles(m_Samples, &StageTimings::resolve), false);
+		WriteStage(stream, "upscale", CalculatePercentiles(m_Samples, &StageTimings::upscale), false);
+		WriteStage(stream, "present", CalculatePercentiles(m_Samples, &StageTimings::present), true);
+
+		stream << "  },\n"
+			<< "  \"frameTime\": ";
+		WritePercentiles(stream, CalculatePercentiles(m_Samples, &StageTimings::frame));
+
+		//Average counters per frame
+		const double nrFrames{ static_cast<double>(std::max(m_Samples.size(), size_t{ 1 })) };
+		stream << ",\n  \"pipeline\": {\n"
+			<< "    \"instancesDrawn\": " << m_TotalStats.instancesDrawn / nrFrames << ",\n"
+			<< "    \"instancesCulledFrustum\": " << m_TotalStats.instancesCulledFrustum / nrFrames << ",\n"
+			<< "    \"instancesCulledOcclusion\": " << m_TotalStats.instancesCulledOcclusion / nrFrames << ",\n"
+			<< "    \"instancesReducedLod\": " << m_TotalStats.instancesReducedLod / nrFrames << ",\n"
+			<< "    \"trianglesSavedLod\": " << m_TotalStats.trianglesSavedLod / nrFrames << ",\n"
+			<< "    \"clustersDrawn\": " << m_TotalStats.clustersDrawn / nrFrames << ",\n"
+			<< "    \"clustersCulledFrustum\": " << m_TotalStats.clustersCulledFrustum / nrFrames << ",\n"
+			<< "    \"clustersCulledOcclusion\": " << m_TotalStats.clustersCulledOcclusion / nrFrames << ",\n"
+			<< "    \"trianglesSubmitted\": " << m_TotalStats.trianglesSubmitted / nrFrames << ",\n"
+			<< "    \"trianglesCulledDegenerate\": " << m_TotalStats.trianglesCulledDegenerate / nrFrames << ",\n"
+			<< "    \"trianglesCulledFrustum\": " << m_TotalStats.trianglesCulledFrustum / nrFrames << ",\n"
+			<< "    \"trianglesCulledArea\": " << m_TotalStats.trianglesCulledArea / nrFrames << ",\n"
+			<< "    \"trianglesCulledNoSample\": " << m_TotalStats.trianglesCulledNoSample / nrFrames << ",\n"
+			<< "    \"trianglesRasterized\": " << m_TotalStats.trianglesRasterized / nrFrames << ",\n"
+			<< "    \"trianglesSmall\": " << m_TotalStats.trianglesSmall / nrFrames << ",\n"
+			<< "    \"trianglesSpan\": " << m_TotalStats.trianglesSpan / nrFrames << ",\n"
+			<< "    \"trianglesCoarseShaded\": " << m_TotalStats.trianglesCoarseShaded / nrFrames << ",\n"
+			<< "    \"pixelsTested\": " << m_TotalStats.pixelsTested / nrFrames << ",\n"
+			<< "    \"pixelsCovered\": " << m_TotalStats.pixelsCovered / nrFrames << ",\n"
+			<< "    \"pixelsDepthRejected\": " << m_TotalStats.pixelsDepthRejected / nrFrames << ",\n"
+			<< "    \"pixelsShaded\": " << m_TotalStats.pixelsShaded / nrFrames << ",\n"
+			<< "    \"pixelsShadeReused\": " << m_TotalStats.pixelsShadeReused / nrFrames << ",\n"
+			<< "    \"pixelsReprojected\": " << m_TotalStats.pixelsReprojected / nrFrames << ",\n"
+			<< "    \"pixelsInterpolated\": " << m_TotalStats.pixelsInterpolated / nrFrames << ",\n"
+			<< "    \"shadesFromMaterialAtlas\": " << m_TotalStats.shadesFromMaterialAtlas / nrFrames << ",\n"
+			<< "    \"pixelsMultisampled\": " << m_TotalStats.pixelsMultisampled / nrFrames << ",\n"
+			<< "    \"lightsLocalVisible\": " << m_TotalStats.lightsLocalVisible / nrFrames << ",\n"
+			<< "    \"tileLightsTested\": " << m_TotalStats.tileLightsTested / nrFrames << ",\n"
+			<< "    \"tileLightsKept\": " << m_TotalStats.tileLightsKept / nrFrames << ",\n"
+			<< "    \"overdraw\": " << m_TotalStats.GetOverdraw() << ",\n"
+			<< "    \"arenaBytes\": " << m_TotalStats.arenaBytes / nrFrames << ",\n"
+			<< "    \"heapAllocations\": ";
+		//null when nothing counts them
+		if (AllocationCounter::IsCompiledIn())
+			stream << m_TotalStats.heapAllocations / nrFrames;
+		else
+			stream << "null";
+		stream << "\n"
+			<< "  }";
+
+		//Same frames with draw sorting on and off
+		if (m_Settings.isTrackingOverdraw)
+		{
+			const PipelineStats& sortedStats{ m_Settings.isSortingDraws ? m_TotalStats : m_OtherOrderStats };
+			const PipelineStats& unsortedStats{ m_Settings.isSortingDraws ? m_OtherOrderStats : m_TotalStats };
+			stream << ",\n  \"drawOrder\": {\n"
+				<< "    \"sortedOverdraw\": " << sortedStats.GetOverdraw() << ",\n"
+				<< "    \"unsortedOverdraw\": " << unsortedStats.GetOverdraw() << ",\n"
+				<< "    \"sortedPixelsShaded\": " << sortedStats.pixelsShaded / nrFrames << ",\n"
+				<< "    \"unsortedPixelsShaded\": " << unsortedStats.pixelsShaded / nrFrames << "\n"
+				<< "  }";
+		}
+
+		//PSNR of every frame against the full render, in dB
+		if (!m_CheckerboardPsnrs.empty())
+		{
+			float meanPsnr{};
+			for (const float psnr : m_CheckerboardPsnrs)
+			{
+				meanPsnr += psnr;
+			}
+			meanPsnr /= static_cast<float>(m_CheckerboardPsnrs.size());
+			stream << ",\n  \"checkerboardQuality\": { \"psnrMean\": " << meanPsnr
+				<< ", \"psnrMin\": " << *std::min_element(m_CheckerboardPsnrs.begin(), m_CheckerboardPsnrs.end()) << " }";
+		}
+		stream << "\n}\n";
+	}
+}
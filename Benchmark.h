@@ -0,0 +1,61 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "DataTypes.h"
+#include "DynamicResolution.h"
+#include "FrameStats.h"
+
+namespace dae
+{
+	struct BenchmarkSettings
+	{
+		int width{ 1280 };
+		int height{ 720 };
+		int nrFrames{ 300 };
+		int nrWarmupFrames{ 30 };
+		std::string pathFile{};		//Recorded CameraPath, the default path is used when empty
+		std::string reportFile{};	//JSON report, written to stdout when empty
+		bool isTrackingOverdraw{ false };
+		std::string traceFile{};	//Captures the measured frames when set
+		int nrWorkers{ 0 };			//Job system workers, 0 uses one per hardware thread
+		bool isPinningWorkers{ false };
+		VertexFormat vertexFormat{ VertexFormat::Float };
+		int nrInstances{ 1 };		//Copies of the mesh on a grid
+		bool isOcclusionCulling{ true };
+		float lodPixelError{ 1.f };	//Renderer::SetLodPixelError
+		bool isSortingDraws{ true };
+		int maxShadingRate{ 1 };	//Renderer::SetMaxShadingRate
+		bool isCheckerboard{ false };
+		bool isMaterialAtlas{ false };	//Renderer::SetMaterialAtlas
+		bool isMultisampling{ false };	//Renderer::SetMultisampling
+		int nrLocalLights{ 0 };			//Renderer::SetLocalLights
+		bool isDynamicResolution{ false };
+		DynamicResolutionSettings dynamicResolution{};
+	};
+
+	//Plays a fixed camera/mesh path at a fixed resolution and reports per-stage frame time percentiles
+	class Benchmark final
+	{
+	public:
+		explicit Benchmark(const BenchmarkSettings& settings);
+
+		//False when the path could not be loaded, or when a measured frame allocated while allocations are counted
+		bool Run();
+		void WriteReport(std::ostream& stream) const;
+
+	private:
+		BenchmarkSettings m_Settings;
+		std::vector<StageTimings> m_Samples{};
+		std::vector<float> m_RenderScales{};
+		PipelineStats m_TotalStats{};
+		//The measured frames again with the other draw order, only when tracking overdraw
+		PipelineStats m_OtherOrderStats{};
+		//The measured frames again next to a full render, only when rendering a checkerboard
+		std::vector<float> m_CheckerboardPsnrs{};
+		int m_NrWorkers{};
+		size_t m_SourceVertexBytes{};
+		size_t m_TransformedVertexBytes{};
+	};
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cfloat>
+#include <cstdint>
+
+#include "Vector3.h"
+#include "Vector4.h"
+#include "Matrix.h"
+
+namespace dae
+{
+	//Axis aligned bounding box, an empty box has min > max
+	struct BoundingBox
+	{
+		Vector3 min{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		constexpr void Grow(const Vector3& point)
+		{
+			min = Vector3::Min(min, point);
+			max = Vector3::Max(max, point);
+		}
+
+		constexpr void Grow(const BoundingBox& box)
+		{
+			min = Vector3::Min(min, box.min);
+			max = Vector3::Max(max, box.max);
+		}
+
+		constexpr Vector3 GetCenter() const { return (min + max) * 0.5f; }
+		constexpr Vector3 GetExtent() const { return max - min; }
+
+		constexpr float GetSurfaceArea() const
+		{
+			const Vector3 extent{ GetExtent() };
+			return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+		}
+
+		//Box around the transformed corners, so it stays conservative under rotation
+		constexpr BoundingBox Transform(const Matrix& matrix) const
+		{
+			BoundingBox box{};
+			for (int corner{}; corner < 8; ++corner)
+			{
+				box.Grow(matrix.TransformPoint(
+					corner & 1 ? max.x : min.x,
+					corner & 2 ? max.y : min.y,
+					corner & 4 ? max.z : min.z));
+			}
+			return box;
+		}
+	};
+
+	//The six clip planes of a view-projection matrix (row vectors, clip = position * matrix).
+	//Points inside have a non-negative distance to every plane, the same -w..w range Camera::IsOutsideFrustum accepts
+	struct Frustum
+	{
+		static constexpr int nrPlanes{ 6 };
+		static constexpr uint32_t allPlanesMask{ (1u << nrPlanes) - 1 };
+		Vector4 planes[nrPlanes]{};
+
+		static constexpr Frustum FromViewProjection(const Matrix& viewProjection)
+		{
+			const auto column = [&viewProjection](int index)
+			{
+				return Vector4{ viewProjection[0][index], viewProjection[1][index], viewProjection[2][index], viewProjection[3][index] };
+			};
+
+			const Vector4 x{ column(0) };
+			const Vector4 y{ column(1) };
+			const Vector4 z{ column(2) };
+			const Vector4 w{ column(3) };
+
+			Frustum frustum{};
+			frustum.planes[0] = w + x;	//Left
+			frustum.planes[1] = w - x;	//Right
+			frustum.planes[2] = w + y;	//Bottom
+			frustum.planes[3] = w - y;	//Top
+			frustum.planes[4] = w + z;	//Near
+			frustum.planes[5] = w - z;	//Far
+			return frustum;
+		}
+
+		//Tests the box against the planes in planeMask. Returns false when the box is fully outside one of them,
+		//otherwise clears the planes the box is fully inside of from planeMask, children of the box can skip those
+		constexpr bool Intersects(const BoundingBox& box, uint32_t& planeMask) const
+		{
+			for (int planeIdx{}; planeIdx < nrPlanes; ++planeIdx)
+			{
+				const uint32_t planeBit{ 1u << planeIdx };
+				if (!(planeMask & planeBit))
+					continue;
+
+				//Corners furthest along and furthest against the plane normal
+				const Vector4& plane{ planes[planeIdx] };
+				const Vector3 positive{ plane.x >= 0.f ? box.max.x : box.min.x, plane.y >= 0.f ? box.max.y : box.min.y, plane.z >= 0.f ? box.max.z : box.min.z };
+				const Vector3 negative{ plane.x >= 0.f ? box.min.x : box.max.x, plane.y >= 0.f ? box.min.y : box.max.y, plane.z >= 0.f ? box.min.z : box.max.z };
+
+				if (plane.x * positive.x + plane.y * positive.y + plane.z * positive.z + plane.w < 0.f)
+					return false;
+				if (plane.x * negative.x + plane.y * negative.y + plane.z * negative.z + plane.w >= 0.f)
+					planeMask &= ~planeBit;
+			}
+			return true;
+		}
+	};
+}
@@ -39,6 +39,9 @@ namespace dae
 		Matrix viewMatrix{};
 
 		Matrix projectionMatrix{};
+
+		//Set whenever the view or projection matrix changes, cleared by whoever consumed the new matrices
+		bool isDirty{ true };
 		
 		const float nearPlane{ .1f };
 		const float farPlane{ 500.f };
@@ -119,9 +122,18 @@ namespace dae
 			origin += direction;
 
 
+			UpdateMatrices();
+		}
+
+		//Rebuilds the matrices from the current origin/pitch/yaw without polling any input
+		void UpdateMatrices()
+		{
 			const Matrix rotationMatrix = Matrix::CreateRotationX(totalPitch) * Matrix::CreateRotationY(totalYaw);
 			forward = rotationMatrix.TransformVector(Vector3::UnitZ);
 
+			const Matrix oldViewMatrix{ viewMatrix };
+			const Matrix oldProjectionMatrix{ projectionMatrix };
+
 			//Update Matrices
 			CalculateViewMatrix();
 
@@ -129,6 +141,11 @@ namespace dae
 			{
 				CalculateProjectionMatrix();
 			}
+
+			if (viewMatrix != oldViewMatrix || projectionMatrix != oldProjectionMatrix)
+			{
+				isDirty = true;
+			}
 		}
 
 		bool DidFovOrAspectRatioChange()
@@ -0,0 +1,59 @@
+#include "CameraPath.h"
+
+#include <fstream>
+
+namespace dae
+{
+	CameraPath CameraPath::CreateDefault(int nrKeys)
+	{
+		CameraPath path{};
+		path.m_Keys.reserve(nrKeys);
+
+		for (int i{}; i < nrKeys; ++i)
+		{
+			const float t{ static_cast<float>(i) / static_cast<float>(nrKeys) };
+
+			CameraKey key{};
+			key.origin = Vector3{ 3.f * sinf(PI_2 * t), 1.5f * sinf(2.f * PI_2 * t), -10.f + 5.f * sinf(PI_2 * t) };
+			key.pitch = 0.1f * sinf(2.f * PI_2 * t);
+			key.yaw = -0.15f * sinf(PI_2 * t);
+			key.meshYaw = PI_2 * t;
+			path.m_Keys.emplace_back(key);
+		}
+
+		return path;
+	}
+
+	bool CameraPath::LoadFromFile(const std::string& path)
+	{
+		std::ifstream file(path);
+		if (!file)
+			return false;
+
+		//One key per line: originX originY originZ pitch yaw meshYaw
+		m_Keys.clear();
+		CameraKey key{};
+		while (file >> key.origin.x >> key.origin.y >> key.origin.z >> key.pitch >> key.yaw >> key.meshYaw)
+		{
+			m_Keys.emplace_back(key);
+		}
+
+		return !m_Keys.empty();
+	}
+
+	bool CameraPath::SaveToFile(const std::string& path) const
+	{
+		std::ofstream file(path);
+		if (!file)
+			return false;
+
+		file.precision(9);
+		for (const CameraKey& key : m_Keys)
+		{
+			file << key.origin.x << ' ' << key.origin.y << ' ' << key.origin.z << ' '
+				<< key.pitch << ' ' << key.yaw << ' ' << key.meshYaw << '\n';
+		}
+
+		return file.good();
+	}
+}
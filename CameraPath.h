@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	//Camera placement + mesh rotation of a single frame
+	struct CameraKey
+	{
+		Vector3 origin{};
+		float pitch{};
+		float yaw{};
+		float meshYaw{};
+	};
+
+	//Per-frame recorded camera/mesh path, played back by the benchmark
+	class CameraPath final
+	{
+	public:
+		//Deterministic dolly/orbit path around the default mesh placement
+		static CameraPath CreateDefault(int nrKeys);
+
+		bool LoadFromFile(const std::string& path);
+		bool SaveToFile(const std::string& path) const;
+
+		void AddKey(const CameraKey& key) { m_Keys.emplace_back(key); }
+		void Clear() { m_Keys.clear(); }
+
+		//Wraps around, so a short path can drive any number of frames
+		const CameraKey& GetKey(int index) const { return m_Keys[index % m_Keys.size()]; }
+		int GetNrKeys() const { return static_cast<int>(m_Keys.size()); }
+
+	private:
+		std::vector<CameraKey> m_Keys{};
+	};
+}
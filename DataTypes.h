@@ -1,17 +1,20 @@
 #pragma once
 #include "Math.h"
+#include <cstdint>
+#include <initializer_list>
 #include "vector"
 
+#include "BoundingVolumes.h"
+#include "VertexPacking.h"
+
 namespace dae
 {
 	struct Vertex
 	{
 		Vector3 position{};
-		ColorRGB color{};
 		Vector2 uv{}; //W3
 		Vector3 normal{}; //W4
 		Vector3 tangent{}; //W4
-		Vector3 viewDirection{}; //W4
 	};
 
 	struct Vertex_Out
@@ -22,6 +25,208 @@ namespace dae
 		Vector3 normal{};
 		Vector3 tangent{};
 		Vector3 viewDirection{};
+		Vector3 worldPosition{};
+	};
+
+	//The vertex streams are padded to a multiple of this, so the vertex kernel only processes whole blocks
+	constexpr size_t VertexBlockSize{ 8 };
+
+	inline size_t GetPaddedVertexCount(size_t nrVertices)
+	{
+		return (nrVertices + VertexBlockSize - 1) / VertexBlockSize * VertexBlockSize;
+	}
+
+	//Structure-of-arrays copy of the vertex attributes the vertex stage transforms, built once at load
+	struct MeshStreams
+	{
+		std::vector<float> positionX{};
+		std::vector<float> positionY{};
+		std::vector<float> positionZ{};
+		std::vector<float> normalX{};
+		std::vector<float> normalY{};
+		std::vector<float> normalZ{};
+		std::vector<float> tangentX{};
+		std::vector<float> tangentY{};
+		std::vector<float> tangentZ{};
+
+		size_t GetByteSize() const { return positionX.size() * 9 * sizeof(float); }
+	};
+
+	//Compact copy of the source vertices, replaces both the float streams and the vertex array: 24 bytes per vertex.
+	//Normals and tangents are octahedral snorm16 pairs, uvs are two halves
+	struct CompactMeshStreams
+	{
+		std::vector<float> positionX{};
+		std::vector<float> positionY{};
+		std::vector<float> positionZ{};
+		std::vector<uint32_t> normal{};
+		std::vector<uint32_t> tangent{};
+		std::vector<uint32_t> uv{};
+
+		Vector2 GetUV(uint32_t index) const { return VertexPacking::UnpackHalf2(uv[index]); }
+
+		size_t GetByteSize() const
+		{
+			return (positionX.size() + positionY.size() + positionZ.size()) * sizeof(float) + (normal.size() + tangent.size() + uv.size()) * sizeof(uint32_t);
+		}
+	};
+
+	//Structure-of-arrays output of the vertex stage. Position is NDC with the view depth kept in w,
+	//uv and color are not transformed and are read from the mesh
+	struct VertexStreams
+	{
+		std::vector<float> positionX{};
+		std::vector<float> positionY{};
+		std::vector<float> positionZ{};
+		std::vector<float> positionW{};
+		std::vector<float> rasterX{};
+		std::vector<float> rasterY{};
+		std::vector<float> normalX{};
+		std::vector<float> normalY{};
+		std::vector<float> normalZ{};
+		std::vector<float> tangentX{};
+		std::vector<float> tangentY{};
+		std::vector<float> tangentZ{};
+		std::vector<float> viewDirectionX{};
+		std::vector<float> viewDirectionY{};
+		std::vector<float> viewDirectionZ{};
+
+		void Resize(size_t nrVertices)
+		{
+			const size_t paddedCount{ GetPaddedVertexCount(nrVertices) };
+			for (std::vector<float>* pStream : { &positionX, &positionY, &positionZ, &positionW, &rasterX, &rasterY,
+				&normalX, &normalY, &normalZ, &tangentX, &tangentY, &tangentZ, &viewDirectionX, &viewDirectionY, &viewDirectionZ })
+			{
+				pStream->resize(paddedCount);
+			}
+		}
+
+		void Reserve(size_t nrVertices)
+		{
+			const size_t paddedCount{ GetPaddedVertexCount(nrVertices) };
+			for (std::vector<float>* pStream : { &positionX, &positionY, &positionZ, &positionW, &rasterX, &rasterY,
+				&normalX, &normalY, &normalZ, &tangentX, &tangentY, &tangentZ, &viewDirectionX, &viewDirectionY, &viewDirectionZ })
+			{
+				pStream->reserve(paddedCount);
+			}
+		}
+
+		Vector4 GetPosition(uint32_t index) const { return { positionX[index], positionY[index], positionZ[index], positionW[index] }; }
+		Vector2 GetRaster(uint32_t index) const { return { rasterX[index], rasterY[index] }; }
+		Vector3 GetNormal(uint32_t index) const { return { normalX[index], normalY[index], normalZ[index] }; }
+		Vector3 GetTangent(uint32_t index) const { return { tangentX[index], tangentY[index], tangentZ[index] }; }
+		Vector3 GetViewDirection(uint32_t index) const { return { viewDirectionX[index], viewDirectionY[index], viewDirectionZ[index] }; }
+
+		size_t GetByteSize() const { return positionX.size() * 15 * sizeof(float); }
+	};
+
+	//Compact output of the vertex stage, only what setup and raster read: 32 bytes per vertex instead of 60.
+	//Normal and tangent are octahedral encoded, the view direction is rebuilt from the position in setup
+	struct CompactVertexStreams
+	{
+		std::vector<float> positionX{};
+		std::vector<float> positionY{};
+		std::vector<float> positionZ{};
+		std::vector<float> positionW{};
+		std::vector<float> rasterX{};
+		std::vector<float> rasterY{};
+		std::vector<uint32_t> normal{};
+		std::vector<uint32_t> tangent{};
+
+		void Resize(size_t nrVertices)
+		{
+			const size_t paddedCount{ GetPaddedVertexCount(nrVertices) };
+			for (std::vector<float>* pStream : { &positionX, &positionY, &positionZ, &positionW, &rasterX, &rasterY })
+			{
+				pStream->resize(paddedCount);
+			}
+			normal.resize(paddedCount);
+			tangent.resize(paddedCount);
+		}
+
+		void Reserve(size_t nrVertices)
+		{
+			const size_t paddedCount{ GetPaddedVertexCount(nrVertices) };
+			for (std::vector<float>* pStream : { &positionX, &positionY, &positionZ, &positionW, &rasterX, &rasterY })
+			{
+				pStream->reserve(paddedCount);
+			}
+			normal.reserve(paddedCount);
+			tangent.reserve(paddedCount);
+		}
+
+		Vector4 GetPosition(uint32_t index) const { return { positionX[index], positionY[index], positionZ[index], positionW[index] }; }
+		Vector2 GetRaster(uint32_t index) const { return { rasterX[index], rasterY[index] }; }
+		Vector3 GetNormal(uint32_t index) const { return VertexPacking::DecodeOctahedral(normal[index]); }
+		Vector3 GetTangent(uint32_t index) const { return VertexPacking::DecodeOctahedral(tangent[index]); }
+		//Direction from the camera, the clip position before the divide
+		Vector3 GetViewDirection(uint32_t index) const
+		{
+			const float w{ positionW[index] };
+			return Vector3{ positionX[index] * w, positionY[index] * w, positionZ[index] * w }.Normalized();
+		}
+
+		size_t GetByteSize() const { return positionX.size() * 6 * sizeof(float) + (normal.size() + tangent.size()) * sizeof(uint32_t); }
+	};
+
+	//Value that varies linearly in screen space across a triangle: valueAtOrigin + dx * x + dy * y
+	struct AttributePlane
+	{
+		float valueAtOrigin{};
+		float dx{};
+		float dy{};
+
+		float Evaluate(float x, float y) const
+		{
+			return valueAtOrigin + dx * x + dy * y;
+		}
+	};
+
+	//How the rasterizer walks the pixels of a triangle, picked in triangle setup
+	enum class RasterPath : uint8_t
+	{
+		BoundingBox,	//Coverage test at every pixel of the bounding box
+		Small,			//At most 3x3 candidate samples, coverage already known from setup
+		Span			//Large triangles, exact span per scanline without coverage tests
+	};
+
+	//Screen space data of a triangle that survived culling, shared by all its pixels
+	struct TriangleSetup
+	{
+		uint32_t vertIndex0{};
+		uint32_t vertIndex1{};
+		uint32_t vertIndex2{};
+		uint32_t drawIndex{};		//Instance the triangle belongs to
+		Vector2 v0{};
+		Vector2 v1{};
+		Vector2 v2{};
+		float triangleArea{};
+		int startingX{};
+		int startingY{};
+		int endingX{};
+		int endingY{};
+		RasterPath rasterPath{ RasterPath::BoundingBox };
+		//Small path: bit x + 3 * y is the sample at (startingX + x, startingY + y)
+		uint16_t sampleMask{};
+		//Pixels per axis that share one shade, coverage and depth stay per pixel
+		uint8_t shadingRate{ 1 };
+
+		//Perspective correct interpolation: attribute/w and 1/w are linear in screen space, NDC z is linear as is
+		AttributePlane invW{};
+		AttributePlane z{};
+		AttributePlane uvOverW[2]{};
+		AttributePlane normalOverW[3]{};
+		AttributePlane tangentOverW[3]{};
+		AttributePlane viewDirectionOverW[3]{};
+	};
+
+	//A pixel that passed coverage and depth, waiting to be shaded
+	struct Fragment
+	{
+		int pixelIndex{};
+		uint32_t triangleIndex{};
+		float zDepth{};				//At the pixel center
+		uint8_t coverageMask{ 0xF };	//Multisampling: the samples it covers and that passed depth, one bit per sample
 	};
 
 	enum class PrimitiveTopology
@@ -30,17 +235,66 @@ namespace dae
 		TriangleStrip	//Good for a lines
 	};
 
+	//Memory layout of the vertices, picked at load
+	enum class VertexFormat
+	{
+		Float,		//Vertex array plus float streams
+		Compact		//Quantized streams only, see CompactMeshStreams
+	};
+
+	//Run of consecutive triangles of a mesh that is culled as a whole
+	struct MeshCluster
+	{
+		uint32_t firstTriangle{};
+		uint32_t nrTriangles{};
+		BoundingBox bounds{};		//Object space
+	};
+
+	//Immutable source data, can be shared between views and threads
 	struct Mesh
 	{
-		std::vector<Vertex> vertices{};
+		std::vector<Vertex> vertices{};		//Empty in the compact format
 		std::vector<uint32_t> indices{};
 		PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleList };
-		std::vector<Vertex_Out> vertices_out{};
-		Matrix worldMatrix{};
+		VertexFormat vertexFormat{ VertexFormat::Float };
+		size_t nrVertices{};
+		BoundingBox bounds{};		//Object space
+		MeshStreams streams{};
+		CompactMeshStreams compactStreams{};
+		std::vector<MeshCluster> clusters{};
+		float lodError{};		//Object space distance a simplified level may be off from the full detail mesh
+
+		size_t GetNrTriangles() const
+		{
+			switch (primitiveTopology)
+			{
+			case PrimitiveTopology::TriangleStrip:
+				return indices.size() > 2 ? indices.size() - 2 : 0;
+			default:
+				return indices.size() / 3;
+			}
+		}
+
+		//Vertex indices of a triangle, every other strip triangle is flipped to keep the winding
+		void GetTriangle(size_t triangleNr, uint32_t (&triangle)[3]) const
+		{
+			if (primitiveTopology == PrimitiveTopology::TriangleStrip)
+			{
+				const bool isOdd{ triangleNr % 2 != 0 };
+				triangle[0] = indices[triangleNr];
+				triangle[1] = indices[triangleNr + 1 + isOdd];
+				triangle[2] = indices[triangleNr + 2 - isOdd];
+				return;
+			}
+
+			triangle[0] = indices[triangleNr * 3];
+			triangle[1] = indices[triangleNr * 3 + 1];
+			triangle[2] = indices[triangleNr * 3 + 2];
+		}
 
-		void Rotate(float angle)
+		size_t GetVertexByteSize() const
 		{
-			worldMatrix = Matrix::CreateRotationY(angle) * worldMatrix;
+			return vertices.size() * sizeof(Vertex) + streams.GetByteSize() + compactStreams.GetByteSize();
 		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace dae
+{
+	DynamicResolutionController::DynamicResolutionController(const DynamicResolutionSettings& settings)
+		: m_Settings{ settings }
+	{
+		assert(settings.frameBudgetMs > 0.f && settings.minScale > 0.f && settings.minScale <= settings.maxScale && settings.maxScale <= 1.f);
+		Reset();
+	}
+
+	float DynamicResolutionController::Update(float frameMs)
+	{
+		//Slow frames are taken over quickly, fast ones only bit by bit
+		if (m_SmoothedFrameMs <= 0.f)
+			m_SmoothedFrameMs = frameMs;
+		else
+			m_SmoothedFrameMs += (frameMs - m_SmoothedFrameMs) * (frameMs > m_SmoothedFrameMs ? 0.5f : 0.1f);
+
+		if (++m_NrFramesSinceChange < m_SettleFrames)
+			return m_Scale;
+
+		//Pixels go with the square of the scale
+		const float targetMs{ m_Settings.frameBudgetMs * m_Headroom };
+		float scale{ m_Scale * std::sqrt(targetMs / m_SmoothedFrameMs) };
+		scale = std::clamp(scale, m_Scale * m_MaxScaleDown, m_Scale * m_MaxScaleUp);
+		scale = std::clamp(scale, m_Settings.minScale, m_Settings.maxScale);
+		//Within reach of a limit it goes all the way, otherwise it would stop just short of it
+		if (std::abs(scale - m_Scale) < m_MinScaleChange && scale != m_Settings.minScale && scale != m_Settings.maxScale)
+			return m_Scale;
+		if (scale == m_Scale)
+			return m_Scale;
+
+		//The frames measured so far were at the old size
+		m_SmoothedFrameMs *= (scale * scale) / (m_Scale * m_Scale);
+		m_Scale = scale;
+		m_NrFramesSinceChange = 0;
+		return m_Scale;
+	}
+
+	void DynamicResolutionController::Reset()
+	{
+		m_Scale = m_Settings.maxScale;
+		m_SmoothedFrameMs = 0.f;
+		m_NrFramesSinceChange = 0;
+	}
+}
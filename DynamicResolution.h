@@ -0,0 +1,49 @@
+#pragma once
+
+namespace dae
+{
+	//How a frame rendered below the output size is brought back up to it
+	enum class UpscaleFilter
+	{
+		Bilinear,
+		EdgeAware	//Bilinear, but neighbours that differ a lot from the nearest one weigh less, edges stay sharp
+	};
+
+	struct DynamicResolutionSettings
+	{
+		float frameBudgetMs{ 1000.f / 60.f };
+		float minScale{ 0.5f };		//Render size per axis relative to the output
+		float maxScale{ 1.f };
+		UpscaleFilter upscaleFilter{ UpscaleFilter::Bilinear };
+	};
+
+	//Picks the render scale of the next frame from the measured frame times. The cost of a frame is taken to grow
+	//with the number of pixels, the scale drops fast when over budget and only creeps back up when well under it
+	class DynamicResolutionController final
+	{
+	public:
+		explicit DynamicResolutionController(const DynamicResolutionSettings& settings = {});
+
+		//Time of the last frame in milliseconds, returns the scale of the next one
+		float Update(float frameMs);
+		void Reset();
+
+		float GetScale() const { return m_Scale; }
+		const DynamicResolutionSettings& GetSettings() const { return m_Settings; }
+
+	private:
+		//Aim below the budget, so a slightly heavier frame does not miss it right away
+		static constexpr float m_Headroom{ 0.9f };
+		static constexpr float m_MaxScaleDown{ 0.85f };
+		static constexpr float m_MaxScaleUp{ 1.05f };
+		//Changes smaller than this are not worth new buffers and a full redraw
+		static constexpr float m_MinScaleChange{ 0.02f };
+		//Frames measured at the new size before the next change
+		static constexpr int m_SettleFrames{ 3 };
+
+		DynamicResolutionSettings m_Settings;
+		float m_Scale{};
+		float m_SmoothedFrameMs{};
+		int m_NrFramesSinceChange{};
+	};
+}
@@ -0,0 +1,117 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+namespace dae
+{
+	namespace
+	{
+		//The data of a block starts after its header, at the alignment operator new guarantees
+		constexpr size_t BlockHeaderSize{ (sizeof(void*) + sizeof(size_t) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t) };
+	}
+
+	FrameArena::FrameArena(size_t blockSize)
+		: m_BlockSize{ blockSize }
+	{
+	}
+
+	FrameArena::~FrameArena()
+	{
+		FreeBlocks();
+	}
+
+	void* FrameArena::Allocate(size_t size, size_t alignment)
+	{
+		assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && "Alignment must be a power of two");
+
+		const auto getPadding = [this, alignment]()
+		{
+			const uintptr_t address{ reinterpret_cast<uintptr_t>(GetData(m_pCurrentBlock) + m_Offset) };
+			return static_cast<size_t>((alignment - address % alignment) % alignment);
+		};
+
+		size_t padding{ m_pCurrentBlock ? getPadding() : 0 };
+		if (!m_pCurrentBlock || m_Offset + padding + size > m_pCurrentBlock->size)
+		{
+			AddBlock(size + alignment);
+			padding = getPadding();
+		}
+
+		std::byte* pAllocation{ GetData(m_pCurrentBlock) + m_Offset + padding };
+		m_Offset += padding + size;
+		return pAllocation;
+	}
+
+	void FrameArena::Reset()
+	{
+		if (m_pCurrentBlock && m_pCurrentBlock->pPrevious)
+		{
+			size_t totalSize{};
+			for (const Block* pBlock{ m_pCurrentBlock }; pBlock; pBlock = pBlock->pPrevious)
+			{
+				totalSize += pBlock->size;
+			}
+			//Headroom, the frames that follow a new high-water mark rarely stop exactly at it
+			FreeBlocks();
+			AddBlock(totalSize + totalSize / 2);
+		}
+
+		m_Offset = 0;
+		m_UsedBytesInPreviousBlocks = 0;
+	}
+
+	void FrameArena::Reserve(size_t capacity)
+	{
+		assert(GetUsedBytes() == 0 && "Reserve between frames only");
+		if (GetCapacity() >= capacity)
+			return;
+
+		FreeBlocks();
+		AddBlock(capacity);
+		m_UsedBytesInPreviousBlocks = 0;
+	}
+
+	size_t FrameArena::GetUsedBytes() const
+	{
+		return m_UsedBytesInPreviousBlocks + m_Offset;
+	}
+
+	size_t FrameArena::GetCapacity() const
+	{
+		size_t capacity{};
+		for (const Block* pBlock{ m_pCurrentBlock }; pBlock; pBlock = pBlock->pPrevious)
+		{
+			capacity += pBlock->size;
+		}
+		return capacity;
+	}
+
+	void FrameArena::AddBlock(size_t minSize)
+	{
+		static_assert(sizeof(Block) <= BlockHeaderSize);
+		const size_t size{ std::max(minSize, m_BlockSize) };
+		Block* pBlock{ new (::operator new(BlockHeaderSize + size)) Block{ m_pCurrentBlock, size } };
+		++m_NrBlockAllocations;
+
+		m_UsedBytesInPreviousBlocks += m_Offset;
+		m_pCurrentBlock = pBlock;
+		m_Offset = 0;
+	}
+
+	void FrameArena::FreeBlocks()
+	{
+		while (m_pCurrentBlock)
+		{
+			Block* pPrevious{ m_pCurrentBlock->pPrevious };
+			::operator delete(m_pCurrentBlock);
+			m_pCurrentBlock = pPrevious;
+		}
+	}
+
+	std::byte* FrameArena::GetData(Block* pBlock)
+	{
+		return reinterpret_cast<std::byte*>(pBlock) + BlockHeaderSize;
+	}
+}
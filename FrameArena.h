@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace dae
+{
+	//Bump allocator for data that only lives for one frame. Nothing is freed on its own, Reset releases the whole
+	//frame at once. Not thread safe: every worker allocates from its own arena
+	class FrameArena final
+	{
+	public:
+		explicit FrameArena(size_t blockSize = size_t{ 1 } << 20);
+		~FrameArena();
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena(FrameArena&&) noexcept = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+		FrameArena& operator=(FrameArena&&) noexcept = delete;
+
+		void* Allocate(size_t size, size_t alignment);
+
+		//Uninitialized storage for count objects. No destructors are ever run
+		template<typename T>
+		T* Allocate(size_t count)
+		{
+			static_assert(std::is_trivially_destructible_v<T>, "Frame arena objects are never destroyed");
+			return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+		}
+
+		//Ends the frame. A frame that overflowed into extra blocks gets them replaced by a single block half again
+		//the combined size, so the next frames allocate nothing while they stay below it
+		void Reset();
+		//Grows the arena to at least capacity bytes in one block. Only right after Reset, nothing may be in use
+		void Reserve(size_t capacity);
+
+		size_t GetUsedBytes() const;
+		size_t GetCapacity() const;
+		//Blocks taken from the heap over the lifetime of the arena
+		uint64_t GetNrBlockAllocations() const { return m_NrBlockAllocations; }
+
+	private:
+		struct Block
+		{
+			Block* pPrevious{};
+			size_t size{};
+		};
+
+		const size_t m_BlockSize;
+		Block* m_pCurrentBlock{};
+		size_t m_Offset{};
+		size_t m_UsedBytesInPreviousBlocks{};
+		uint64_t m_NrBlockAllocations{};
+
+		void AddBlock(size_t minSize);
+		void FreeBlocks();
+		static std::byte* GetData(Block* pBlock);
+	};
+}
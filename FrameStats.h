@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+
+namespace dae
+{
+	//Milliseconds spent in each pipeline stage during the last rendered frame
+	struct StageTimings
+	{
+		float clear{};
+		float cull{};				//Instance hierarchy refit and frustum culling
+		float vertexTransform{};	//Includes the viewport mapping, fused into the vertex kernel
+		float triangleSetup{};
+		float raster{};
+		float shade{};
+		float reconstruct{};		//Only when rendering a checkerboard
+		float resolve{};			//Only when multisampling
+		float upscale{};			//Only when rendering below the output size
+		float present{};
+		float frame{};
+	};
+
+	//Work counters of one frame. Every worker fills its own copy, they are merged at the end of the frame
+	struct alignas(64) PipelineStats
+	{
+		uint64_t instancesDrawn{};
+		uint64_t instancesCulledFrustum{};		//Whole instances rejected by the scene hierarchy
+		uint64_t instancesCulledOcclusion{};	//Behind the occluders in the occlusion buffer
+		uint64_t instancesReducedLod{};			//Drawn at a simplified level of detail
+		uint64_t trianglesSavedLod{};			//Full detail triangles those levels left out
+		uint64_t clustersDrawn{};
+		uint64_t clustersCulledFrustum{};
+		uint64_t clustersCulledOcclusion{};
+		uint64_t verticesTransformed{};			//0 when the transformed vertices of the last frame were reused
+		uint64_t trianglesSubmitted{};
+		uint64_t trianglesCulledDegenerate{};	//IsVertexSame
+		uint64_t trianglesCulledFrustum{};		//IsOutsideFrustum
+		uint64_t trianglesCulledArea{};			//Back facing or zero area
+		uint64_t trianglesCulledNoSample{};		//Small triangles that cover no sample center
+		uint64_t trianglesRasterized{};
+		uint64_t trianglesSmall{};				//Rasterized on the small triangle path
+		uint64_t trianglesSpan{};				//Rasterized on the span path
+		uint64_t trianglesCoarseShaded{};		//Shaded once per block of pixels
+
+		uint64_t pixelsTested{};				//Coverage tests inside the bounding boxes
+		uint64_t pixelsCovered{};
+		uint64_t pixelsDepthRejected{};
+		uint64_t pixelsShaded{};
+		uint64_t pixelsShadedUnique{};			//Only counted while overdraw is tracked
+		uint64_t pixelsShadeReused{};			//Took the shade of their block instead of running their own
+		uint64_t pixelsReprojected{};			//Checkerboard: taken from the last frame
+		uint64_t pixelsInterpolated{};			//Checkerboard: no usable history, filled from the shaded neighbours
+		uint64_t shadesFromMaterialAtlas{};		//Shades that read the material atlas instead of the textures
+		uint64_t pixelsMultisampled{};			//Multisampling: pixels left with more than one color, averaged by the resolve
+		uint64_t lightsLocalVisible{};			//Point and spot lights that reach into the view frustum
+		uint64_t tileLightsTested{};			//Visible local lights tested against the batches of fragments of a tile
+		uint64_t tileLightsKept{};				//Of those, the ones the batch was shaded with
+
+		uint64_t heapAllocations{};				//Only counted when RASTERIZER_COUNT_ALLOCATIONS is defined
+		uint64_t arenaBytes{};					//Transient frame data, over all arenas
+
+		PipelineStats& operator+=(const PipelineStats& other)
+		{
+			instancesDrawn += other.instancesDrawn;
+			instancesCulledFrustum += other.instancesCulledFrustum;
+			instancesCulledOcclusion += other.instancesCulledOcclusion;
+			instancesReducedLod += other.instancesReducedLod;
+			trianglesSavedLod += other.trianglesSavedLod;
+			clustersDrawn += other.clustersDrawn;
+			clustersCulledFrustum += other.clustersCulledFrustum;
+			clustersCulledOcclusion += other.clustersCulledOcclusion;
+			verticesTransformed += other.verticesTransformed;
+			trianglesSubmitted += other.trianglesSubmitted;
+			trianglesCulledDegenerate += other.trianglesCulledDegenerate;
+			trianglesCulledFrustum += other.trianglesCulledFrustum;
+			trianglesCulledArea += other.trianglesCulledArea;
+			trianglesCulledNoSample += other.trianglesCulledNoSample;
+			trianglesRasterized += other.trianglesRasterized;
+			trianglesSmall += other.trianglesSmall;
+			trianglesSpan += other.trianglesSpan;
+			trianglesCoarseShaded += other.trianglesCoarseShaded;
+			pixelsTested += other.pixelsTested;
+			pixelsCovered += other.pixelsCovered;
+			pixelsDepthRejected += other.pixelsDepthRejected;
+			pixelsShaded += other.pixelsShaded;
+			pixelsShadedUnique += other.pixelsShadedUnique;
+			pixelsShadeReused += other.pixelsShadeReused;
+			pixelsReprojected += other.pixelsReprojected;
+			pixelsInterpolated += other.pixelsInterpolated;
+			shadesFromMaterialAtlas += other.shadesFromMaterialAtlas;
+			pixelsMultisampled += other.pixelsMultisampled;
+			lightsLocalVisible += other.lightsLocalVisible;
+			tileLightsTested += other.tileLightsTested;
+			tileLightsKept += other.tileLightsKept;
+			heapAllocations += other.heapAllocations;
+			arenaBytes += other.arenaBytes;
+			return *this;
+		}
+
+		//Average number of times a shaded pixel was shaded, 0 when overdraw is not tracked
+		float GetOverdraw() const
+		{
+			return pixelsShadedUnique ? static_cast<float>(pixelsShaded) / static_cast<float>(pixelsShadedUnique) : 0.f;
+		}
+	};
+}
@@ -0,0 +1,173 @@
+#include "InstanceBvh.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "Model.h"
+#include "Scene.h"
+#include "Trace.h"
+
+namespace dae
+{
+	void InstanceBvh::Update(const Scene& scene)
+	{
+		if (scene.GetNrInstances() != GetNrInstances() || m_Nodes.empty())
+		{
+			Build(scene);
+			return;
+		}
+
+		Refit(scene);
+		if (m_Nodes.front().bounds.GetSurfaceArea() > m_RebuildAreaRatio * m_BuiltRootArea)
+		{
+			Build(scene);
+		}
+	}
+
+	void InstanceBvh::Build(const Scene& scene)
+	{
+		TRACE_ZONE("InstanceBvh::Build");
+		UpdateInstanceBounds(scene);
+
+		const uint32_t nrInstances{ GetNrInstances() };
+		m_InstanceOrder.resize(nrInstances);
+		std::iota(m_InstanceOrder.begin(), m_InstanceOrder.end(), 0u);
+
+		//A binary tree with at least one instance per leaf has fewer than twice as many nodes as instances
+		m_Nodes.clear();
+		m_Nodes.reserve(std::max(2 * nrInstances, 1u));
+		m_Nodes.emplace_back(Node{ {}, 0, nrInstances, 0 });
+		for (uint32_t instanceIdx{}; instanceIdx < nrInstances; ++instanceIdx)
+		{
+			m_Nodes.front().bounds.Grow(m_InstanceBounds[instanceIdx]);
+		}
+		Subdivide(0);
+
+		m_BuiltRootArea = m_Nodes.front().bounds.GetSurfaceArea();
+		++m_NrBuilds;
+	}
+
+	void InstanceBvh::Refit(const Scene& scene)
+	{
+		TRACE_ZONE("InstanceBvh::Refit");
+		UpdateInstanceBounds(scene);
+
+		//Children are always stored after their parent, so walking backwards visits them first
+		for (size_t nodeIdx{ m_Nodes.size() }; nodeIdx-- > 0;)
+		{
+			Node& node{ m_Nodes[nodeIdx] };
+			node.bounds = {};
+			if (node.leftChild)
+			{
+				node.bounds.Grow(m_Nodes[node.leftChild].bounds);
+				node.bounds.Grow(m_Nodes[node.leftChild + 1].bounds);
+				continue;
+			}
+
+			for (uint32_t orderIdx{ node.firstInstance }; orderIdx < node.firstInstance + node.nrInstances; ++orderIdx)
+			{
+				node.bounds.Grow(m_InstanceBounds[m_InstanceOrder[orderIdx]]);
+			}
+		}
+	}
+
+	uint32_t InstanceBvh::Cull(const Frustum& frustum, uint32_t* pVisibleInstances) const
+	{
+		TRACE_ZONE("InstanceBvh::Cull");
+		if (m_Nodes.empty() || m_Nodes.front().nrInstances == 0)
+			return 0;
+
+		struct StackEntry
+		{
+			uint32_t nodeIdx;
+			uint32_t planeMask;
+		};
+		//The median split keeps the depth at log2 of the instance count
+		StackEntry stack[64]{};
+		int stackSize{};
+		stack[stackSize++] = { 0, Frustum::allPlanesMask };
+
+		uint32_t nrVisible{};
+		while (stackSize > 0)
+		{
+			const StackEntry entry{ stack[--stackSize] };
+			const Node& node{ m_Nodes[entry.nodeIdx] };
+
+			uint32_t planeMask{ entry.planeMask };
+			if (planeMask && !frustum.Intersects(node.bounds, planeMask))
+				continue;
+
+			//Fully inside, or a leaf: everything below is drawn
+			if (!planeMask || !node.leftChild)
+			{
+				for (uint32_t orderIdx{ node.firstInstance }; orderIdx < node.firstInstance + node.nrInstances; ++orderIdx)
+				{
+					const uint32_t instanceIdx{ m_InstanceOrder[orderIdx] };
+					uint32_t instancePlaneMask{ planeMask };
+					if (!planeMask || frustum.Intersects(m_InstanceBounds[instanceIdx], instancePlaneMask))
+						pVisibleInstances[nrVisible++] = instanceIdx;
+				}
+				continue;
+			}
+
+			stack[stackSize++] = { node.leftChild + 1, planeMask };
+			stack[stackSize++] = { node.leftChild, planeMask };
+		}
+
+		//Draw order independent of the tree shape, so a rebuild never changes the image
+		std::sort(pVisibleInstances, pVisibleInstances + nrVisible);
+		return nrVisible;
+	}
+
+	void InstanceBvh::UpdateInstanceBounds(const Scene& scene)
+	{
+		const uint32_t nrInstances{ scene.GetNrInstances() };
+		m_InstanceBounds.resize(nrInstances);
+		for (uint32_t instanceIdx{}; instanceIdx < nrInstances; ++instanceIdx)
+		{
+			const Instance& instance{ scene.GetInstance(instanceIdx) };
+			m_InstanceBounds[instanceIdx] = scene.GetModel(instance.modelIndex).GetMesh().bounds.Transform(instance.worldMatrix);
+		}
+	}
+
+	void InstanceBvh::Subdivide(uint32_t nodeIdx)
+	{
+		const Node node{ m_Nodes[nodeIdx] };
+		if (node.nrInstances <= m_MaxLeafSize)
+			return;
+
+		//Median split along the longest axis of the instance centers
+		BoundingBox centerBounds{};
+		for (uint32_t orderIdx{ node.firstInstance }; orderIdx < node.firstInstance + node.nrInstances; ++orderIdx)
+		{
+			centerBounds.Grow(m_InstanceBounds[m_InstanceOrder[orderIdx]].GetCenter());
+		}
+
+		const Vector3 extent{ centerBounds.GetExtent() };
+		const int axis{ extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2) };
+
+		const auto first{ m_InstanceOrder.begin() + node.firstInstance };
+		const uint32_t nrLeft{ node.nrInstances / 2 };
+		std::nth_element(first, first + nrLeft, first + node.nrInstances, [this, axis](uint32_t a, uint32_t b)
+			{
+				return m_InstanceBounds[a].GetCenter()[axis] < m_InstanceBounds[b].GetCenter()[axis];
+			});
+
+		const uint32_t leftChild{ static_cast<uint32_t>(m_Nodes.size()) };
+		m_Nodes[nodeIdx].leftChild = leftChild;
+		m_Nodes.emplace_back(Node{ {}, node.firstInstance, nrLeft, 0 });
+		m_Nodes.emplace_back(Node{ {}, node.firstInstance + nrLeft, node.nrInstances - nrLeft, 0 });
+
+		for (uint32_t childIdx{ leftChild }; childIdx < leftChild + 2; ++childIdx)
+		{
+			Node& child{ m_Nodes[childIdx] };
+			for (uint32_t orderIdx{ child.firstInstance }; orderIdx < child.firstInstance + child.nrInstances; ++orderIdx)
+			{
+				child.bounds.Grow(m_InstanceBounds[m_InstanceOrder[orderIdx]]);
+			}
+		}
+
+		Subdivide(leftChild);
+		Subdivide(leftChild + 1);
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "BoundingVolumes.h"
+
+namespace dae
+{
+	class Scene;
+
+	//Bounding volume hierarchy over the world space boxes of the scene instances. Moved instances only refit the
+	//boxes, the tree is built again when instances were added or removed or the refit boxes grew too loose
+	class InstanceBvh final
+	{
+	public:
+		InstanceBvh() = default;
+		~InstanceBvh() = default;
+
+		InstanceBvh(const InstanceBvh&) = delete;
+		InstanceBvh(InstanceBvh&&) noexcept = delete;
+		InstanceBvh& operator=(const InstanceBvh&) = delete;
+		InstanceBvh& operator=(InstanceBvh&&) noexcept = delete;
+
+		//Refits or rebuilds to the current instances of the scene
+		void Update(const Scene& scene);
+		void Build(const Scene& scene);
+		void Refit(const Scene& scene);
+
+		//Writes the instances that can intersect the frustum to pVisibleInstances in ascending order, it needs room
+		//for every instance. Subtrees fully inside the frustum are accepted without testing their children
+		uint32_t Cull(const Frustum& frustum, uint32_t* pVisibleInstances) const;
+
+		uint32_t GetNrInstances() const { return static_cast<uint32_t>(m_InstanceBounds.size()); }
+		const BoundingBox& GetInstanceBounds(uint32_t instanceIndex) const { return m_InstanceBounds[instanceIndex]; }
+		uint64_t GetNrBuilds() const { return m_NrBuilds; }
+
+	private:
+		struct Node
+		{
+			BoundingBox bounds{};
+			uint32_t firstInstance{};	//Range of the subtree in m_InstanceOrder
+			uint32_t nrInstances{};
+			uint32_t leftChild{};		//The right child follows it, 0 for a leaf
+		};
+
+		static constexpr uint32_t m_MaxLeafSize{ 4 };
+		//Rebuild when refitting made the root this much larger than when it was built
+		static constexpr float m_RebuildAreaRatio{ 2.f };
+
+		std::vector<Node> m_Nodes{};
+		std::vector<uint32_t> m_InstanceOrder{};
+		std::vector<BoundingBox> m_InstanceBounds{};
+		float m_BuiltRootArea{};
+		uint64_t m_NrBuilds{};
+
+		void UpdateInstanceBounds(const Scene& scene);
+		void Subdivide(uint32_t nodeIdx);
+	};
+}
@@ -0,0 +1,191 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "Trace.h"
+
+namespace dae
+{
+	JobSystem::JobSystem(int nrWorkers, bool isPinningWorkers)
+		: m_NrWorkers{ std::max(nrWorkers, 1) }
+		, m_pQueues{ new WorkerQueue[m_NrWorkers] }
+	{
+		m_Threads.reserve(m_NrWorkers - 1);
+		for (int workerIndex{ 1 }; workerIndex < m_NrWorkers; ++workerIndex)
+		{
+			m_Threads.emplace_back(&JobSystem::WorkerLoop, this, workerIndex, isPinningWorkers);
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			const std::lock_guard lock{ m_WakeMutex };
+			m_IsStopping = true;
+		}
+		m_WakeCondition.notify_all();
+
+		for (std::thread& thread : m_Threads)
+		{
+			thread.join();
+		}
+		delete[] m_pQueues;
+	}
+
+	int JobSystem::GetDefaultNrWorkers()
+	{
+		return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	}
+
+	void JobSystem::Dispatch(size_t count, size_t chunkSize, InvokeFunction pInvoke, const void* pFunction)
+	{
+		if (count == 0) return;
+		chunkSize = std::max(chunkSize, size_t{ 1 });
+		const size_t nrChunks{ (count + chunkSize - 1) / chunkSize };
+
+		//Nothing to share, skip the queues
+		if (m_NrWorkers == 1 || nrChunks == 1)
+		{
+			for (size_t begin{ 0 }; begin < count; begin += chunkSize)
+			{
+				pInvoke(pFunction, begin, std::min(begin + chunkSize, count), 0);
+			}
+			return;
+		}
+
+		std::atomic<size_t> nrRemaining{ nrChunks };
+		for (size_t chunk{ 0 }; chunk < nrChunks; ++chunk)
+		{
+			const size_t begin{ chunk * chunkSize };
+			const Job job{ pInvoke, pFunction, begin, std::min(begin + chunkSize, count), &nrRemaining };
+
+			//Contiguous chunks per worker keeps neighbouring data on one core until stealing kicks in
+			const int workerIndex{ static_cast<int>(chunk * m_NrWorkers / nrChunks) };
+			if (!Push(workerIndex, job))
+			{
+				Run(job, 0);
+			}
+		}
+
+		{
+			const std::lock_guard lock{ m_WakeMutex };
+		}
+		m_WakeCondition.notify_all();
+
+		//Work along until every chunk of this call is done
+		while (nrRemaining.load(std::memory_order_acquire) > 0)
+		{
+			if (!TryRunJob(0))
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	bool JobSystem::Push(int workerIndex, const Job& job)
+	{
+		WorkerQueue& queue{ m_pQueues[workerIndex] };
+		const std::lock_guard lock{ queue.mutex };
+		if (queue.tail - queue.head == WorkerQueue::capacity)
+			return false;
+
+		queue.jobs[queue.tail % WorkerQueue::capacity] = job;
+		++queue.tail;
+		m_NrQueuedJobs.fetch_add(1, std::memory_order_release);
+		return true;
+	}
+
+	bool JobSystem::Pop(int workerIndex, Job& job)
+	{
+		WorkerQueue& queue{ m_pQueues[workerIndex] };
+		const std::lock_guard lock{ queue.mutex };
+		if (queue.tail == queue.head)
+			return false;
+
+		--queue.tail;
+		job = queue.jobs[queue.tail % WorkerQueue::capacity];
+		m_NrQueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool JobSystem::Steal(int workerIndex, Job& job)
+	{
+		for (int offset{ 1 }; offset < m_NrWorkers; ++offset)
+		{
+			WorkerQueue& queue{ m_pQueues[(workerIndex + offset) % m_NrWorkers] };
+			const std::lock_guard lock{ queue.mutex };
+			if (queue.tail == queue.head)
+				continue;
+
+			job = queue.jobs[queue.head % WorkerQueue::capacity];
+			++queue.head;
+			m_NrQueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+		return false;
+	}
+
+	bool JobSystem::TryRunJob(int workerIndex)
+	{
+		Job job{};
+		if (!Pop(workerIndex, job) && !Steal(workerIndex, job))
+			return false;
+
+		Run(job, workerIndex);
+		return true;
+	}
+
+	void JobSystem::Run(const Job& job, int workerIndex)
+	{
+		job.pInvoke(job.pFunction, job.begin, job.end, workerIndex);
+		job.pNrRemaining->fetch_sub(1, std::memory_order_release);
+	}
+
+	void JobSystem::WorkerLoop(int workerIndex, bool isPinned)
+	{
+		TRACE_THREAD_NAME("Worker " + std::to_string(workerIndex));
+		if (isPinned)
+		{
+			PinCurrentThread(workerIndex);
+		}
+
+		while (true)
+		{
+			if (TryRunJob(workerIndex))
+				continue;
+
+			std::unique_lock lock{ m_WakeMutex };
+			m_WakeCondition.wait(lock, [this]() { return m_IsStopping || m_NrQueuedJobs.load(std::memory_order_acquire) > 0; });
+			if (m_IsStopping)
+				return;
+		}
+	}
+
+	void JobSystem::PinCurrentThread(int hardwareThread)
+	{
+		const int nrHardwareThreads{ GetDefaultNrWorkers() };
+		hardwareThread %= nrHardwareThreads;
+
+#if defined(_WIN32)
+		SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{ 1 } << hardwareThread);
+#elif defined(__linux__)
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		CPU_SET(hardwareThread, &cpuSet);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#else
+		(void)hardwareThread;
+#endif
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	//Fixed pool of workers, each with its own job deque. A worker pops its own deque from the back and steals
+	//from the front of the others when it runs dry. The thread calling ParallelFor works along as worker 0.
+	class JobSystem final
+	{
+	public:
+		//nrWorkers includes the calling thread, 1 runs every job inline.
+		//Pinning is a hint: worker i is bound to hardware thread i where the platform supports it
+		explicit JobSystem(int nrWorkers, bool isPinningWorkers = false);
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem(JobSystem&&) noexcept = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+		JobSystem& operator=(JobSystem&&) noexcept = delete;
+
+		int GetNrWorkers() const { return m_NrWorkers; }
+		static int GetDefaultNrWorkers();
+
+		//Calls function(begin, end, workerIndex) for every chunk of [0, count) and returns once all chunks ran.
+		//Chunks are handed out in order, contiguous ranges go to the same worker first
+		template<typename Function>
+		void ParallelFor(size_t count, size_t chunkSize, const Function& function);
+
+	private:
+		using InvokeFunction = void(*)(const void* pFunction, size_t begin, size_t end, int workerIndex);
+
+		struct Job
+		{
+			InvokeFunction pInvoke{};
+			const void* pFunction{};
+			size_t begin{};
+			size_t end{};
+			std::atomic<size_t>* pNrRemaining{};
+		};
+
+		//Fixed capacity ring, so queuing never allocates
+		struct alignas(64) WorkerQueue
+		{
+			static constexpr size_t capacity{ 1024 };
+
+			std::mutex mutex{};
+			Job jobs[capacity]{};
+			size_t head{};	//Oldest job, stolen by other workers
+			size_t tail{};	//One past the newest job, popped by the owner
+		};
+
+		const int m_NrWorkers;
+		WorkerQueue* m_pQueues{};
+		std::vector<std::thread> m_Threads{};
+
+		std::mutex m_WakeMutex{};
+		std::condition_variable m_WakeCondition{};
+		std::atomic<size_t> m_NrQueuedJobs{};
+		bool m_IsStopping{ false };
+
+		void Dispatch(size_t count, size_t chunkSize, InvokeFunction pInvoke, const void* pFunction);
+		bool Push(int workerIndex, const Job& job);
+		bool Pop(int workerIndex, Job& job);
+		bool Steal(int workerIndex, Job& job);
+		bool TryRunJob(int workerIndex);
+		static void Run(const Job& job, int workerIndex);
+		void WorkerLoop(int workerIndex, bool isPinned);
+		static void PinCurrentThread(int hardwareThread);
+	};
+
+	template<typename Function>
+	void JobSystem::ParallelFor(size_t count, size_t chunkSize, const Function& function)
+	{
+		const InvokeFunction pInvoke{ [](const void* pFunction, size_t begin, size_t end, int workerIndex)
+			{
+				(*static_cast<const Function*>(pFunction))(begin, end, workerIndex);
+			} };
+		Dispatch(count, chunkSize, pInvoke, &function);
+	}
+}
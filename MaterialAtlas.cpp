@@ -0,0 +1,55 @@
+#include "MaterialAtlas.h"
+
+#include <cassert>
+#include <cmath>
+
+#include "Math.h"
+#include "Model.h"
+#include "Texture.h"
+#include "Trace.h"
+
+namespace dae
+{
+	MaterialAtlas::MaterialAtlas(const Model& model, float specularShininess)
+	{
+		TRACE_ZONE("BuildMaterialAtlas");
+		assert(CanBuild(model));
+		const Texture* pDiffuseTexture{ model.GetDiffuseTexture() };
+		const Texture* pNormalTexture{ model.GetNormalTexture() };
+		const Texture* pGlossinessTexture{ model.GetGlossinessTexture() };
+		const Texture* pSpecularTexture{ model.GetSpecularTexture() };
+
+		m_Width = pDiffuseTexture->GetWidth();
+		m_Height = pDiffuseTexture->GetHeight();
+		m_Texels.resize(static_cast<size_t>(m_Width) * m_Height);
+
+		for (int y{}; y < m_Height; ++y)
+		{
+			for (int x{}; x < m_Width; ++x)
+			{
+				//Same order of operations as Shade, so the pixels come out the same. Textures of another size than the
+				//diffuse one are read at its texel centers
+				const Vector2 uv{ (static_cast<float>(x) + 0.5f) / static_cast<float>(m_Width), (static_cast<float>(y) + 0.5f) / static_cast<float>(m_Height) };
+				MaterialTexel& texel{ m_Texels[x + y * m_Width] };
+				texel.lambert = pDiffuseTexture->Sample(uv) / PI;
+				texel.phongExponent = specularShininess * pGlossinessTexture->Sample(uv).r;
+
+				const ColorRGB specularColor{ pSpecularTexture->Sample(uv) };
+				texel.specularColor = static_cast<uint32_t>(std::lround(specularColor.r * 255.f)) << 16
+					| static_cast<uint32_t>(std::lround(specularColor.g * 255.f)) << 8
+					| static_cast<uint32_t>(std::lround(specularColor.b * 255.f));
+
+				if (pNormalTexture != nullptr)
+				{
+					const ColorRGB normalMapSample{ 2.0f * pNormalTexture->Sample(uv) - ColorRGB{ 1.0f, 1.0f, 1.0f } };
+					texel.normalSample = Vector3{ normalMapSample.r, normalMapSample.g, normalMapSample.b };
+				}
+			}
+		}
+	}
+
+	bool MaterialAtlas::CanBuild(const Model& model)
+	{
+		return model.GetDiffuseTexture() != nullptr && model.GetGlossinessTexture() != nullptr && model.GetSpecularTexture() != nullptr;
+	}
+}
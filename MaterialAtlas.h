@@ -0,0 +1,66 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "ColorRGB.h"
+#include "Vector2.h"
+#include "Vector3.h"
+
+namespace dae
+{
+	class Model;
+
+	//Material of one texel, decoded from the textures. Nothing in it depends on a light or the view
+	struct MaterialTexel
+	{
+		ColorRGB lambert{};			//Albedo / PI, the diffuse term before the light
+		uint32_t specularColor{};	//8 bits per channel, as the specular texture holds it
+		Vector3 normalSample{};		//Tangent space, decoded from the normal map
+		float phongExponent{};
+
+		ColorRGB GetSpecularColor() const
+		{
+			return ColorRGB{ static_cast<float>((specularColor >> 16) & 0xFFu) / 255.f,
+				static_cast<float>((specularColor >> 8) & 0xFFu) / 255.f,
+				static_cast<float>(specularColor & 0xFFu) / 255.f };
+		}
+	};
+
+	//The material of a model pre-decoded in texture space: everything the shading reads from its textures, resolved
+	//once per texel of the diffuse texture. The Lambert albedo, the specular color and exponent, and the normal map sample.
+	//It holds no lighting: the light terms are still evaluated per pixel, a pixel only trades four texture reads and
+	//decodes for one lookup. Nothing in it depends on the view, the lights or the world transform, so it never goes stale. The normal map sample stays in tangent space, a texel shared by mirrored
+	//or overlapping uvs then still serves every surface that maps onto it. Immutable once built
+	class MaterialAtlas final
+	{
+	public:
+		//The model needs its diffuse, glossiness and specular textures, the normal map is optional
+		MaterialAtlas(const Model& model, float specularShininess);
+		~MaterialAtlas() = default;
+
+		MaterialAtlas(const MaterialAtlas&) = delete;
+		MaterialAtlas(MaterialAtlas&&) noexcept = delete;
+		MaterialAtlas& operator=(const MaterialAtlas&) = delete;
+		MaterialAtlas& operator=(MaterialAtlas&&) noexcept = delete;
+
+		static bool CanBuild(const Model& model);
+
+		//The texel Texture::Sample reads at uv
+		const MaterialTexel& GetTexel(const Vector2& uv) const
+		{
+			const int x{ std::min(static_cast<int>(std::clamp(uv.x, 0.f, 1.f) * static_cast<float>(m_Width)), m_Width - 1) };
+			const int y{ std::min(static_cast<int>(std::clamp(uv.y, 0.f, 1.f) * static_cast<float>(m_Height)), m_Height - 1) };
+			return m_Texels[x + y * m_Width];
+		}
+
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+		size_t GetByteSize() const { return m_Texels.size() * sizeof(MaterialTexel); }
+
+	private:
+		int m_Width{};
+		int m_Height{};
+		std::vector<MaterialTexel> m_Texels{};
+	};
+}
@@ -0,0 +1,146 @@
+#include "MathBenchmark.h"
+
+#include <SDL.h>
+
+#include "Math.h"
+
+namespace dae
+{
+	MathBenchmark::MathBenchmark(const MathBenchmarkSettings& settings)
+		: m_Settings{ settings }
+	{
+	}
+
+	template<typename Kernel>
+	void MathBenchmark::Measure(const char* name, Kernel&& kernel)
+	{
+		//One untimed pass to warm the caches
+		m_Checksum += kernel();
+
+		const uint64_t start{ SDL_GetPerformanceCounter() };
+		for (int i{ 0 }; i < m_Settings.nrIterations; ++i)
+		{
+			m_Checksum += kernel();
+		}
+		const uint64_t end{ SDL_GetPerformanceCounter() };
+
+		const double nrOps{ static_cast<double>(m_Settings.nrIterations) * m_Settings.nrElements };
+		const double ns{ static_cast<double>(end - start) * 1e9 / static_cast<double>(SDL_GetPerformanceFrequency()) };
+		m_Results.push_back({ name, ns / nrOps });
+	}
+
+	void MathBenchmark::Run()
+	{
+		m_Results.clear();
+		m_Checksum = 0.f;
+
+		//Deterministic, invertible operands
+		const size_t nrElements{ static_cast<size_t>(m_Settings.nrElements) };
+		std::vector<Matrix> matrices(nrElements);
+		std::vector<Vector4> points(nrElements);
+		std::vector<Vector3> vectors(nrElements);
+		for (size_t i{ 0 }; i < nrElements; ++i)
+		{
+			const float t{ static_cast<float>(i) * 0.01f };
+			matrices[i] = Matrix::CreateRotation(t, t * 0.5f, t * 0.25f) * Matrix::CreateTranslation(t, -t, 2.f * t);
+			points[i] = { t, 1.f - t, 0.5f * t, 1.f };
+			vectors[i] = { 1.f + t, t, -t };
+		}
+		std::vector<Matrix> matricesOut(nrElements);
+		std::vector<Vector4> pointsOut(nrElements);
+
+		Measure("matrixMultiply", [&]()
+			{
+				for (size_t i{ 0 }; i < nrElements; ++i)
+				{
+					matricesOut[i] = matrices[i] * matrices[nrElements - 1 - i];
+				}
+				return matricesOut[nrElements / 2][3].x;
+			});
+
+		Measure("matrixInverse", [&]()
+			{
+				for (size_t i{ 0 }; i < nrElements; ++i)
+				{
+					matricesOut[i] = Matrix::Inverse(matrices[i]);
+				}
+				return matricesOut[nrElements / 2][3].x;
+			});
+
+		Measure("matrixTranspose", [&]()
+			{
+				for (size_t i{ 0 }; i < nrElements; ++i)
+				{
+					matricesOut[i] = Matrix::Transpose(matrices[i]);
+				}
+				return matricesOut[nrElements / 2][3].x;
+			});
+
+		const Matrix& transform{ matrices[nrElements / 3] };
+		Measure("transformPoint4", [&]()
+			{
+				for (size_t i{ 0 }; i < nrElements; ++i)
+				{
+					pointsOut[i] = transform.TransformPoint(points[i]);
+				}
+				return pointsOut[nrElements / 2].w;
+			});
+
+		Measure("transformVector3", [&]()
+			{
+				float sum{};
+				for (size_t i{ 0 }; i < nrElements; ++i)
+				{
+					sum += transform.TransformVector(vectors[i]).x;
+				}
+				return sum;
+			});
+
+		Measure("vector4Dot", [&]()
+			{
+				float sum{};
+				for (size_t i{ 0 }; i < nrElements; ++i)
+				{
+					sum += Vector4::Dot(points[i], pointsOut[i]);
+				}
+				return sum;
+			});
+
+		Measure("vector3CrossNormalize", [&]()
+			{
+				float sum{};
+				for (size_t i{ 0 }; i < nrElements; ++i)
+				{
+					sum += Vector3::Cross(vectors[i], Vector3::UnitY).Normalized().z;
+				}
+				return sum;
+			});
+	}
+
+	void MathBenchmark::WriteReport(std::ostream& stream) const
+	{
+#ifdef NDEBUG
+		constexpr const char* configuration{ "Release" };
+#else
+		constexpr const char* configuration{ "Debug" };
+#endif
+
+		stream << "{\n"
+			<< "  \"configuration\": \"" << configuration << "\",\n"
+			<< "  \"simd\": " << (Simd::IsEnabled() ? "true" : "false") << ",\n"
+			<< "  \"iterations\": " << m_Settings.nrIterations << ",\n"
+			<< "  \"elements\": " << m_Settings.nrElements << ",\n"
+			<< "  \"unit\": \"ns/op\",\n"
+			<< "  \"kernels\": {\n";
+
+		for (size_t i{ 0 }; i < m_Results.size(); ++i)
+		{
+			stream << "    \"" << m_Results[i].name << "\": " << m_Results[i].nsPerOp
+				<< (i + 1 < m_Results.size() ? ",\n" : "\n");
+		}
+
+		stream << "  },\n"
+			<< "  \"checksum\": " << m_Checksum << "\n"
+			<< "}\n";
+	}
+}
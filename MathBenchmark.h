@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace dae
+{
+	struct MathBenchmarkSettings
+	{
+		int nrIterations{ 200 };	//Passes over the operand arrays per kernel
+		int nrElements{ 4096 };		//Matrices/points per pass, sized to stay in L1/L2
+	};
+
+	//Times the hot Vector/Matrix kernels in isolation, build with RASTERIZER_NO_SIMD to compare against the scalar path
+	class MathBenchmark final
+	{
+	public:
+		explicit MathBenchmark(const MathBenchmarkSettings& settings);
+
+		void Run();
+		void WriteReport(std::ostream& stream) const;
+
+	private:
+		struct Result
+		{
+			const char* name{};
+			double nsPerOp{};
+		};
+
+		MathBenchmarkSettings m_Settings;
+		std::vector<Result> m_Results{};
+		//Folded from every kernel's output so the work cannot be optimized away
+		float m_Checksum{};
+
+		template<typename Kernel>
+		void Measure(const char* name, Kernel&& kernel);
+	};
+}
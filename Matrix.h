@@ -1,4 +1,10 @@
 #pragma once
+#include <cassert>
+#include <cmath>
+#include <type_traits>
+
+#include "MathHelpers.h"
+#include "Simd.h"
 #include "Vector3.h"
 #include "Vector4.h"
 
@@ -6,59 +12,58 @@ namespace dae {
 	struct Matrix
 	{
 		Matrix() = default;
-		Matrix(
+		constexpr Matrix(
 			const Vector3& xAxis,
 			const Vector3& yAxis,
 			const Vector3& zAxis,
 			const Vector3& t);
 
-		Matrix(
+		constexpr Matrix(
 			const Vector4& xAxis,
 			const Vector4& yAxis,
 			const Vector4& zAxis,
 			const Vector4& t);
 
-		Matrix(const Matrix& m);
-
-		Vector3 TransformVector(const Vector3& v) const;
-		Vector3 TransformVector(float x, float y, float z) const;
-		Vector3 TransformPoint(const Vector3& p) const;
-		Vector3 TransformPoint(float x, float y, float z) const;
+		constexpr Vector3 TransformVector(const Vector3& v) const;
+		constexpr Vector3 TransformVector(float x, float y, float z) const;
+		constexpr Vector3 TransformPoint(const Vector3& p) const;
+		constexpr Vector3 TransformPoint(float x, float y, float z) const;
 
-		Vector4 TransformPoint(const Vector4& p) const;
-		Vector4 TransformPoint(float x, float y, float z, float w) const;
+		constexpr Vector4 TransformPoint(const Vector4& p) const;
+		constexpr Vector4 TransformPoint(float x, float y, float z, float w) const;
 
-		const Matrix& Transpose();
-		const Matrix& Inverse();
+		constexpr const Matrix& Transpose();
+		constexpr const Matrix& Inverse();
 
-		Vector3 GetAxisX() const;
-		Vector3 GetAxisY() const;
-		Vector3 GetAxisZ() const;
-		Vector3 GetTranslation() const;
+		constexpr Vector3 GetAxisX() const;
+		constexpr Vector3 GetAxisY() const;
+		constexpr Vector3 GetAxisZ() const;
+		constexpr Vector3 GetTranslation() const;
 
-		static Matrix CreateTranslation(float x, float y, float z);
-		static Matrix CreateTranslation(const Vector3& t);
+		static constexpr Matrix CreateTranslation(float x, float y, float z);
+		static constexpr Matrix CreateTranslation(const Vector3& t);
 		static Matrix CreateRotationX(float pitch);
 		static Matrix CreateRotationY(float yaw);
 		static Matrix CreateRotationZ(float roll);
 		static Matrix CreateRotation(float pitch, float yaw, float roll);
 		static Matrix CreateRotation(const Vector3& r);
-		static Matrix CreateScale(float sx, float sy, float sz);
-		static Matrix CreateScale(const Vector3& s);
-		static Matrix Transpose(const Matrix& m);
-		static Matrix Inverse(const Matrix& m);
+		static constexpr Matrix CreateScale(float sx, float sy, float sz);
+		static constexpr Matrix CreateScale(const Vector3& s);
+		static constexpr Matrix Transpose(const Matrix& m);
+		static constexpr Matrix Inverse(const Matrix& m);
 
 		static Matrix CreateLookAtLH(const Vector3& origin, const Vector3& forward, const Vector3& up);
-		static Matrix CreatePerspectiveFovLH(float fovy, float aspect, float zn, float zf);
+		static constexpr Matrix CreatePerspectiveFovLH(float fovy, float aspect, float zn, float zf);
 
-		Vector4& operator[](int index);
-		Vector4 operator[](int index) const;
-		Matrix operator*(const Matrix& m) const;
-		const Matrix& operator*=(const Matrix& m);
+		constexpr Vector4& operator[](int index);
+		constexpr Vector4 operator[](int index) const;
+		constexpr Matrix operator*(const Matrix& m) const;
+		constexpr const Matrix& operator*=(const Matrix& m);
+		constexpr bool operator==(const Matrix& m) const;
 
 	private:
 
-		//Row-Major Matrix
+		//Row-Major Matrix, each row is one 16-byte aligned Vector4
 		Vector4 data[4]
 		{
 			{1,0,0,0}, //xAxis
@@ -71,5 +76,379 @@ namespace dae {
 		// v1x v1y v1z v1w
 		// v2x v2y v2z v2w
 		// v3x v3y v3z v3w
+
+		constexpr void InverseScalar();
+#if RASTERIZER_SIMD_SSE
+		void InverseSimd();
+#endif
 	};
-}
\ No newline at end of file
+
+	constexpr Matrix::Matrix(const Vector3& xAxis, const Vector3& yAxis, const Vector3& zAxis, const Vector3& t) :
+		Matrix({ xAxis, 0 }, { yAxis, 0 }, { zAxis, 0 }, { t, 1 })
+	{
+	}
+
+	constexpr Matrix::Matrix(const Vector4& xAxis, const Vector4& yAxis, const Vector4& zAxis, const Vector4& t) :
+		data{ xAxis, yAxis, zAxis, t }
+	{
+	}
+
+	constexpr Vector3 Matrix::TransformVector(const Vector3& v) const
+	{
+		return TransformVector(v.x, v.y, v.z);
+	}
+
+	constexpr Vector3 Matrix::TransformVector(float x, float y, float z) const
+	{
+		return Vector3{
+			data[0].x * x + data[1].x * y + data[2].x * z,
+			data[0].y * x + data[1].y * y + data[2].y * z,
+			data[0].z * x + data[1].z * y + data[2].z * z
+		};
+	}
+
+	constexpr Vector3 Matrix::TransformPoint(const Vector3& p) const
+	{
+		return TransformPoint(p.x, p.y, p.z);
+	}
+
+	constexpr Vector3 Matrix::TransformPoint(float x, float y, float z) const
+	{
+		return Vector3{
+			data[0].x * x + data[1].x * y + data[2].x * z + data[3].x,
+			data[0].y * x + data[1].y * y + data[2].y * z + data[3].y,
+			data[0].z * x + data[1].z * y + data[2].z * z + data[3].z,
+		};
+	}
+
+	constexpr Vector4 Matrix::TransformPoint(const Vector4& p) const
+	{
+		return TransformPoint(p.x, p.y, p.z, p.w);
+	}
+
+	constexpr Vector4 Matrix::TransformPoint(float x, float y, float z, float w) const
+	{
+#if RASTERIZER_SIMD_SSE
+		if (!std::is_constant_evaluated())
+		{
+			//Broadcast each coordinate against its row, same summation order as the scalar path
+			__m128 result{ _mm_mul_ps(_mm_set1_ps(x), data[0].Load()) };
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(y), data[1].Load()));
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(z), data[2].Load()));
+			result = _mm_add_ps(result, data[3].Load());
+			return Vector4::Store(result);
+		}
+#endif
+		return Vector4{
+			data[0].x * x + data[1].x * y + data[2].x * z + data[3].x,
+			data[0].y * x + data[1].y * y + data[2].y * z + data[3].y,
+			data[0].z * x + data[1].z * y + data[2].z * z + data[3].z,
+			data[0].w * x + data[1].w * y + data[2].w * z + data[3].w
+		};
+	}
+
+	constexpr const Matrix& Matrix::Transpose()
+	{
+#if RASTERIZER_SIMD_SSE
+		if (!std::is_constant_evaluated())
+		{
+			__m128 row0{ data[0].Load() };
+			__m128 row1{ data[1].Load() };
+			__m128 row2{ data[2].Load() };
+			__m128 row3{ data[3].Load() };
+			_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+			data[0] = Vector4::Store(row0);
+			data[1] = Vector4::Store(row1);
+			data[2] = Vector4::Store(row2);
+			data[3] = Vector4::Store(row3);
+			return *this;
+		}
+#endif
+		Matrix result{};
+		for (int r{ 0 }; r < 4; ++r)
+		{
+			for (int c{ 0 }; c < 4; ++c)
+			{
+				result[r][c] = data[c][r];
+			}
+		}
+
+		data[0] = result[0];
+		data[1] = result[1];
+		data[2] = result[2];
+		data[3] = result[3];
+
+		return *this;
+	}
+
+	constexpr const Matrix& Matrix::Inverse()
+	{
+#if RASTERIZER_SIMD_SSE
+		if (!std::is_constant_evaluated())
+		{
+			InverseSimd();
+			return *this;
+		}
+#endif
+		InverseScalar();
+		return *this;
+	}
+
+	constexpr void Matrix::InverseScalar()
+	{
+		//Optimized Inverse as explained in FGED1 - used widely in other libraries too.
+		const Vector3 a = data[0];
+		const Vector3 b = data[1];
+		const Vector3 c = data[2];
+		const Vector3 d = data[3];
+
+		const float x = data[0][3];
+		const float y = data[1][3];
+		const float z = data[2][3];
+		const float w = data[3][3];
+
+		Vector3 s = Vector3::Cross(a, b);
+		Vector3 t = Vector3::Cross(c, d);
+		Vector3 u = a * y - b * x;
+		Vector3 v = c * w - d * z;
+
+		float det = Vector3::Dot(s, v) + Vector3::Dot(t, u);
+		assert((!std::is_constant_evaluated() ? !AreEqual(det, 0.f) : det != 0.f) && "ERROR: determinant is 0, there is no INVERSE!");
+		float invDet = 1.f / det;
+
+		s *= invDet; t *= invDet; u *= invDet; v *= invDet;
+
+		const Vector3 r0 = Vector3::Cross(b, v) + t * y;
+		const Vector3 r1 = Vector3::Cross(v, a) - t * x;
+		const Vector3 r2 = Vector3::Cross(d, u) + s * w;
+		const Vector3 r3 = Vector3::Cross(u, c) - s * z;
+
+		data[0] = Vector4{ r0.x, r1.x, r2.x, r3.x };
+		data[1] = Vector4{ r0.y, r1.y, r2.y, r3.y };
+		data[2] = Vector4{ r0.z, r1.z, r2.z, r3.z };
+		data[3] = { { -Vector3::Dot(b, t)},{Vector3::Dot(a, t)},{-Vector3::Dot(d, s)},{Vector3::Dot(c, s)} };
+	}
+
+#if RASTERIZER_SIMD_SSE
+	inline void Matrix::InverseSimd()
+	{
+		//Same FGED1 inverse as InverseScalar, on xyz lanes with w cleared
+		const __m128 a{ Simd::ClearW(data[0].Load()) };
+		const __m128 b{ Simd::ClearW(data[1].Load()) };
+		const __m128 c{ Simd::ClearW(data[2].Load()) };
+		const __m128 d{ Simd::ClearW(data[3].Load()) };
+
+		const __m128 x{ _mm_set1_ps(data[0].w) };
+		const __m128 y{ _mm_set1_ps(data[1].w) };
+		const __m128 z{ _mm_set1_ps(data[2].w) };
+		const __m128 w{ _mm_set1_ps(data[3].w) };
+
+		__m128 s{ Simd::Cross3(a, b) };
+		__m128 t{ Simd::Cross3(c, d) };
+		__m128 u{ _mm_sub_ps(_mm_mul_ps(a, y), _mm_mul_ps(b, x)) };
+		__m128 v{ _mm_sub_ps(_mm_mul_ps(c, w), _mm_mul_ps(d, z)) };
+
+		const float det{ Simd::Dot3(s, v) + Simd::Dot3(t, u) };
+		assert((!AreEqual(det, 0.f)) && "ERROR: determinant is 0, there is no INVERSE!");
+		const __m128 invDet{ _mm_set1_ps(1.f / det) };
+
+		s = _mm_mul_ps(s, invDet);
+		t = _mm_mul_ps(t, invDet);
+		u = _mm_mul_ps(u, invDet);
+		v = _mm_mul_ps(v, invDet);
+
+		__m128 r0{ _mm_add_ps(Simd::Cross3(b, v), _mm_mul_ps(t, y)) };
+		__m128 r1{ _mm_sub_ps(Simd::Cross3(v, a), _mm_mul_ps(t, x)) };
+		__m128 r2{ _mm_add_ps(Simd::Cross3(d, u), _mm_mul_ps(s, w)) };
+		__m128 r3{ _mm_sub_ps(Simd::Cross3(u, c), _mm_mul_ps(s, z)) };
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+		data[0] = Vector4::Store(r0);
+		data[1] = Vector4::Store(r1);
+		data[2] = Vector4::Store(r2);
+		data[3] = Vector4{ -Simd::Dot3(b, t), Simd::Dot3(a, t), -Simd::Dot3(d, s), Simd::Dot3(c, s) };
+	}
+#endif
+
+	constexpr Matrix Matrix::Transpose(const Matrix& m)
+	{
+		Matrix out{ m };
+		out.Transpose();
+
+		return out;
+	}
+
+	constexpr Matrix Matrix::Inverse(const Matrix& m)
+	{
+		Matrix out{ m };
+		out.Inverse();
+
+		return out;
+	}
+
+	inline Matrix Matrix::CreateLookAtLH(const Vector3& origin, const Vector3& forward, const Vector3& up)
+	{
+		//TODO W1
+
+		return {};
+	}
+
+	constexpr Matrix Matrix::CreatePerspectiveFovLH(float fov, float aspect, float zn, float zf)
+	{
+		//Projection Matrix: World to view matrix
+		//Left Handed Coordinate system
+		return Matrix
+		{
+			Vector4{1 / (aspect * fov),	0.f,		0.f,					0.f},
+			Vector4{0.f,				1 / fov,	0.f,					0.f},
+			Vector4{0.f,				0.f,		zf / (zf - zn),			1.f},
+			Vector4{0.f,				0.f,		-(zf * zn) / (zf - zn),	0.f},
+		};		
+	}
+
+	constexpr Vector3 Matrix::GetAxisX() const
+	{
+		return data[0];
+	}
+
+	constexpr Vector3 Matrix::GetAxisY() const
+	{
+		return data[1];
+	}
+
+	constexpr Vector3 Matrix::GetAxisZ() const
+	{
+		return data[2];
+	}
+
+	constexpr Vector3 Matrix::GetTranslation() const
+	{
+		return data[3];
+	}
+
+	constexpr Matrix Matrix::CreateTranslation(float x, float y, float z)
+	{
+		return CreateTranslation({ x, y, z });
+	}
+
+	constexpr Matrix Matrix::CreateTranslation(const Vector3& t)
+	{
+		return { Vector3::UnitX, Vector3::UnitY, Vector3::UnitZ, t };
+	}
+
+	inline Matrix Matrix::CreateRotationX(float pitch)
+	{
+		return {
+			{1, 0, 0, 0},
+			{0, cos(pitch), -sin(pitch), 0},
+			{0, sin(pitch), cos(pitch), 0},
+			{0, 0, 0, 1}
+		};
+	}
+
+	inline Matrix Matrix::CreateRotationY(float yaw)
+	{
+		return {
+			{cos(yaw), 0, -sin(yaw), 0},
+			{0, 1, 0, 0},
+			{sin(yaw), 0, cos(yaw), 0},
+			{0, 0, 0, 1}
+		};
+	}
+
+	inline Matrix Matrix::CreateRotationZ(float roll)
+	{
+		return {
+			{cos(roll), sin(roll), 0, 0},
+			{-sin(roll), cos(roll), 0, 0},
+			{0, 0, 1, 0},
+			{0, 0, 0, 1}
+		};
+	}
+
+	inline Matrix Matrix::CreateRotation(float pitch, float yaw, float roll)
+	{
+		return CreateRotation({ pitch, yaw, roll });
+	}
+
+	inline Matrix Matrix::CreateRotation(const Vector3& r)
+	{
+		return CreateRotationX(r[0]) * CreateRotationY(r[1]) * CreateRotationZ(r[2]);
+	}
+
+	constexpr Matrix Matrix::CreateScale(float sx, float sy, float sz)
+	{
+		return { Vector3{sx, 0, 0}, Vector3{0, sy, 0}, Vector3{0, 0, sz}, Vector3::Zero };
+	}
+
+	constexpr Matrix Matrix::CreateScale(const Vector3& s)
+	{
+		return CreateScale(s[0], s[1], s[2]);
+	}
+
+#pragma region Operator Overloads
+	constexpr Vector4& Matrix::operator[](int index)
+	{
+		assert(index <= 3 && index >= 0);
+		return data[index];
+	}
+
+	constexpr Vector4 Matrix::operator[](int index) const
+	{
+		assert(index <= 3 && index >= 0);
+		return data[index];
+	}
+
+	constexpr bool Matrix::operator==(const Matrix& m) const
+	{
+		return data[0] == m.data[0] && data[1] == m.data[1] && data[2] == m.data[2] && data[3] == m.data[3];
+	}
+
+	constexpr Matrix Matrix::operator*(const Matrix& m) const
+	{
+		Matrix result{ *this };
+		result *= m;
+
+		return result;
+	}
+
+	constexpr const Matrix& Matrix::operator*=(const Matrix& m)
+	{
+#if RASTERIZER_SIMD_SSE
+		if (!std::is_constant_evaluated())
+		{
+			//Row r of the product is the sum of m's rows weighted by the elements of row r,
+			//accumulated in the same order as the dot products of the scalar path
+			const __m128 m0{ m.data[0].Load() };
+			const __m128 m1{ m.data[1].Load() };
+			const __m128 m2{ m.data[2].Load() };
+			const __m128 m3{ m.data[3].Load() };
+
+			for (int r{ 0 }; r < 4; ++r)
+			{
+				const __m128 row{ data[r].Load() };
+				__m128 result{ _mm_mul_ps(Simd::Splat<0>(row), m0) };
+				result = _mm_add_ps(result, _mm_mul_ps(Simd::Splat<1>(row), m1));
+				result = _mm_add_ps(result, _mm_mul_ps(Simd::Splat<2>(row), m2));
+				result = _mm_add_ps(result, _mm_mul_ps(Simd::Splat<3>(row), m3));
+				data[r] = Vector4::Store(result);
+			}
+
+			return *this;
+		}
+#endif
+		const Matrix copy{ *this };
+		const Matrix m_transposed = Transpose(m);
+
+		for (int r{ 0 }; r < 4; ++r)
+		{
+			for (int c{ 0 }; c < 4; ++c)
+			{
+				data[r][c] = Vector4::Dot(copy[r], m_transposed[c]);
+			}
+		}
+
+		return *this;
+	}
+#pragma endregion
+}
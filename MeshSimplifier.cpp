@@ -0,0 +1,397 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include "DataTypes.h"
+#include "Trace.h"
+
+namespace dae::MeshSimplifier
+{
+	namespace
+	{
+		//Raw float bits, so only exactly equal values are welded
+		template<size_t size>
+		struct FloatKey
+		{
+			uint32_t bits[size]{};
+
+			bool operator==(const FloatKey& other) const { return std::memcmp(bits, other.bits, sizeof(bits)) == 0; }
+		};
+
+		template<size_t size>
+		struct FloatKeyHash
+		{
+			size_t operator()(const FloatKey<size>& key) const
+			{
+				//FNV-1a over the words
+				uint64_t hash{ 14695981039346656037ull };
+				for (const uint32_t word : key.bits)
+				{
+					hash = (hash ^ word) * 1099511628211ull;
+				}
+				return static_cast<size_t>(hash);
+			}
+		};
+
+		template<size_t size>
+		FloatKey<size> MakeKey(std::initializer_list<float> values)
+		{
+			FloatKey<size> key{};
+			std::memcpy(key.bits, values.begin(), sizeof(key.bits));
+			return key;
+		}
+
+		//Sum of squared distances to a set of planes, the symmetric 4x4 matrix stored as its upper triangle.
+		//Doubles, the terms of large flat areas cancel out
+		struct Quadric
+		{
+			double xx{}, xy{}, xz{}, xw{};
+			double yy{}, yz{}, yw{};
+			double zz{}, zw{};
+			double ww{};
+
+			void AddPlane(const Vector3& normal, float distance)
+			{
+				const double x{ normal.x }, y{ normal.y }, z{ normal.z }, w{ distance };
+				xx += x * x; xy += x * y; xz += x * z; xw += x * w;
+				yy += y * y; yz += y * z; yw += y * w;
+				zz += z * z; zw += z * w;
+				ww += w * w;
+			}
+
+			Quadric& operator+=(const Quadric& other)
+			{
+				xx += other.xx; xy += other.xy; xz += other.xz; xw += other.xw;
+				yy += other.yy; yz += other.yz; yw += other.yw;
+				zz += other.zz; zw += other.zw;
+				ww += other.ww;
+				return *this;
+			}
+
+			double Evaluate(const Vector3& point) const
+			{
+				const double x{ point.x }, y{ point.y }, z{ point.z };
+				const double error{ xx * x * x + 2.0 * xy * x * y + 2.0 * xz * x * z + 2.0 * xw * x
+					+ yy * y * y + 2.0 * yz * y * z + 2.0 * yw * y
+					+ zz * z * z + 2.0 * zw * z
+					+ ww };
+				//Rounding can push a zero error just below
+				return std::max(error, 0.0);
+			}
+		};
+
+		struct Collapse
+		{
+			uint32_t from;
+			uint32_t to;
+			double cost;
+		};
+
+		Vector3 GetTriangleNormal(const Vector3& p0, const Vector3& p1, const Vector3& p2)
+		{
+			return Vector3::Cross(p1 - p0, p2 - p0);
+		}
+	}
+
+	float Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetNrTriangles, float maxError,
+		std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices)
+	{
+		TRACE_ZONE("MeshSimplifier::Simplify");
+
+		//Weld the corners. Tangents are not part of the key, the loader gives every corner its own,
+		//the welded vertex gets their average
+		std::vector<Vertex> welded{};
+		std::vector<uint32_t> triangles{};
+		triangles.reserve(indices.size());
+		{
+			std::unordered_map<FloatKey<8>, uint32_t, FloatKeyHash<8>> weldedIndices{};
+			weldedIndices.reserve(vertices.size());
+			for (const uint32_t vertexIdx : indices)
+			{
+				const Vertex& vertex{ vertices[vertexIdx] };
+				const FloatKey<8> key{ MakeKey<8>({ vertex.position.x, vertex.position.y, vertex.position.z,
+					vertex.uv.x, vertex.uv.y, vertex.normal.x, vertex.normal.y, vertex.normal.z }) };
+				const auto [it, isNew] { weldedIndices.try_emplace(key, static_cast<uint32_t>(welded.size())) };
+				if (isNew)
+				{
+					welded.emplace_back(vertex);
+				}
+				else
+				{
+					welded[it->second].tangent += vertex.tangent;
+				}
+				triangles.push_back(it->second);
+			}
+		}
+		for (Vertex& vertex : welded)
+		{
+			vertex.tangent = Vector3::Reject(vertex.tangent, vertex.normal).Normalized();
+		}
+
+		const uint32_t nrVertices{ static_cast<uint32_t>(welded.size()) };
+		const size_t nrTriangles{ triangles.size() / 3 };
+		std::vector<bool> isTriangleAlive(nrTriangles, true);
+		size_t nrAlive{ nrTriangles };
+		for (size_t triangleIdx{}; triangleIdx < nrTriangles; ++triangleIdx)
+		{
+			const uint32_t* pTriangle{ triangles.data() + triangleIdx * 3 };
+			if (pTriangle[0] == pTriangle[1] || pTriangle[1] == pTriangle[2] || pTriangle[2] == pTriangle[0])
+			{
+				isTriangleAlive[triangleIdx] = false;
+				--nrAlive;
+			}
+		}
+
+		//Vertices that share their position with another one sit on an attribute seam, collapsing one of them would
+		//tear the seam open. Both ends of an edge that does not have exactly two triangles are on a border
+		std::vector<bool> isLocked(nrVertices, false);
+		std::vector<uint32_t> positionIds(nrVertices);
+		std::vector<uint32_t> nrVerticesAtPosition{};
+		{
+			std::unordered_map<FloatKey<3>, uint32_t, FloatKeyHash<3>> positionIndices{};
+			positionIndices.reserve(nrVertices);
+			for (uint32_t vertexIdx{}; vertexIdx < nrVertices; ++vertexIdx)
+			{
+				const Vector3& position{ welded[vertexIdx].position };
+				const auto [it, isNew] { positionIndices.try_emplace(MakeKey<3>({ position.x, position.y, position.z }), static_cast<uint32_t>(nrVerticesAtPosition.size())) };
+				if (isNew)
+				{
+					nrVerticesAtPosition.push_back(0);
+				}
+				positionIds[vertexIdx] = it->second;
+				++nrVerticesAtPosition[it->second];
+			}
+
+			std::unordered_map<uint64_t, uint32_t> nrEdgeTriangles{};
+			nrEdgeTriangles.reserve(nrAlive * 3);
+			for (size_t triangleIdx{}; triangleIdx < nrTriangles; ++triangleIdx)
+			{
+				if (!isTriangleAlive[triangleIdx])
+					continue;
+				for (int corner{}; corner < 3; ++corner)
+				{
+					const uint32_t a{ positionIds[triangles[triangleIdx * 3 + corner]] };
+					const uint32_t b{ positionIds[triangles[triangleIdx * 3 + (corner + 1) % 3]] };
+					++nrEdgeTriangles[(static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b)];
+				}
+			}
+
+			std::vector<bool> isPositionLocked(nrVerticesAtPosition.size(), false);
+			for (const auto& [edge, count] : nrEdgeTriangles)
+			{
+				if (count == 2)
+					continue;
+				isPositionLocked[static_cast<uint32_t>(edge >> 32)] = true;
+				isPositionLocked[static_cast<uint32_t>(edge)] = true;
+			}
+			for (uint32_t vertexIdx{}; vertexIdx < nrVertices; ++vertexIdx)
+			{
+				const uint32_t positionId{ positionIds[vertexIdx] };
+				isLocked[vertexIdx] = nrVerticesAtPosition[positionId] > 1 || isPositionLocked[positionId];
+			}
+		}
+
+		//Planes of the triangles around every vertex
+		std::vector<Quadric> quadrics(nrVertices);
+		for (size_t triangleIdx{}; triangleIdx < nrTriangles; ++triangleIdx)
+		{
+			if (!isTriangleAlive[triangleIdx])
+				continue;
+			const uint32_t* pTriangle{ triangles.data() + triangleIdx * 3 };
+			const Vector3& p0{ welded[pTriangle[0]].position };
+			const Vector3 normal{ GetTriangleNormal(p0, welded[pTriangle[1]].position, welded[pTriangle[2]].position) };
+			const float length{ normal.Magnitude() };
+			if (length <= 0.f)
+				continue;
+
+			const Vector3 unitNormal{ normal / length };
+			for (int corner{}; corner < 3; ++corner)
+			{
+				quadrics[pTriangle[corner]].AddPlane(unitNormal, -Vector3::Dot(unitNormal, p0));
+			}
+		}
+
+		//Passes of independent collapses: a collapse touches the triangles around its vertex, their other vertices
+		//wait for the next pass, when the adjacency and costs are rebuilt. The adjacency is per position, so the
+		//triangles on both sides of a seam are found
+		const uint32_t nrPositions{ static_cast<uint32_t>(nrVerticesAtPosition.size()) };
+		const double maxCost{ static_cast<double>(maxError) * maxError };
+		double reachedCost{};
+		std::vector<uint32_t> adjacencyOffsets(nrPositions + 1);
+		std::vector<uint32_t> adjacency{};
+		std::vector<uint32_t> fillOffsets(nrPositions);
+		std::vector<Collapse> collapses{};
+		std::vector<bool> isTouched(nrPositions);
+		//Marks of the link test, a position is marked when its value equals the number of the collapse being tested
+		std::vector<uint32_t> neighborMarks(nrPositions, UINT32_MAX);
+		std::vector<uint32_t> sharedMarks(nrPositions, UINT32_MAX);
+		uint32_t nrTested{};
+		while (nrAlive > targetNrTriangles)
+		{
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (size_t triangleIdx{}; triangleIdx < nrTriangles; ++triangleIdx)
+			{
+				if (!isTriangleAlive[triangleIdx])
+					continue;
+				for (int corner{}; corner < 3; ++corner)
+				{
+					++adjacencyOffsets[positionIds[triangles[triangleIdx * 3 + corner]] + 1];
+				}
+			}
+			for (uint32_t positionId{}; positionId < nrPositions; ++positionId)
+			{
+				adjacencyOffsets[positionId + 1] += adjacencyOffsets[positionId];
+			}
+			adjacency.resize(adjacencyOffsets.back());
+			std::copy(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1, fillOffsets.begin());
+
+			collapses.clear();
+			for (size_t triangleIdx{}; triangleIdx < nrTriangles; ++triangleIdx)
+			{
+				if (!isTriangleAlive[triangleIdx])
+					continue;
+				for (int corner{}; corner < 3; ++corner)
+				{
+					const uint32_t a{ triangles[triangleIdx * 3 + corner] };
+					const uint32_t b{ triangles[triangleIdx * 3 + (corner + 1) % 3] };
+					adjacency[fillOffsets[positionIds[a]]++] = static_cast<uint32_t>(triangleIdx);
+
+					//Onto a locked vertex is fine, it stays where it is. The edge is inside the triangles of this corner of a seam
+					const auto addCollapse = [&](uint32_t from, uint32_t to)
+					{
+						if (isLocked[from])
+							return;
+						Quadric quadric{ quadrics[from] };
+						quadric += quadrics[to];
+						collapses.push_back(Collapse{ from, to, quadric.Evaluate(welded[to].position) });
+					};
+					addCollapse(a, b);
+					addCollapse(b, a);
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+			std::fill(isTouched.begin(), isTouched.end(), false);
+			size_t nrCollapsed{};
+			for (const Collapse& collapse : collapses)
+			{
+				if (nrAlive <= targetNrTriangles || collapse.cost > maxCost)
+					break;
+
+				//The vertex that goes away is not on a seam, it is the only one at its position
+				const uint32_t fromPosition{ positionIds[collapse.from] };
+				const uint32_t toPosition{ positionIds[collapse.to] };
+				if (isTouched[fromPosition] || isTouched[toPosition])
+					continue;
+
+				const uint32_t* pFirst{ adjacency.data() + adjacencyOffsets[fromPosition] };
+				const uint32_t* pEnd{ adjacency.data() + adjacencyOffsets[fromPosition + 1] };
+				const auto hasPosition = [&](const uint32_t* pTriangle, uint32_t positionId)
+				{
+					return positionIds[pTriangle[0]] == positionId || positionIds[pTriangle[1]] == positionId || positionIds[pTriangle[2]] == positionId;
+				};
+
+				//Link condition: the only positions next to both ends may be the far corners of the triangles on the edge,
+				//any other one would pinch the surface into a non manifold fold
+				const uint32_t mark{ nrTested++ };
+				uint32_t nrEdgeTriangles{};
+				for (const uint32_t* pTriangleIdx{ pFirst }; pTriangleIdx != pEnd; ++pTriangleIdx)
+				{
+					const uint32_t* pTriangle{ triangles.data() + *pTriangleIdx * 3 };
+					nrEdgeTriangles += hasPosition(pTriangle, toPosition);
+					for (int corner{}; corner < 3; ++corner)
+					{
+						neighborMarks[positionIds[pTriangle[corner]]] = mark;
+					}
+				}
+				uint32_t nrSharedNeighbors{};
+				for (uint32_t adjacencyIdx{ adjacencyOffsets[toPosition] }; adjacencyIdx < adjacencyOffsets[toPosition + 1]; ++adjacencyIdx)
+				{
+					const uint32_t* pTriangle{ triangles.data() + adjacency[adjacencyIdx] * 3 };
+					for (int corner{}; corner < 3; ++corner)
+					{
+						const uint32_t positionId{ positionIds[pTriangle[corner]] };
+						if (positionId == fromPosition || positionId == toPosition || neighborMarks[positionId] != mark || sharedMarks[positionId] == mark)
+							continue;
+						sharedMarks[positionId] = mark;
+						++nrSharedNeighbors;
+					}
+				}
+				if (nrSharedNeighbors != nrEdgeTriangles)
+					continue;
+
+				//No triangle that stays may flip or fold onto a line
+				const bool isFlipping{ std::any_of(pFirst, pEnd, [&](uint32_t triangleIdx)
+					{
+						const uint32_t* pTriangle{ triangles.data() + triangleIdx * 3 };
+						if (hasPosition(pTriangle, toPosition))
+							return false;
+
+						Vector3 positions[3]{ welded[pTriangle[0]].position, welded[pTriangle[1]].position, welded[pTriangle[2]].position };
+						const Vector3 oldNormal{ GetTriangleNormal(positions[0], positions[1], positions[2]) };
+						for (int corner{}; corner < 3; ++corner)
+						{
+							if (pTriangle[corner] == collapse.from)
+								positions[corner] = welded[collapse.to].position;
+						}
+						const Vector3 newNormal{ GetTriangleNormal(positions[0], positions[1], positions[2]) };
+						return Vector3::Dot(oldNormal, newNormal) < 1e-2f * oldNormal.Magnitude() * newNormal.Magnitude();
+					}) };
+				if (isFlipping)
+					continue;
+
+				for (const uint32_t* pTriangleIdx{ pFirst }; pTriangleIdx != pEnd; ++pTriangleIdx)
+				{
+					uint32_t* pTriangle{ triangles.data() + *pTriangleIdx * 3 };
+					for (int corner{}; corner < 3; ++corner)
+					{
+						isTouched[positionIds[pTriangle[corner]]] = true;
+					}
+					if (hasPosition(pTriangle, toPosition))
+					{
+						isTriangleAlive[*pTriangleIdx] = false;
+						--nrAlive;
+						continue;
+					}
+					for (int corner{}; corner < 3; ++corner)
+					{
+						if (pTriangle[corner] == collapse.from)
+							pTriangle[corner] = collapse.to;
+					}
+				}
+				quadrics[collapse.to] += quadrics[collapse.from];
+				reachedCost = std::max(reachedCost, collapse.cost);
+				++nrCollapsed;
+			}
+
+			if (nrCollapsed == 0)
+				break;
+		}
+
+		//Keep the vertices that are still used, in the order the triangles first use them
+		std::vector<uint32_t> remap(nrVertices, UINT32_MAX);
+		outVertices.clear();
+		outIndices.clear();
+		outIndices.reserve(nrAlive * 3);
+		for (size_t triangleIdx{}; triangleIdx < nrTriangles; ++triangleIdx)
+		{
+			if (!isTriangleAlive[triangleIdx])
+				continue;
+			for (int corner{}; corner < 3; ++corner)
+			{
+				const uint32_t vertexIdx{ triangles[triangleIdx * 3 + corner] };
+				if (remap[vertexIdx] == UINT32_MAX)
+				{
+					remap[vertexIdx] = static_cast<uint32_t>(outVertices.size());
+					outVertices.emplace_back(welded[vertexIdx]);
+				}
+				outIndices.push_back(remap[vertexIdx]);
+			}
+		}
+
+		return static_cast<float>(std::sqrt(reachedCost));
+	}
+}
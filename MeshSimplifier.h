@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dae
+{
+	struct Vertex;
+
+	//Level of detail chain built for every mesh at load
+	struct LodSettings
+	{
+		int maxNrLods{ 4 };				//Including the full detail mesh, 1 disables the simplification
+		float triangleRatio{ 0.5f };	//Triangle target of every level relative to the level before
+		float maxError{ 0.05f };		//Largest error a level may reach, relative to the diagonal of the mesh bounds
+	};
+}
+
+namespace dae::MeshSimplifier
+{
+	//Quadric error edge collapse of a triangle list. Vertices with the same position, uv and normal are welded first,
+	//then edges are collapsed onto one of their ends, cheapest first, until at most targetNrTriangles are left or the
+	//next collapse would move the surface further than maxError. Attribute seams and open borders are never collapsed.
+	//Writes an indexed triangle list and returns the error it reached, an object space distance
+	float Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetNrTriangles, float maxError,
+		std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices);
+}
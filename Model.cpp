@@ -0,0 +1,205 @@
+#include "Model.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "Texture.h"
+#include "Trace.h"
+#include "Utils.h"
+
+namespace dae
+{
+	namespace
+	{
+		//Zero padded up to a whole vertex block
+		MeshStreams BuildStreams(const std::vector<Vertex>& vertices)
+		{
+			MeshStreams streams{};
+			const size_t paddedCount{ GetPaddedVertexCount(vertices.size()) };
+			for (std::vector<float>* pStream : { &streams.positionX, &streams.positionY, &streams.positionZ,
+				&streams.normalX, &streams.normalY, &streams.normalZ, &streams.tangentX, &streams.tangentY, &streams.tangentZ })
+			{
+				pStream->resize(paddedCount);
+			}
+
+			for (size_t i{ 0 }; i < vertices.size(); ++i)
+			{
+				const Vertex& vertex{ vertices[i] };
+				streams.positionX[i] = vertex.position.x;
+				streams.positionY[i] = vertex.position.y;
+				streams.positionZ[i] = vertex.position.z;
+				streams.normalX[i] = vertex.normal.x;
+				streams.normalY[i] = vertex.normal.y;
+				streams.normalZ[i] = vertex.normal.z;
+				streams.tangentX[i] = vertex.tangent.x;
+				streams.tangentY[i] = vertex.tangent.y;
+				streams.tangentZ[i] = vertex.tangent.z;
+			}
+
+			return streams;
+		}
+
+		//Quantized, zero padded up to a whole vertex block
+		CompactMeshStreams BuildCompactStreams(const std::vector<Vertex>& vertices)
+		{
+			CompactMeshStreams streams{};
+			const size_t paddedCount{ GetPaddedVertexCount(vertices.size()) };
+			for (std::vector<float>* pStream : { &streams.positionX, &streams.positionY, &streams.positionZ })
+			{
+				pStream->resize(paddedCount);
+			}
+			for (std::vector<uint32_t>* pStream : { &streams.normal, &streams.tangent, &streams.uv })
+			{
+				pStream->resize(paddedCount);
+			}
+
+			for (size_t i{ 0 }; i < vertices.size(); ++i)
+			{
+				const Vertex& vertex{ vertices[i] };
+				streams.positionX[i] = vertex.position.x;
+				streams.positionY[i] = vertex.position.y;
+				streams.positionZ[i] = vertex.position.z;
+				streams.normal[i] = VertexPacking::EncodeOctahedral(vertex.normal);
+				streams.tangent[i] = VertexPacking::EncodeOctahedral(vertex.tangent);
+				streams.uv[i] = VertexPacking::PackHalf2(vertex.uv);
+			}
+
+			return streams;
+		}
+
+		//Runs of consecutive triangles, the index order of the file keeps them spatially close
+		std::vector<MeshCluster> BuildClusters(const Mesh& mesh)
+		{
+			constexpr uint32_t clusterSize{ 128 };
+			const uint32_t nrTriangles{ static_cast<uint32_t>(mesh.GetNrTriangles()) };
+
+			std::vector<MeshCluster> clusters{};
+			clusters.reserve((nrTriangles + clusterSize - 1) / clusterSize);
+			for (uint32_t firstTriangle{}; firstTriangle < nrTriangles; firstTriangle += clusterSize)
+			{
+				MeshCluster cluster{ firstTriangle, std::min(clusterSize, nrTriangles - firstTriangle) };
+				for (uint32_t triangleNr{ firstTriangle }; triangleNr < firstTriangle + cluster.nrTriangles; ++triangleNr)
+				{
+					uint32_t triangle[3]{};
+					mesh.GetTriangle(triangleNr, triangle);
+					for (const uint32_t vertexIdx : triangle)
+					{
+						cluster.bounds.Grow(mesh.vertices[vertexIdx].position);
+					}
+				}
+				clusters.emplace_back(cluster);
+			}
+
+			return clusters;
+		}
+
+		//Bounds, clusters and the streams of the vertex format. The compact format drops the vertex array
+		void FinalizeMesh(Mesh& mesh, VertexFormat vertexFormat)
+		{
+			mesh.nrVertices = mesh.vertices.size();
+			for (const Vertex& vertex : mesh.vertices)
+			{
+				mesh.bounds.Grow(vertex.position);
+			}
+			mesh.clusters = BuildClusters(mesh);
+			mesh.vertexFormat = vertexFormat;
+			switch (vertexFormat)
+			{
+			case VertexFormat::Float:
+				mesh.streams = BuildStreams(mesh.vertices);
+				break;
+			case VertexFormat::Compact:
+				//The compact streams hold everything the pipeline reads, drop the vertex array
+				mesh.compactStreams = BuildCompactStreams(mesh.vertices);
+				std::vector<Vertex>{}.swap(mesh.vertices);
+				break;
+			}
+		}
+
+		//Every level is simplified from the full detail mesh, so the errors do not add up along the chain.
+		//The chain ends early once the error limit stops the simplifier from making real progress
+		void BuildLods(std::vector<Mesh>& lods, const LodSettings& settings)
+		{
+			TRACE_ZONE("Model::BuildLods");
+			lods.reserve(std::max(settings.maxNrLods, 1));
+			const Mesh& source{ lods.front() };
+
+			//The simplifier takes a plain triangle list
+			std::vector<uint32_t> triangleList(source.GetNrTriangles() * 3);
+			for (size_t triangleNr{}; triangleNr < source.GetNrTriangles(); ++triangleNr)
+			{
+				uint32_t triangle[3]{};
+				source.GetTriangle(triangleNr, triangle);
+				std::copy(triangle, triangle + 3, triangleList.begin() + triangleNr * 3);
+			}
+
+			BoundingBox bounds{};
+			for (const Vertex& vertex : source.vertices)
+			{
+				bounds.Grow(vertex.position);
+			}
+			const float maxError{ settings.maxError * bounds.GetExtent().Magnitude() };
+
+			float targetNrTriangles{ static_cast<float>(source.GetNrTriangles()) };
+			for (int lod{ 1 }; lod < settings.maxNrLods; ++lod)
+			{
+				targetNrTriangles *= settings.triangleRatio;
+
+				Mesh level{};
+				level.lodError = MeshSimplifier::Simplify(lods.front().vertices, triangleList, static_cast<size_t>(targetNrTriangles), maxError, level.vertices, level.indices);
+				if (level.indices.empty() || level.GetNrTriangles() * 10 > lods.back().GetNrTriangles() * 9)
+					break;
+				lods.emplace_back(std::move(level));
+			}
+		}
+	}
+
+	Model::~Model()
+	{
+		delete m_pDiffuseTexture;
+		delete m_pNormalTexture;
+		delete m_pGlossinessTexture;
+		delete m_pSpecularTexture;
+	}
+
+	std::shared_ptr<const Model> Model::LoadFromFiles(const std::string& objPath, const std::string& diffusePath,
+		const std::string& normalPath, const std::string& glossinessPath, const std::string& specularPath, VertexFormat vertexFormat, const LodSettings& lodSettings)
+	{
+		TRACE_ZONE("Model::LoadFromFiles");
+
+		//Constructor is private, so no make_shared
+		std::shared_ptr<Model> pModel{ new Model() };
+
+		std::vector<Mesh>& lods{ pModel->m_Lods };
+		lods.resize(1);
+		if (!Utils::ParseOBJ(objPath, lods.front().vertices, lods.front().indices))
+		{
+			assert(false && "Obj file is not found");
+			return nullptr;
+		}
+
+		BuildLods(lods, lodSettings);
+		for (Mesh& mesh : lods)
+		{
+			FinalizeMesh(mesh, vertexFormat);
+		}
+
+		pModel->m_pDiffuseTexture = Texture::LoadFromFile(diffusePath);
+		pModel->m_pNormalTexture = Texture::LoadFromFile(normalPath);
+		pModel->m_pGlossinessTexture = Texture::LoadFromFile(glossinessPath);
+		pModel->m_pSpecularTexture = Texture::LoadFromFile(specularPath);
+
+		return pModel;
+	}
+
+	std::shared_ptr<const Model> Model::LoadVehicle(VertexFormat vertexFormat, const LodSettings& lodSettings)
+	{
+		return LoadFromFiles("Resources/vehicle.obj",
+			"Resources/vehicle_diffuse.png",
+			"Resources/vehicle_normal.png",
+			"Resources/vehicle_gloss.png",
+			"Resources/vehicle_specular.png",
+			vertexFormat,
+			lodSettings);
+	}
+}
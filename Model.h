@@ -0,0 +1,49 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DataTypes.h"
+#include "MeshSimplifier.h"
+
+namespace dae
+{
+	class Texture;
+
+	//Immutable mesh + texture set. Loaded once and shared (read-only) between any number of renderers/threads
+	class Model final
+	{
+	public:
+		~Model();
+
+		Model(const Model&) = delete;
+		Model(Model&&) noexcept = delete;
+		Model& operator=(const Model&) = delete;
+		Model& operator=(Model&&) noexcept = delete;
+
+		static std::shared_ptr<const Model> LoadFromFiles(const std::string& objPath, const std::string& diffusePath,
+			const std::string& normalPath, const std::string& glossinessPath, const std::string& specularPath,
+			VertexFormat vertexFormat = VertexFormat::Float, const LodSettings& lodSettings = {});
+		static std::shared_ptr<const Model> LoadVehicle(VertexFormat vertexFormat = VertexFormat::Float, const LodSettings& lodSettings = {});
+
+		//Full detail
+		const Mesh& GetMesh() const { return m_Lods.front(); }
+		//Level of detail chain, level 0 is the full detail mesh and every next level has fewer triangles
+		size_t GetNrLods() const { return m_Lods.size(); }
+		const Mesh& GetLod(size_t lod) const { return m_Lods[lod]; }
+		const Texture* GetDiffuseTexture() const { return m_pDiffuseTexture; }
+		const Texture* GetNormalTexture() const { return m_pNormalTexture; }
+		const Texture* GetGlossinessTexture() const { return m_pGlossinessTexture; }
+		const Texture* GetSpecularTexture() const { return m_pSpecularTexture; }
+
+	private:
+		Model() = default;
+
+		std::vector<Mesh> m_Lods{};
+
+		Texture* m_pDiffuseTexture{};
+		Texture* m_pNormalTexture{};
+		Texture* m_pGlossinessTexture{};
+		Texture* m_pSpecularTexture{};
+	};
+}
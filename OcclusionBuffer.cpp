@@ -0,0 +1,181 @@
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#include "Simd.h"
+
+namespace dae
+{
+	OcclusionBuffer::OcclusionBuffer(int width, int height, int targetWidth, int targetHeight)
+		: m_MaxWidth{ width }
+		, m_MaxHeight{ height }
+	{
+		SetTargetSize(targetWidth, targetHeight);
+	}
+
+	void OcclusionBuffer::SetTargetSize(int targetWidth, int targetHeight)
+	{
+		assert(targetWidth > 0 && targetHeight > 0);
+		//Every texel needs at least one pixel under it
+		m_Width = std::min(m_MaxWidth, targetWidth);
+		m_Height = std::min(m_MaxHeight, targetHeight);
+		m_TargetWidth = targetWidth;
+		m_TargetHeight = targetHeight;
+		m_TexelWidth = static_cast<float>(targetWidth) / static_cast<float>(m_Width);
+		m_TexelHeight = static_cast<float>(targetHeight) / static_cast<float>(m_Height);
+		m_Depths.assign(static_cast<size_t>(m_Width) * m_Height, FLT_MAX);
+
+		m_SampleStride = (targetWidth + Simd::Float8::laneCount - 1) / Simd::Float8::laneCount * Simd::Float8::laneCount;
+		m_SampleDepths.assign(static_cast<size_t>(m_SampleStride) * targetHeight, FLT_MAX);
+
+		//The same mapping IsOccluded uses for the footprint of a box
+		m_TexelColumns.resize(targetWidth);
+		for (int x{}; x < targetWidth; ++x)
+		{
+			m_TexelColumns[x] = std::min(static_cast<int>(static_cast<float>(x) / m_TexelWidth), m_Width - 1);
+		}
+	}
+
+	void OcclusionBuffer::Clear()
+	{
+		std::fill(m_SampleDepths.begin(), m_SampleDepths.end(), FLT_MAX);
+	}
+
+	void OcclusionBuffer::RasterizeTriangle(const Vector2& v0, const Vector2& v1, const Vector2& v2, float depth0, float depth1, float depth2)
+	{
+		using Simd::Float8;
+		constexpr int laneCount{ Float8::laneCount };
+
+		//Pixels under the bounding box, whole SIMD blocks wide. Lanes outside the triangle fail the edge tests
+		const Vector2 minRaster{ Vector2::Min(v0, Vector2::Min(v1, v2)) };
+		const Vector2 maxRaster{ Vector2::Max(v0, Vector2::Max(v1, v2)) };
+		const int firstX{ std::clamp(static_cast<int>(minRaster.x), 0, m_TargetWidth) / laneCount * laneCount };
+		const int endX{ std::clamp(static_cast<int>(maxRaster.x) + 1, 0, m_TargetWidth) };
+		const int firstY{ std::clamp(static_cast<int>(minRaster.y), 0, m_TargetHeight) };
+		const int endY{ std::clamp(static_cast<int>(maxRaster.y) + 1, 0, m_TargetHeight) };
+		if (firstX >= endX || firstY >= endY)
+			return;
+
+		//Edge functions in the form the renderer evaluates them. A pixel only counts when it is inside by more than
+		//the rounding error, the renderer might reject pixels right on an edge
+		struct Edge
+		{
+			Vector2 from;
+			Vector2 direction;
+			float tolerance;
+		};
+		const auto createEdge = [](const Vector2& from, const Vector2& to)
+		{
+			const Vector2 direction{ to - from };
+			return Edge{ from, direction, m_EdgeTolerance * (std::abs(direction.x) + std::abs(direction.y)) };
+		};
+		const Edge edges[3]{ createEdge(v0, v1), createEdge(v1, v2), createEdge(v2, v0) };
+
+		//Depth plane built like the attribute planes of the renderer, pushed back by its worst rounding error
+		const Vector2 edge01{ v1 - v0 };
+		const Vector2 edge12{ v2 - v1 };
+		const Vector2 edge20{ v0 - v2 };
+		const float invArea{ 1.f / Vector2::Cross(edge01, edge12) };
+		const float depthDx{ -edge12.y * invArea * depth0 + -edge20.y * invArea * depth1 + -edge01.y * invArea * depth2 };
+		const float depthDy{ edge12.x * invArea * depth0 + edge20.x * invArea * depth1 + edge01.x * invArea * depth2 };
+		const float depthAtOrigin{ depth0 - depthDx * v0.x - depthDy * v0.y };
+		const float depthError{ 4.f * FLT_EPSILON * (std::abs(depthAtOrigin) + std::abs(depthDx) * maxRaster.x + std::abs(depthDy) * maxRaster.y) };
+		const Float8 depthStart{ Float8::Set(depthAtOrigin + m_DepthBias + depthError) };
+		const Float8 depthStepX{ Float8::Set(depthDx) };
+
+		const float laneOffsets[laneCount]{ 0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f };
+		const Float8 lanes{ Float8::Load(laneOffsets) };
+
+		for (int y{ firstY }; y < endY; ++y)
+		{
+			const float pixelY{ static_cast<float>(y) };
+			float* pRow{ m_SampleDepths.data() + static_cast<size_t>(y) * m_SampleStride };
+			const Float8 rowDepth{ Float8::Set(depthDy * pixelY) };
+
+			for (int x{ firstX }; x < endX; x += laneCount)
+			{
+				const Float8 pixelX{ Float8::Set(static_cast<float>(x)) + lanes };
+
+				Float8 coverage{ Float8::Set(FLT_MAX) };
+				for (const Edge& edge : edges)
+				{
+					const Float8 edgeValue{ Float8::Set(edge.direction.x * (pixelY - edge.from.y)) - Float8::Set(edge.direction.y) * (pixelX - Float8::Set(edge.from.x)) };
+					coverage = Float8::Min(coverage, edgeValue - Float8::Set(edge.tolerance));
+				}
+
+				const Float8 depth{ depthStart + depthStepX * pixelX + rowDepth };
+				const Float8 current{ Float8::Load(pRow + x) };
+				Float8::Min(current, Float8::SelectNotNegative(coverage, depth, current)).Store(pRow + x);
+			}
+		}
+	}
+
+	void OcclusionBuffer::Resolve()
+	{
+		std::fill(m_Depths.begin(), m_Depths.end(), 0.f);
+
+		//A texel promises only the farthest depth of its pixels, uncovered pixels stay at FLT_MAX
+		for (int y{}; y < m_TargetHeight; ++y)
+		{
+			const int texelY{ std::min(static_cast<int>(static_cast<float>(y) / m_TexelHeight), m_Height - 1) };
+			const float* pSamples{ m_SampleDepths.data() + static_cast<size_t>(y) * m_SampleStride };
+			float* pTexels{ m_Depths.data() + static_cast<size_t>(texelY) * m_Width };
+			for (int x{}; x < m_TargetWidth; ++x)
+			{
+				float& texel{ pTexels[m_TexelColumns[x]] };
+				texel = std::max(texel, pSamples[x]);
+			}
+		}
+	}
+
+	bool OcclusionBuffer::IsOccluded(const ScreenBounds& bounds) const
+	{
+		if (bounds.max.x < 0.f || bounds.max.y < 0.f || bounds.min.x >= static_cast<float>(m_TargetWidth) || bounds.min.y >= static_cast<float>(m_TargetHeight))
+			return false;
+
+		const int firstX{ std::max(static_cast<int>(bounds.min.x / m_TexelWidth), 0) };
+		const int lastX{ std::min(static_cast<int>(bounds.max.x / m_TexelWidth), m_Width - 1) };
+		const int firstY{ std::max(static_cast<int>(bounds.min.y / m_TexelHeight), 0) };
+		const int lastY{ std::min(static_cast<int>(bounds.max.y / m_TexelHeight), m_Height - 1) };
+
+		//Occluded only when the box is behind the occluders under every texel it touches
+		for (int y{ firstY }; y <= lastY; ++y)
+		{
+			const float* pRow{ m_Depths.data() + static_cast<size_t>(y) * m_Width };
+			for (int x{ firstX }; x <= lastX; ++x)
+			{
+				if (pRow[x] >= bounds.minDepth)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	bool OcclusionBuffer::ProjectBox(const BoundingBox& box, const Matrix& worldViewProjection, int targetWidth, int targetHeight, ScreenBounds& bounds)
+	{
+		bounds.min = { FLT_MAX, FLT_MAX };
+		bounds.max = { -FLT_MAX, -FLT_MAX };
+		bounds.minDepth = FLT_MAX;
+
+		for (int corner{}; corner < 8; ++corner)
+		{
+			const Vector4 clip{ worldViewProjection.TransformPoint(Vector4{
+				corner & 1 ? box.max.x : box.min.x,
+				corner & 2 ? box.max.y : box.min.y,
+				corner & 4 ? box.max.z : box.min.z,
+				1.f }) };
+			if (clip.w <= 0.f)
+				return false;
+
+			//Same viewport mapping as the vertex stage
+			const Vector2 raster{ (clip.x / clip.w + 1.f) / 2.f * static_cast<float>(targetWidth), (1.f - clip.y / clip.w) / 2.f * static_cast<float>(targetHeight) };
+			bounds.min = Vector2::Min(bounds.min, raster);
+			bounds.max = Vector2::Max(bounds.max, raster);
+			bounds.minDepth = std::min(bounds.minDepth, clip.z / clip.w);
+		}
+		return true;
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+
+#include "BoundingVolumes.h"
+#include "Vector2.h"
+
+namespace dae
+{
+	//Footprint of a box in the raster space of the render target
+	struct ScreenBounds
+	{
+		Vector2 min{};
+		Vector2 max{};
+		float minDepth{};		//Nearest NDC depth of the box
+	};
+
+	//Low resolution depth buffer for occlusion culling. Every texel holds a depth that all render target pixels
+	//under it are guaranteed to reach once the occluders are drawn, so geometry behind it can be skipped without
+	//changing the image. The occluders are rasterized depth only at the pixels of the render target, the texels
+	//keep the farthest of their pixels
+	class OcclusionBuffer final
+	{
+	public:
+		//Texel grid of at most width x height, the target size is the largest SetTargetSize is called with
+		OcclusionBuffer(int width, int height, int targetWidth, int targetHeight);
+		~OcclusionBuffer() = default;
+
+		OcclusionBuffer(const OcclusionBuffer&) = delete;
+		OcclusionBuffer(OcclusionBuffer&&) noexcept = delete;
+		OcclusionBuffer& operator=(const OcclusionBuffer&) = delete;
+		OcclusionBuffer& operator=(OcclusionBuffer&&) noexcept = delete;
+
+		//Follows a render target that changed size, without allocating when it is not larger than the one it was built for
+		void SetTargetSize(int targetWidth, int targetHeight);
+		void Clear();
+		//Front facing triangle in target raster space with the NDC depth of its corners
+		void RasterizeTriangle(const Vector2& v0, const Vector2& v1, const Vector2& v2, float depth0, float depth1, float depth2);
+		//Reduces the rasterized pixels to the texels, call once all occluders are drawn
+		void Resolve();
+		[[nodiscard]] bool IsOccluded(const ScreenBounds& bounds) const;
+
+		//False when part of the box is behind the camera, it has no usable footprint then
+		static bool ProjectBox(const BoundingBox& box, const Matrix& worldViewProjection, int targetWidth, int targetHeight, ScreenBounds& bounds);
+
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+		const float* GetDepths() const { return m_Depths.data(); }
+
+	private:
+		//Cover the rounding difference between the edge functions and depth planes here and those of the renderer
+		static constexpr float m_DepthBias{ 1e-6f };
+		static constexpr float m_EdgeTolerance{ 1e-3f };
+
+		const int m_MaxWidth;
+		const int m_MaxHeight;
+		int m_Width{};
+		int m_Height{};
+		int m_TargetWidth{};
+		int m_TargetHeight{};
+		//Render target pixels per texel
+		float m_TexelWidth{};
+		float m_TexelHeight{};
+		std::vector<float> m_Depths{};
+
+		//Full resolution occluder depth, rows padded to whole SIMD blocks
+		int m_SampleStride{};
+		std::vector<float> m_SampleDepths{};
+		//Texel column of every render target column
+		std::vector<int> m_TexelColumns{};
+	};
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+#include "FrameArena.h"
+
+namespace dae::RadixSort
+{
+	//Writes the order of count items by increasing depth to pOrder. The depths are quantized to 16 bits over their
+	//own range and sorted with two stable 8 bit passes, items with the same key keep their submission order
+	inline void SortByDepth(const float* pDepths, uint32_t count, uint32_t* pOrder, FrameArena& arena)
+	{
+		if (count == 0)
+			return;
+
+		float minDepth{ pDepths[0] };
+		float maxDepth{ pDepths[0] };
+		for (uint32_t i{ 1 }; i < count; ++i)
+		{
+			minDepth = std::min(minDepth, pDepths[i]);
+			maxDepth = std::max(maxDepth, pDepths[i]);
+		}
+		const float scale{ maxDepth > minDepth ? static_cast<float>(UINT16_MAX) / (maxDepth - minDepth) : 0.f };
+
+		uint16_t* pKeys{ arena.Allocate<uint16_t>(count) };
+		for (uint32_t i{}; i < count; ++i)
+		{
+			pKeys[i] = static_cast<uint16_t>(std::min((pDepths[i] - minDepth) * scale, static_cast<float>(UINT16_MAX)));
+		}
+
+		//Low byte into the scratch order, high byte back into pOrder
+		uint32_t* pScratch{ arena.Allocate<uint32_t>(count) };
+		const auto sortPass = [pKeys, count](const uint32_t* pFrom, uint32_t* pTo, int shift)
+		{
+			uint32_t offsets[256]{};
+			for (uint32_t i{}; i < count; ++i)
+			{
+				++offsets[(pKeys[pFrom[i]] >> shift) & 0xFFu];
+			}
+			uint32_t total{};
+			for (uint32_t& offset : offsets)
+			{
+				const uint32_t nrInBucket{ offset };
+				offset = total;
+				total += nrInBucket;
+			}
+			for (uint32_t i{}; i < count; ++i)
+			{
+				pTo[offsets[(pKeys[pFrom[i]] >> shift) & 0xFFu]++] = pFrom[i];
+			}
+		};
+
+		for (uint32_t i{}; i < count; ++i)
+		{
+			pOrder[i] = i;
+		}
+		sortPass(pOrder, pScratch, 0);
+		sortPass(pScratch, pOrder, 8);
+	}
+}
@@ -1,368 +1,2905 @@
 //External includes
 #include "SDL.h"
 #include "SDL_surface.h"
+#include "SDL_image.h"
+
+//Standard includes
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <new>
+#include <utility>
 
 //Project includes
 #include "Renderer.h"
+#include "AllocationCounter.h"
+#include "CameraPath.h"
+#include "JobSystem.h"
 #include "Math.h"
 #include "Matrix.h"
+#include "Model.h"
+#include "RadixSort.h"
 #include "Texture.h"
-#include "Utils.h"
-#include <future>
-#include <ppl.h>
+#include "Trace.h"
+
+using namespace dae;
+
+Renderer::Renderer(SDL_Window* pWindow)
+	:Renderer(pWindow, Model::LoadVehicle(), 0, 0)
+{
+}
+
+Renderer::Renderer(int width, int height, VertexFormat vertexFormat)
+	:Renderer(nullptr, Model::LoadVehicle(vertexFormat), width, height)
+{
+}
+
+Renderer::Renderer(std::shared_ptr<const Model> pModel, int width, int height)
+	:Renderer(nullptr, std::move(pModel), width, height)
+{
+}
+
+Renderer::Renderer(SDL_Window* pWindow, std::shared_ptr<const Model> pModel, int width, int height)
+	:m_pWindow(pWindow)
+	,m_Width{ width }
+	,m_Height{ height }
+	,m_MsPerCount{ 1000.f / static_cast<float>(SDL_GetPerformanceFrequency()) }
+{
+	//Initialize
+	if (pWindow)
+	{
+		SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
+	}
+	assert(m_Width > 0 && m_Height > 0);
+	m_OutputWidth = m_Width;
+	m_OutputHeight = m_Height;
+
+	InitializeBuffer();
+	InitializeCamera();
+	InitializeScene(std::move(pModel));
+	SetNrWorkers(JobSystem::GetDefaultNrWorkers());
+}
+
+Renderer::~Renderer()
+{
+	//The front buffer is owned by the window
+	SDL_FreeSurface(m_pBackBuffer);
+	//m_pBackBufferPixels points into m_pBackBuffer and is freed with it
+	delete[] m_pScaledPixels;
+	delete[] m_pDepthBufferPixels;
+	delete[] m_pShadeCountPixels;
+	delete[] m_pHistoryPixels;
+	delete[] m_pNextHistoryPixels;
+	delete[] m_pDrawIndexPixels;
+	delete[] m_pHistoryInstancePixels;
+	delete[] m_pNextHistoryInstancePixels;
+	delete[] m_pSampleDepths;
+	delete[] m_pSampleColors;
+	delete[] m_pExpandedPixels;
+	delete[] m_pExpandedTiles;
+	delete m_pJobSystem;
+}
+
+void Renderer::Update(Timer* pTimer)
+{
+	m_Camera.Update(pTimer);
+	UpdateMesh(pTimer->GetElapsed());
+	UpdateDynamicResolution(pTimer->GetElapsed());
+}
+
+void Renderer::Advance(float elapsedSec)
+{
+	m_Camera.UpdateMatrices();
+	UpdateMesh(elapsedSec);
+}
+
+void Renderer::Render()
+{
+	TRACE_ZONE("Renderer::Render");
+	uint64_t lapCounter{ SDL_GetPerformanceCounter() };
+	const uint64_t frameStartCounter{ lapCounter };
+	const uint64_t nrAllocationsAtStart{ AllocationCounter::GetNrAllocations() };
+
+	//Nothing that ends up in the image changed, the back buffer still holds the last frame
+	const bool areTransformsDirty{ m_Camera.isDirty || m_Scene.GetVersion() != m_TransformedSceneVersion };
+	const bool areLightsDirty{ m_Scene.GetLightVersion() != m_LitLightVersion };
+	m_IsFrameReused = !areTransformsDirty && !areLightsDirty && !m_IsFrameDirty;
+	if (m_IsFrameReused)
+	{
+		m_StageTimings = {};
+		m_PipelineStats = {};
+		UpdateSDL();
+		m_StageTimings.present = Lap(lapCounter);
+		m_StageTimings.frame = m_StageTimings.present;
+		return;
+	}
+
+	//Stages that do not run this frame report 0
+	m_StageTimings = {};
+	ResetState();
+	m_StageTimings.clear = Lap(lapCounter);
+
+	//Only the image state changed (render mode, lighting, ...), the visible instances and transformed vertices are still valid
+	if (areTransformsDirty)
+	{
+		//Models only get drawn through instances, which change the scene version
+		if (m_IsMaterialAtlas && m_pMaterialAtlases.size() != m_Scene.GetNrModels())
+		{
+			BuildMaterialAtlases();
+		}
+		CullInstances();
+		SortVisibleInstances();
+	}
+	BuildInstanceDraws();
+	BuildClusterDraws();
+	PrepareLights();
+	m_StageTimings.cull = Lap(lapCounter);
+
+	if (areTransformsDirty)
+	{
+		TransformVertices();
+	}
+	m_StageTimings.vertexTransform = Lap(lapCounter);
+
+	SetupTriangles();
+	m_StageTimings.triangleSetup = Lap(lapCounter);
+
+	//Shading runs in batches in between rasterization on every worker, the wall time is split by its share
+	const float shadeShare{ RasterizeTriangles() };
+	const float rasterAndShadeMs{ Lap(lapCounter) };
+	m_StageTimings.shade = rasterAndShadeMs * shadeShare;
+	m_StageTimings.raster = rasterAndShadeMs - m_StageTimings.shade;
+
+	if (IsTrackingOverdraw())
+	{
+		ResolveOverdraw(m_pWorkers[0].stats);
+		m_StageTimings.shade += Lap(lapCounter);
+	}
+
+	if (IsMultisamplingActive())
+	{
+		ResolveMultisampling();
+		m_StageTimings.resolve = Lap(lapCounter);
+	}
+
+	const bool wasHistoryValid{ m_IsHistoryValid };
+	if (IsCheckerboardActive())
+	{
+		ReconstructCheckerboard();
+		m_StageTimings.reconstruct = Lap(lapCounter);
+	}
+	MergeWorkerStats();
+
+	if (m_pRenderPixels != m_pBackBufferPixels)
+	{
+		UpscaleToOutput();
+		m_StageTimings.upscale = Lap(lapCounter);
+	}
+
+	UpdateSDL();
+	m_StageTimings.present = Lap(lapCounter);
+
+	m_StageTimings.frame = static_cast<float>(lapCounter - frameStartCounter) * m_MsPerCount;
+	m_PipelineStats.heapAllocations = AllocationCounter::GetNrAllocations() - nrAllocationsAtStart;
+
+	m_Camera.isDirty = false;
+	m_TransformedSceneVersion = m_Scene.GetVersion();
+	m_LitLightVersion = m_Scene.GetLightVersion();
+	//The half taken from the history only matches a full render when a still frame follows a still one
+	m_IsFrameDirty = IsCheckerboardActive() && (areTransformsDirty || areLightsDirty || !wasHistoryValid);
+}
+
+void dae::Renderer::SetupTriangles()
+{
+	TRACE_ZONE("SetupTriangles");
+
+	//Triangles of all visible clusters, numbered back to back in instance order
+	const size_t nrTriangles{ m_NrTrianglesSubmitted };
+	const size_t nrChunks{ (nrTriangles + m_TriangleChunkSize - 1) / m_TriangleChunkSize };
+	m_pChunks = m_FrameArena.Allocate<TriangleChunk>(nrChunks);
+	m_NrChunks = nrChunks;
+	//Every submitted triangle can survive, so the chunk size bounds the output. Taken up front instead of by the
+	//worker that runs the chunk: how the chunks spread over the workers changes every frame, the total does not
+	TriangleSetup* pChunkTriangles{ m_FrameArena.Allocate<TriangleSetup>(nrTriangles) };
+
+	m_pJobSystem->ParallelFor(nrTriangles, m_TriangleChunkSize, [this, pChunkTriangles](size_t begin, size_t end, int workerIdx)
+		{
+			TRACE_ZONE("SetupTriangles chunk");
+			WorkerContext& worker{ m_pWorkers[workerIdx] };
+			TriangleChunk& chunk{ m_pChunks[begin / m_TriangleChunkSize] };
+			chunk.pTriangles = pChunkTriangles + begin;
+			chunk.nrTriangles = 0;
+
+			//First cluster with triangles in the chunk
+			const ClusterDraw* pClustersEnd{ m_pClusterDraws + m_NrClusterDraws };
+			const ClusterDraw* pCluster{ std::upper_bound(static_cast<const ClusterDraw*>(m_pClusterDraws), pClustersEnd, static_cast<uint32_t>(begin),
+				[](uint32_t triangleNr, const ClusterDraw& cluster) { return triangleNr < cluster.firstSubmitted; }) - 1 };
+
+			for (size_t triangleNr{ begin }; triangleNr < end; ++triangleNr)
+			{
+				while (triangleNr >= pCluster->firstSubmitted + pCluster->nrTriangles)
+				{
+					++pCluster;
+				}
+
+				const uint32_t meshTriangleNr{ pCluster->firstTriangle + static_cast<uint32_t>(triangleNr - pCluster->firstSubmitted) };
+				SetupTriangle(pCluster->drawIndex, meshTriangleNr, chunk, worker.stats);
+			}
+
+			//Attribute planes only for the triangles that cover a sample
+			TestSmallTriangles(chunk, worker.stats);
+			for (uint32_t localIdx{}; localIdx < chunk.nrTriangles; ++localIdx)
+			{
+				TriangleSetup& triangle{ chunk.pTriangles[localIdx] };
+				SetupAttributePlanes(triangle);
+				worker.stats.trianglesSpan += triangle.rasterPath == RasterPath::Span;
+				if (m_MaxShadingRate > 1 && m_RenderMode == RenderMode::Normal)
+				{
+					triangle.shadingRate = SelectShadingRate(triangle);
+					worker.stats.trianglesCoarseShaded += triangle.shadingRate > 1;
+				}
+			}
+			worker.stats.trianglesRasterized += chunk.nrTriangles;
+		});
+
+	//Gather the chunks in submission order, then bin every chunk to the tiles it touches
+	uint32_t nrSetupTriangles{};
+	for (size_t chunkIdx{}; chunkIdx < nrChunks; ++chunkIdx)
+	{
+		m_pChunks[chunkIdx].firstTriangle = nrSetupTriangles;
+		nrSetupTriangles += m_pChunks[chunkIdx].nrTriangles;
+	}
+	m_pTriangles = m_FrameArena.Allocate<TriangleSetup>(nrSetupTriangles);
+
+	m_pJobSystem->ParallelFor(nrChunks, 1, [this](size_t begin, size_t end, int workerIdx)
+		{
+			TRACE_ZONE("BinTriangles");
+			for (size_t chunkIdx{ begin }; chunkIdx < end; ++chunkIdx)
+			{
+				BinTriangles(m_pChunks[chunkIdx], m_pWorkers[workerIdx].arena);
+			}
+		});
+}
+
+void dae::Renderer::SetupTriangle(uint32_t drawIdx, uint32_t meshTriangleNr, TriangleChunk& chunk, PipelineStats& stats) const
+{
+	++stats.trianglesSubmitted;
+
+	//Mesh indices are local to the instance, its vertices start at firstVertex in the vertex stage output
+	const InstanceDraw& draw{ m_pDraws[drawIdx] };
+	uint32_t meshTriangle[3]{};
+	draw.pMesh->GetTriangle(meshTriangleNr, meshTriangle);
+	TriangleSetup triangle{};
+	triangle.drawIndex = drawIdx;
+	triangle.vertIndex0 = draw.firstVertex + meshTriangle[0];
+	triangle.vertIndex1 = draw.firstVertex + meshTriangle[1];
+	triangle.vertIndex2 = draw.firstVertex + meshTriangle[2];
+
+	if (IsVertexSame(triangle.vertIndex0, triangle.vertIndex1, triangle.vertIndex2))
+	{
+		++stats.trianglesCulledDegenerate;
+		return;
+	}
+	if (IsOutsideFrustum(triangle.vertIndex0, triangle.vertIndex1, triangle.vertIndex2))
+	{
+		++stats.trianglesCulledFrustum;
+		return;
+	}
+
+	triangle.v0 = GetRasterPosition(triangle.vertIndex0);
+	triangle.v1 = GetRasterPosition(triangle.vertIndex1);
+	triangle.v2 = GetRasterPosition(triangle.vertIndex2);
+
+	//Area
+	triangle.triangleArea = Vector2::Cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v1);
+	if (triangle.triangleArea < FLT_EPSILON)
+	{
+		++stats.trianglesCulledArea;
+		return;
+	}
+
+	//BoundingBox
+	CalculateBoundingBox(triangle.v0, triangle.v1, triangle.v2, triangle.startingX, triangle.startingY, triangle.endingX, triangle.endingY);
+	ClassifyTriangle(triangle);
+
+	chunk.pTriangles[chunk.nrTriangles++] = triangle;
+}
+
+void dae::Renderer::ClassifyTriangle(TriangleSetup& triangle) const
+{
+	//The bounding box view draws the boxes themselves
+	if (m_RenderMode == RenderMode::BoundingBox)
+		return;
+	//The small and span paths only test the pixel centers
+	if (IsMultisamplingActive())
+		return;
+
+	//Samples a pixel loop over the bounding box would test and that can be covered: one before the box is never inside,
+	//one right at its start can be, through rounding. The bounding box loop already stops at the floor of the end
+	const int firstX{ std::max(static_cast<int>(std::floor(std::min(triangle.v0.x, std::min(triangle.v1.x, triangle.v2.x)))), triangle.startingX) };
+	const int firstY{ std::max(static_cast<int>(std::floor(std::min(triangle.v0.y, std::min(triangle.v1.y, triangle.v2.y)))), triangle.startingY) };
+	const int nrSamplesX{ triangle.endingX - firstX };
+	const int nrSamplesY{ triangle.endingY - firstY };
+	if (nrSamplesX > m_SmallTriangleSamples || nrSamplesY > m_SmallTriangleSamples)
+	{
+		//At least half of a box is outside the triangle, on large ones that is worth a few edge evaluations per scanline
+		if (static_cast<int64_t>(triangle.endingX - triangle.startingX) * (triangle.endingY - triangle.startingY) >= m_SpanTrianglePixels)
+			triangle.rasterPath = RasterPath::Span;
+		return;
+	}
+
+	triangle.rasterPath = RasterPath::Small;
+	triangle.startingX = firstX;
+	triangle.startingY = firstY;
+	triangle.sampleMask = 0;
+	for (int y{}; y < nrSamplesY; ++y)
+	{
+		for (int x{}; x < nrSamplesX; ++x)
+		{
+			triangle.sampleMask |= static_cast<uint16_t>(1u << (x + m_SmallTriangleSamples * y));
+		}
+	}
+}
+
+void dae::Renderer::TestSmallTriangles(TriangleChunk& chunk, PipelineStats& stats) const
+{
+	using Simd::Float8;
+	constexpr int laneCount{ Float8::laneCount };
+
+	//Eight small triangles at a time, one per lane, through their candidate samples. Same edge functions as the
+	//bounding box loop, so exactly the samples it would cover stay in the mask
+	uint32_t batch[laneCount]{};
+	int batchSize{};
+	const auto testBatch = [&]()
+	{
+		float lanes[12][laneCount]{};
+		for (int lane{}; lane < laneCount; ++lane)
+		{
+			//Idle lanes repeat the first triangle, their results are ignored
+			const TriangleSetup& triangle{ chunk.pTriangles[batch[lane < batchSize ? lane : 0]] };
+			const Vector2 edges[3]{ triangle.v1 - triangle.v0, triangle.v2 - triangle.v1, triangle.v0 - triangle.v2 };
+			const Vector2 origins[3]{ triangle.v0, triangle.v1, triangle.v2 };
+			for (int edgeIdx{}; edgeIdx < 3; ++edgeIdx)
+			{
+				lanes[edgeIdx * 4][lane] = edges[edgeIdx].x;
+				lanes[edgeIdx * 4 + 1][lane] = edges[edgeIdx].y;
+				lanes[edgeIdx * 4 + 2][lane] = origins[edgeIdx].x;
+				lanes[edgeIdx * 4 + 3][lane] = origins[edgeIdx].y;
+			}
+		}
+		float startX[laneCount]{};
+		float startY[laneCount]{};
+		uint16_t candidates[laneCount]{};
+		uint16_t covered[laneCount]{};
+		uint16_t anyCandidates{};
+		for (int lane{}; lane < batchSize; ++lane)
+		{
+			const TriangleSetup& triangle{ chunk.pTriangles[batch[lane]] };
+			startX[lane] = static_cast<float>(triangle.startingX);
+			startY[lane] = static_cast<float>(triangle.startingY);
+			candidates[lane] = triangle.sampleMask;
+			anyCandidates |= triangle.sampleMask;
+		}
+
+		for (int sample{}; sample < m_SmallTriangleSamples * m_SmallTriangleSamples; ++sample)
+		{
+			if (!(anyCandidates & (1u << sample)))
+				continue;
+
+			const Float8 x{ Float8::Load(startX) + Float8::Set(static_cast<float>(sample % m_SmallTriangleSamples)) };
+			const Float8 y{ Float8::Load(startY) + Float8::Set(static_cast<float>(sample / m_SmallTriangleSamples)) };
+			int insideMask{ (1 << laneCount) - 1 };
+			for (int edgeIdx{}; edgeIdx < 3; ++edgeIdx)
+			{
+				const Float8 edgePoint{ Float8::Load(lanes[edgeIdx * 4]) * (y - Float8::Load(lanes[edgeIdx * 4 + 3]))
+					- Float8::Load(lanes[edgeIdx * 4 + 1]) * (x - Float8::Load(lanes[edgeIdx * 4 + 2])) };
+				insideMask &= Float8::NotNegativeMask(edgePoint);
+			}
+			for (int lane{}; lane < batchSize; ++lane)
+			{
+				if (insideMask & (1 << lane))
+					covered[lane] |= static_cast<uint16_t>(1u << sample);
+			}
+		}
+
+		for (int lane{}; lane < batchSize; ++lane)
+		{
+			chunk.pTriangles[batch[lane]].sampleMask = covered[lane] & candidates[lane];
+		}
+		batchSize = 0;
+	};
+
+	for (uint32_t localIdx{}; localIdx < chunk.nrTriangles; ++localIdx)
+	{
+		if (chunk.pTriangles[localIdx].rasterPath != RasterPath::Small)
+			continue;
+		batch[batchSize++] = localIdx;
+		if (batchSize == laneCount)
+			testBatch();
+	}
+	if (batchSize > 0)
+		testBatch();
+
+	//Drop the small triangles without samples, keeping the submission order
+	uint32_t nrKept{};
+	for (uint32_t localIdx{}; localIdx < chunk.nrTriangles; ++localIdx)
+	{
+		const TriangleSetup& triangle{ chunk.pTriangles[localIdx] };
+		if (triangle.rasterPath == RasterPath::Small)
+		{
+			if (!triangle.sampleMask)
+			{
+				++stats.trianglesCulledNoSample;
+				continue;
+			}
+			++stats.trianglesSmall;
+		}
+		if (nrKept != localIdx)
+			chunk.pTriangles[nrKept] = triangle;
+		++nrKept;
+	}
+	chunk.nrTriangles = nrKept;
+}
+
+void dae::Renderer::SetupAttributePlanes(TriangleSetup& triangle) const
+{
+	const Vector2 v0{ triangle.v0 };
+	const Vector2 v1{ triangle.v1 };
+	const Vector2 v2{ triangle.v2 };
+	const Vector2 edge01{ v1 - v0 };
+	const Vector2 edge12{ v2 - v1 };
+	const Vector2 edge20{ v0 - v2 };
+
+	//The barycentric weight of a vertex is the edge function of the opposite edge over the area,
+	//so its screen space gradient is that edge rotated by 90 degrees over the area
+	const float invArea{ 1.f / triangle.triangleArea };
+	const Vector2 weight0Gradient{ -edge12.y * invArea, edge12.x * invArea };
+	const Vector2 weight1Gradient{ -edge20.y * invArea, edge20.x * invArea };
+	const Vector2 weight2Gradient{ -edge01.y * invArea, edge01.x * invArea };
+
+	const auto createPlane = [&](float value0, float value1, float value2)
+	{
+		AttributePlane plane{};
+		plane.dx = weight0Gradient.x * value0 + weight1Gradient.x * value1 + weight2Gradient.x * value2;
+		plane.dy = weight0Gradient.y * value0 + weight1Gradient.y * value1 + weight2Gradient.y * value2;
+		plane.valueAtOrigin = value0 - plane.dx * v0.x - plane.dy * v0.y;
+		return plane;
+	};
+
+	//Gather the post-transform attributes of the corners, the compact format decodes them here.
+	//The uvs are not transformed and come straight from the shared mesh
+	const InstanceDraw& draw{ m_pDraws[triangle.drawIndex] };
+	const Mesh& mesh{ *draw.pMesh };
+	const uint32_t vertIndices[3]{ triangle.vertIndex0, triangle.vertIndex1, triangle.vertIndex2 };
+	float depth[3]{};
+	float invW[3]{};
+	Vector2 uv[3]{};
+	Vector3 normal[3]{};
+	Vector3 tangent[3]{};
+	Vector3 viewDirection[3]{};
+	for (int corner{}; corner < 3; ++corner)
+	{
+		const uint32_t vertIndex{ vertIndices[corner] };
+		const uint32_t meshVertIndex{ vertIndex - draw.firstVertex };
+		if (mesh.vertexFormat == VertexFormat::Compact)
+		{
+			const CompactVertexStreams& vertices{ m_CompactVerticesOut };
+			depth[corner] = vertices.positionZ[vertIndex];
+			invW[corner] = 1.f / vertices.positionW[vertIndex];
+			uv[corner] = mesh.compactStreams.GetUV(meshVertIndex);
+			normal[corner] = vertices.GetNormal(vertIndex);
+			tangent[corner] = vertices.GetTangent(vertIndex);
+			viewDirection[corner] = vertices.GetViewDirection(vertIndex);
+		}
+		else
+		{
+			const VertexStreams& vertices{ m_VerticesOut };
+			depth[corner] = vertices.positionZ[vertIndex];
+			invW[corner] = 1.f / vertices.positionW[vertIndex];
+			uv[corner] = mesh.vertices[meshVertIndex].uv;
+			normal[corner] = vertices.GetNormal(vertIndex);
+			tangent[corner] = vertices.GetTangent(vertIndex);
+			viewDirection[corner] = vertices.GetViewDirection(vertIndex);
+		}
+	}
+
+	triangle.invW = createPlane(invW[0], invW[1], invW[2]);
+	triangle.z = createPlane(depth[0], depth[1], depth[2]);
+
+	for (int corner{}; corner < 3; ++corner)
+	{
+		uv[corner] *= invW[corner];
+		normal[corner] *= invW[corner];
+		tangent[corner] *= invW[corner];
+		viewDirection[corner] *= invW[corner];
+	}
+
+	for (int component{}; component < 2; ++component)
+	{
+		triangle.uvOverW[component] = createPlane(uv[0][component], uv[1][component], uv[2][component]);
+	}
+	for (int component{}; component < 3; ++component)
+	{
+		triangle.normalOverW[component] = createPlane(normal[0][component], normal[1][component], normal[2][component]);
+		triangle.tangentOverW[component] = createPlane(tangent[0][component], tangent[1][component], tangent[2][component]);
+		triangle.viewDirectionOverW[component] = createPlane(viewDirection[0][component], viewDirection[1][component], viewDirection[2][component]);
+	}
+}
+
+uint8_t dae::Renderer::SelectShadingRate(const TriangleSetup& triangle) const
+{
+	const Texture* pTexture{ m_pDraws[triangle.drawIndex].pModel->GetDiffuseTexture() };
+	const Vector2 textureSize{ static_cast<float>(pTexture->GetWidth()), static_cast<float>(pTexture->GetHeight()) };
+
+	//Screen space derivative of a perspective correct attribute: d(a/w * w) = (d(a/w) - a * d(1/w)) * w.
+	//It changes over the triangle with w, so it is taken at the corners
+	float maxTexelsPerPixel{};
+	float maxNormalChangePerPixel{};
+	for (const Vector2& corner : { triangle.v0, triangle.v1, triangle.v2 })
+	{
+		const float w{ 1.f / triangle.invW.Evaluate(corner.x, corner.y) };
+		//Squared lengths of the x and y derivatives of a vector attribute, summed over its components
+		float sqrDx{};
+		float sqrDy{};
+		const auto addDerivatives = [&](const AttributePlane& planeOverW, float scale)
+		{
+			const float value{ planeOverW.Evaluate(corner.x, corner.y) * w };
+			const float dx{ (planeOverW.dx - value * triangle.invW.dx) * w * scale };
+			const float dy{ (planeOverW.dy - value * triangle.invW.dy) * w * scale };
+			sqrDx += dx * dx;
+			sqrDy += dy * dy;
+			return value;
+		};
+
+		for (int component{}; component < 2; ++component)
+		{
+			addDerivatives(triangle.uvOverW[component], textureSize[component]);
+		}
+		maxTexelsPerPixel = std::max(maxTexelsPerPixel, std::sqrt(std::max(sqrDx, sqrDy)));
+
+		//The change of the interpolated normal over its length is about the change of the unit normal
+		sqrDx = 0.f;
+		sqrDy = 0.f;
+		float normalSqrLength{};
+		for (int component{}; component < 3; ++component)
+		{
+			const float value{ addDerivatives(triangle.normalOverW[component], 1.f) };
+			normalSqrLength += value * value;
+		}
+		maxNormalChangePerPixel = std::max(maxNormalChangePerPixel, std::sqrt(std::max(sqrDx, sqrDy) / normalSqrLength));
+	}
+
+	int rate{ 1 };
+	while (rate < m_MaxShadingRate
+		&& maxTexelsPerPixel * (rate * 2) <= m_CoarseTexelsPerBlock
+		&& maxNormalChangePerPixel * (rate * 2) <= m_CoarseNormalChangePerBlock)
+	{
+		rate *= 2;
+	}
+	return static_cast<uint8_t>(rate);
+}
+
+void dae::Renderer::BinTriangles(TriangleChunk& chunk, FrameArena& arena) const
+{
+	std::copy_n(chunk.pTriangles, chunk.nrTriangles, m_pTriangles + chunk.firstTriangle);
+
+	const auto forEachTile = [this](const TriangleSetup& triangle, const auto& function)
+	{
+		if (triangle.endingX <= triangle.startingX || triangle.endingY <= triangle.startingY) return;
+
+		const int firstTileX{ triangle.startingX / m_TileSize };
+		const int firstTileY{ triangle.startingY / m_TileSize };
+		const int lastTileX{ (triangle.endingX - 1) / m_TileSize };
+		const int lastTileY{ (triangle.endingY - 1) / m_TileSize };
+		for (int tileY{ firstTileY }; tileY <= lastTileY; ++tileY)
+		{
+			for (int tileX{ firstTileX }; tileX <= lastTileX; ++tileX)
+			{
+				function(tileX + tileY * m_NrTilesX);
+			}
+		}
+	};
+
+	//Counting sort by tile: count, prefix sum, then scatter into exactly sized arena storage
+	const int nrTiles{ m_NrTilesX * m_NrTilesY };
+	uint32_t* pOffsets{ arena.Allocate<uint32_t>(nrTiles + 1) };
+	std::fill_n(pOffsets, nrTiles + 1, 0u);
+	for (uint32_t localIdx{}; localIdx < chunk.nrTriangles; ++localIdx)
+	{
+		forEachTile(chunk.pTriangles[localIdx], [pOffsets](int tileIdx) { ++pOffsets[tileIdx + 1]; });
+	}
+	for (int tileIdx{}; tileIdx < nrTiles; ++tileIdx)
+	{
+		pOffsets[tileIdx + 1] += pOffsets[tileIdx];
+	}
+
+	uint32_t* pBinTriangles{ arena.Allocate<uint32_t>(pOffsets[nrTiles]) };
+	uint32_t* pCursors{ arena.Allocate<uint32_t>(nrTiles) };
+	std::copy_n(pOffsets, nrTiles, pCursors);
+	for (uint32_t localIdx{}; localIdx < chunk.nrTriangles; ++localIdx)
+	{
+		const uint32_t triangleIdx{ chunk.firstTriangle + localIdx };
+		forEachTile(chunk.pTriangles[localIdx], [pBinTriangles, pCursors, triangleIdx](int tileIdx) { pBinTriangles[pCursors[tileIdx]++] = triangleIdx; });
+	}
+
+	chunk.pBinOffsets = pOffsets;
+	chunk.pBinTriangles = pBinTriangles;
+}
+
+float dae::Renderer::RasterizeTriangles()
+{
+	const int nrTiles{ m_NrTilesX * m_NrTilesY };
+	m_pJobSystem->ParallelFor(nrTiles, 1, [this](size_t begin, size_t end, int workerIdx)
+		{
+			for (size_t tileIdx{ begin }; tileIdx < end; ++tileIdx)
+			{
+				RasterizeTile(static_cast<int>(tileIdx), m_pWorkers[workerIdx]);
+			}
+		});
+
+	float busyMs{};
+	float shadeMs{};
+	for (int workerIdx{}; workerIdx < GetNrWorkers(); ++workerIdx)
+	{
+		WorkerContext& worker{ m_pWorkers[workerIdx] };
+		busyMs += worker.busyMs;
+		shadeMs += worker.shadeMs;
+		worker.busyMs = 0.f;
+		worker.shadeMs = 0.f;
+	}
+	return busyMs > 0.f ? shadeMs / busyMs : 0.f;
+}
+
+void dae::Renderer::RasterizeTile(int tileIdx, WorkerContext& worker)
+{
+	TRACE_ZONE("RasterizeTile");
+	uint64_t lapCounter{ SDL_GetPerformanceCounter() };
+	//Sample depths are only cleared where a triangle can reach them
+	if (IsMultisamplingActive())
+	{
+		const bool isTileEmpty{ std::all_of(m_pChunks, m_pChunks + m_NrChunks,
+			[tileIdx](const TriangleChunk& chunk) { return chunk.pBinOffsets[tileIdx] == chunk.pBinOffsets[tileIdx + 1]; }) };
+		if (!isTileEmpty)
+			ClearSampleDepths(tileIdx);
+	}
+
+	//Chunks in order, so every pixel sees its triangles in submission order
+	for (size_t chunkIdx{}; chunkIdx < m_NrChunks; ++chunkIdx)
+	{
+		const TriangleChunk& chunk{ m_pChunks[chunkIdx] };
+		for (uint32_t binIdx{ chunk.pBinOffsets[tileIdx] }; binIdx < chunk.pBinOffsets[tileIdx + 1]; ++binIdx)
+		{
+			RenderTriangle(chunk.pBinTriangles[binIdx], tileIdx, worker);
+		}
+	}
+	ShadeFragments(worker);
+
+	worker.busyMs += Lap(lapCounter);
+}
+
+void dae::Renderer::RenderTriangle(uint32_t triangleIdx, int tileIdx, WorkerContext& worker)
+{
+	if (IsMultisamplingActive())
+	{
+		RenderMultisampledTriangle(triangleIdx, tileIdx, worker);
+		return;
+	}
+
+	const TriangleSetup& triangle{ m_pTriangles[triangleIdx] };
+	if (triangle.rasterPath == RasterPath::Small)
+	{
+		RenderSmallTriangle(triangleIdx, tileIdx, worker);
+		return;
+	}
+	if (triangle.rasterPath == RasterPath::Span)
+	{
+		RenderSpanTriangle(triangleIdx, tileIdx, worker);
+		return;
+	}
+
+	//Only the part of the bounding box inside this tile
+	const int tileX{ tileIdx % m_NrTilesX * m_TileSize };
+	const int tileY{ tileIdx / m_NrTilesX * m_TileSize };
+	const int startingX{ std::max(triangle.startingX, tileX) };
+	const int startingY{ std::max(triangle.startingY, tileY) };
+	const int endingX{ std::min(triangle.endingX, tileX + m_TileSize) };
+	const int endingY{ std::min(triangle.endingY, tileY + m_TileSize) };
+
+	const Vector2 v0{ triangle.v0 };
+	const Vector2 v1{ triangle.v1 };
+	const Vector2 v2{ triangle.v2 };
+	const Vector2 edge01{ v1 - v0 };
+	const Vector2 edge12{ v2 - v1 };
+	const Vector2 edge20{ v0 - v2 };
+
+	//Counted locally, written back to the worker stats once per triangle
+	uint64_t nrPixelsCovered{};
+	uint64_t nrPixelsDepthRejected{};
+
+	for (int py{ startingY }; py < endingY; ++py)
+	{
+		for (int px{ startingX }; px < endingX; ++px)
+		{
+			// Calculate the pixel index and create a Vector2 of the current pixel
+			const int pixelIdx{ px + py * m_Width };
+			const Vector2 curPixel{ static_cast<float>(px), static_cast<float>(py) };
+
+			if (m_RenderMode == RenderMode::BoundingBox)
+			{
+				RenderBoundingBox(pixelIdx);
+				continue;
+			}
+
+			//VertexToPoint
+			const Vector2 v0ToPoint{ curPixel - v0 };
+			const Vector2 v1ToPoint{ curPixel - v1 };
+			const Vector2 v2ToPoint{ curPixel - v2 };
+			const float edge01Point{ Vector2::Cross(edge01, v0ToPoint) };
+			const float edge12Point{ Vector2::Cross(edge12, v1ToPoint) };
+			const float edge20Point{ Vector2::Cross(edge20, v2ToPoint) };
+			if (!IsInsideTriangle(edge01Point, edge12Point, edge20Point)) continue;
+			++nrPixelsCovered;
+
+			// Calculate the Z depth at this pixel
+			const float interpolatedZDepth{ triangle.z.Evaluate(curPixel.x, curPixel.y) };
+			if (IsCurrentDepthBufferLessThenDepth(pixelIdx, interpolatedZDepth))
+			{
+				++nrPixelsDepthRejected;
+				continue;
+			}
+			m_pDepthBufferPixels[pixelIdx] = interpolatedZDepth;
+
+			//Fragments are shaded in submission order, so a later (closer) fragment still ends up on top
+			worker.pFragments[worker.nrFragments++] = Fragment{ pixelIdx, triangleIdx, interpolatedZDepth };
+			if (worker.nrFragments == m_FragmentBatchSize)
+			{
+				ShadeFragments(worker);
+			}
+		}
+	}
+
+	PipelineStats& stats{ worker.stats };
+	stats.pixelsTested += static_cast<uint64_t>(endingX - startingX) * (endingY - startingY);
+	stats.pixelsCovered += nrPixelsCovered;
+	stats.pixelsDepthRejected += nrPixelsDepthRejected;
+}
+
+void dae::Renderer::RenderSmallTriangle(uint32_t triangleIdx, int tileIdx, WorkerContext& worker)
+{
+	const TriangleSetup& triangle{ m_pTriangles[triangleIdx] };
+	const int tileX{ tileIdx % m_NrTilesX * m_TileSize };
+	const int tileY{ tileIdx / m_NrTilesX * m_TileSize };
+
+	//Coverage is known, only the depth test is left for the covered samples in this tile
+	uint64_t nrPixelsCovered{};
+	uint64_t nrPixelsDepthRejected{};
+	for (int sample{}; sample < m_SmallTriangleSamples * m_SmallTriangleSamples; ++sample)
+	{
+		if (!(triangle.sampleMask & (1u << sample)))
+			continue;
+
+		const int px{ triangle.startingX + sample % m_SmallTriangleSamples };
+		const int py{ triangle.startingY + sample / m_SmallTriangleSamples };
+		if (px < tileX || px >= tileX + m_TileSize || py < tileY || py >= tileY + m_TileSize)
+			continue;
+		++nrPixelsCovered;
+
+		const int pixelIdx{ px + py * m_Width };
+		const float interpolatedZDepth{ triangle.z.Evaluate(static_cast<float>(px), static_cast<float>(py)) };
+		if (IsCurrentDepthBufferLessThenDepth(pixelIdx, interpolatedZDepth))
+		{
+			++nrPixelsDepthRejected;
+			continue;
+		}
+		m_pDepthBufferPixels[pixelIdx] = interpolatedZDepth;
+
+		worker.pFragments[worker.nrFragments++] = Fragment{ pixelIdx, triangleIdx, interpolatedZDepth };
+		if (worker.nrFragments == m_FragmentBatchSize)
+		{
+			ShadeFragments(worker);
+		}
+	}
+
+	//The coverage tests ran in setup, only the covered samples reach this point
+	PipelineStats& stats{ worker.stats };
+	stats.pixelsTested += nrPixelsCovered;
+	stats.pixelsCovered += nrPixelsCovered;
+	stats.pixelsDepthRejected += nrPixelsDepthRejected;
+}
+
+void dae::Renderer::RenderSpanTriangle(uint32_t triangleIdx, int tileIdx, WorkerContext& worker)
+{
+	const TriangleSetup& triangle{ m_pTriangles[triangleIdx] };
+	const int tileX{ tileIdx % m_NrTilesX * m_TileSize };
+	const int tileY{ tileIdx / m_NrTilesX * m_TileSize };
+	const int startingX{ std::max(triangle.startingX, tileX) };
+	const int startingY{ std::max(triangle.startingY, tileY) };
+	const int endingX{ std::min(triangle.endingX, tileX + m_TileSize) };
+	const int endingY{ std::min(triangle.endingY, tileY + m_TileSize) };
+
+	struct Edge
+	{
+		Vector2 from;
+		Vector2 direction;
+	};
+	const Edge edges[3]{ { triangle.v0, triangle.v1 - triangle.v0 }, { triangle.v1, triangle.v2 - triangle.v1 }, { triangle.v2, triangle.v0 - triangle.v2 } };
+	const float depthStepX{ triangle.z.dx };
+
+	uint64_t nrPixelsCovered{};
+	uint64_t nrPixelsDepthRejected{};
+
+	for (int py{ startingY }; py < endingY; ++py)
+	{
+		const float pixelY{ static_cast<float>(py) };
+
+		//Along a scanline every edge value is monotonic in x, also after rounding, so each edge keeps one side of a
+		//boundary. The boundary is estimated, then moved until the edge test the bounding box path does agrees
+		int left{ startingX };
+		int right{ endingX - 1 };
+		for (const Edge& edge : edges)
+		{
+			const auto isInside = [&edge, pixelY](int px)
+			{
+				return Vector2::Cross(edge.direction, Vector2{ static_cast<float>(px), pixelY } - edge.from) >= 0.f;
+			};
+
+			if (edge.direction.y == 0.f)
+			{
+				if (!isInside(left))
+					right = left - 1;
+				continue;
+			}
+
+			const float boundary{ std::clamp(edge.from.x + edge.direction.x * (pixelY - edge.from.y) / edge.direction.y,
+				static_cast<float>(left - 1), static_cast<float>(right + 1)) };
+			if (edge.direction.y > 0.f)
+			{
+				//Inside up to the boundary
+				int last{ static_cast<int>(std::floor(boundary)) };
+				while (last < right && isInside(last + 1))
+					++last;
+				while (last >= left && !isInside(last))
+					--last;
+				right = std::min(right, last);
+			}
+			else
+			{
+				//Inside from the boundary on
+				int first{ static_cast<int>(std::ceil(boundary)) };
+				while (first > left && isInside(first - 1))
+					--first;
+				while (first <= right && !isInside(first))
+					++first;
+				left = std::max(left, first);
+			}
+			if (left > right)
+				break;
+		}
+		if (left > right)
+			continue;
+
+		//Every pixel of the span is covered, depth is stepped along it
+		nrPixelsCovered += right - left + 1;
+		const int rowIdx{ py * m_Width };
+		float interpolatedZDepth{ triangle.z.Evaluate(static_cast<float>(left), pixelY) };
+		for (int px{ left }; px <= right; ++px, interpolatedZDepth += depthStepX)
+		{
+			const int pixelIdx{ rowIdx + px };
+			if (IsCurrentDepthBufferLessThenDepth(pixelIdx, interpolatedZDepth))
+			{
+				++nrPixelsDepthRejected;
+				continue;
+			}
+			m_pDepthBufferPixels[pixelIdx] = interpolatedZDepth;
+
+			worker.pFragments[worker.nrFragments++] = Fragment{ pixelIdx, triangleIdx, interpolatedZDepth };
+			if (worker.nrFragments == m_FragmentBatchSize)
+			{
+				ShadeFragments(worker);
+			}
+		}
+	}
+
+	//Only the pixels inside the spans are visited
+	PipelineStats& stats{ worker.stats };
+	stats.pixelsTested += nrPixelsCovered;
+	stats.pixelsCovered += nrPixelsCovered;
+	stats.pixelsDepthRejected += nrPixelsDepthRejected;
+}
+
+void dae::Renderer::RenderMultisampledTriangle(uint32_t triangleIdx, int tileIdx, WorkerContext& worker)
+{
+	const TriangleSetup& triangle{ m_pTriangles[triangleIdx] };
+	const int tileX{ tileIdx % m_NrTilesX * m_TileSize };
+	const int tileY{ tileIdx / m_NrTilesX * m_TileSize };
+	const int startingX{ std::max(triangle.startingX, tileX) };
+	const int startingY{ std::max(triangle.startingY, tileY) };
+	const int endingX{ std::min(triangle.endingX, tileX + m_TileSize) };
+	const int endingY{ std::min(triangle.endingY, tileY + m_TileSize) };
+
+	//The edge values and depth at a sample are those at the pixel center plus a constant step per sample
+	struct Edge
+	{
+		Vector2 from;
+		Vector2 direction;
+		float sampleSteps[m_NrSamples]{};
+		float minStep{ FLT_MAX };
+		float maxStep{ -FLT_MAX };
+	};
+	Edge edges[3]{ { triangle.v0, triangle.v1 - triangle.v0 }, { triangle.v1, triangle.v2 - triangle.v1 }, { triangle.v2, triangle.v0 - triangle.v2 } };
+	float depthSteps[m_NrSamples]{};
+	for (int sample{}; sample < m_NrSamples; ++sample)
+	{
+		const Vector2 offset{ m_SampleOffsetsX[sample], m_SampleOffsetsY[sample] };
+		for (Edge& edge : edges)
+		{
+			edge.sampleSteps[sample] = Vector2::Cross(edge.direction, offset);
+			edge.minStep = std::min(edge.minStep, edge.sampleSteps[sample]);
+			edge.maxStep = std::max(edge.maxStep, edge.sampleSteps[sample]);
+		}
+		depthSteps[sample] = triangle.z.dx * offset.x + triangle.z.dy * offset.y;
+	}
+
+	uint64_t nrPixelsTested{};
+	uint64_t nrPixelsCovered{};
+	uint64_t nrPixelsDepthRejected{};
+
+	for (int py{ startingY }; py < endingY; ++py)
+	{
+		const float pixelY{ static_cast<float>(py) };
+
+		//Pixels that can have a sample inside: every edge bounds the scanline by the farthest its boundary gets over
+		//the rows of the samples, widened by the sample offsets and a pixel for rounding. The samples decide the rest
+		int left{ startingX };
+		int right{ endingX - 1 };
+		for (const Edge& edge : edges)
+		{
+			if (edge.direction.y == 0.f)
+			{
+				if (edge.direction.x * (pixelY - edge.from.y) + std::abs(edge.direction.x) * m_MaxSampleOffset < 0.f)
+					right = left - 1;
+				continue;
+			}
+
+			const float inverseSlope{ edge.direction.x / edge.direction.y };
+			const float boundaryTop{ edge.from.x + inverseSlope * (pixelY - m_MaxSampleOffset - edge.from.y) };
+			const float boundaryBottom{ edge.from.x + inverseSlope * (pixelY + m_MaxSampleOffset - edge.from.y) };
+			const float minX{ static_cast<float>(left - 1) };
+			const float maxX{ static_cast<float>(right + 1) };
+			if (edge.direction.y > 0.f)
+			{
+				//Inside up to the boundary
+				const float last{ std::clamp(std::max(boundaryTop, boundaryBottom) + m_MaxSampleOffset, minX, maxX) };
+				right = std::min(right, static_cast<int>(std::floor(last)) + 1);
+			}
+			else
+			{
+				//Inside from the boundary on
+				const float first{ std::clamp(std::min(boundaryTop, boundaryBottom) - m_MaxSampleOffset, minX, maxX) };
+				left = std::max(left, static_cast<int>(std::ceil(first)) - 1);
+			}
+			if (left > right)
+				break;
+		}
+		if (left > right)
+			continue;
+
+		nrPixelsTested += right - left + 1;
+		const int rowIdx{ py * m_Width };
+		for (int px{ left }; px <= right; ++px)
+		{
+			const Vector2 curPixel{ static_cast<float>(px), pixelY };
+			const float edge01Point{ Vector2::Cross(edges[0].direction, curPixel - edges[0].from) };
+			const float edge12Point{ Vector2::Cross(edges[1].direction, curPixel - edges[1].from) };
+			const float edge20Point{ Vector2::Cross(edges[2].direction, curPixel - edges[2].from) };
+			//Rounding keeps the order of the sums, so the pixels inside or outside at the extreme steps give the same
+			//mask as testing every sample
+			if (!IsInsideTriangle(edge01Point + edges[0].maxStep, edge12Point + edges[1].maxStep, edge20Point + edges[2].maxStep))
+				continue;
+			uint8_t coverageMask{ m_FullCoverage };
+			if (!IsInsideTriangle(edge01Point + edges[0].minStep, edge12Point + edges[1].minStep, edge20Point + edges[2].minStep))
+			{
+				coverageMask = 0;
+				for (int sample{}; sample < m_NrSamples; ++sample)
+				{
+					if (IsInsideTriangle(edge01Point + edges[0].sampleSteps[sample], edge12Point + edges[1].sampleSteps[sample], edge20Point + edges[2].sampleSteps[sample]))
+						coverageMask |= static_cast<uint8_t>(1u << sample);
+				}
+				if (!coverageMask) continue;
+			}
+			++nrPixelsCovered;
+
+			//Depth per covered sample, the fragment keeps the samples it is in front at
+			const int pixelIdx{ rowIdx + px };
+			float* pSampleDepths{ m_pSampleDepths + static_cast<size_t>(pixelIdx) * m_NrSamples };
+			const float interpolatedZDepth{ triangle.z.Evaluate(curPixel.x, curPixel.y) };
+			uint8_t visibleMask{};
+			for (int sample{}; sample < m_NrSamples; ++sample)
+			{
+				const float sampleDepth{ interpolatedZDepth + depthSteps[sample] };
+				if (!(coverageMask & (1u << sample)) || pSampleDepths[sample] < sampleDepth)
+					continue;
+				pSampleDepths[sample] = sampleDepth;
+				visibleMask |= static_cast<uint8_t>(1u << sample);
+			}
+			if (!visibleMask)
+			{
+				++nrPixelsDepthRejected;
+				continue;
+			}
+
+			worker.pFragments[worker.nrFragments++] = Fragment{ pixelIdx, triangleIdx, interpolatedZDepth, visibleMask };
+			if (worker.nrFragments == m_FragmentBatchSize)
+			{
+				ShadeFragments(worker);
+			}
+		}
+	}
+
+	PipelineStats& stats{ worker.stats };
+	stats.pixelsTested += nrPixelsTested;
+	stats.pixelsCovered += nrPixelsCovered;
+	stats.pixelsDepthRejected += nrPixelsDepthRejected;
+}
+
+void dae::Renderer::ClearSampleDepths(int tileIdx) const
+{
+	const int tileX{ tileIdx % m_NrTilesX * m_TileSize };
+	const int tileY{ tileIdx / m_NrTilesX * m_TileSize };
+	const int endingX{ std::min(tileX + m_TileSize, m_Width) };
+	const int endingY{ std::min(tileY + m_TileSize, m_Height) };
+	for (int py{ tileY }; py < endingY; ++py)
+	{
+		std::fill_n(m_pSampleDepths + static_cast<size_t>(py * m_Width + tileX) * m_NrSamples, (endingX - tileX) * m_NrSamples, FLT_MAX);
+	}
+}
+
+void dae::Renderer::ShadeFragments(WorkerContext& worker)
+{
+	TRACE_ZONE("ShadeFragments");
+	uint64_t lapCounter{ SDL_GetPerformanceCounter() };
+	Fragment* pFragments{ worker.pFragments };
+	size_t nrFragments{ worker.nrFragments };
+	worker.nrFragments = 0;
+
+	//Every pixel notes the draw it shows, the history needs it for both colors. Pixels of the other color are
+	//reconstructed after rasterization
+	if (IsCheckerboardActive())
+	{
+		size_t nrShadedFragments{};
+		for (size_t fragmentIdx{}; fragmentIdx < nrFragments; ++fragmentIdx)
+		{
+			const Fragment& fragment{ pFragments[fragmentIdx] };
+			m_pDrawIndexPixels[fragment.pixelIndex] = m_pTriangles[fragment.triangleIndex].drawIndex;
+			if (((fragment.pixelIndex % m_Width + fragment.pixelIndex / m_Width) & 1) == m_CheckerboardParity)
+				pFragments[nrShadedFragments++] = fragment;
+		}
+		nrFragments = nrShadedFragments;
+	}
+	worker.stats.pixelsShaded += nrFragments;
+
+	if (IsTrackingOverdraw())
+	{
+		for (size_t fragmentIdx{}; fragmentIdx < nrFragments; ++fragmentIdx)
+		{
+			const Fragment& fragment{ pFragments[fragmentIdx] };
+			uint8_t& shadeCount{ m_pShadeCountPixels[fragment.pixelIndex] };
+			shadeCount += shadeCount < UINT8_MAX;
+		}
+	}
+
+	//The heat map only needs the counts
+	if (m_RenderMode == RenderMode::Overdraw)
+	{
+		worker.shadeMs += Lap(lapCounter);
+		return;
+	}
+
+	//Once per batch, before any of it is shaded
+	if (m_RenderMode == RenderMode::Normal)
+	{
+		CullTileLights(pFragments, nrFragments, worker);
+	}
+
+	for (size_t fragmentIdx{}; fragmentIdx < nrFragments; ++fragmentIdx)
+	{
+		const Fragment& fragment{ pFragments[fragmentIdx] };
+		const TriangleSetup& triangle{ m_pTriangles[fragment.triangleIndex] };
+		Vertex_Out pixelInfo{};
+
+		// Switch between all the render states
+		switch (m_RenderMode)
+		{
+		case RenderMode::Normal:
+		{
+			const int x{ fragment.pixelIndex % m_Width };
+			const int y{ fragment.pixelIndex / m_Width };
+			if (triangle.shadingRate > 1)
+			{
+				StoreColor(fragment, ShadeBlock(fragment.triangleIndex, triangle, x, y, worker));
+				continue;
+			}
+			float shadeX{};
+			float shadeY{};
+			GetShadingPosition(fragment, shadeX, shadeY);
+			if (m_pDraws[triangle.drawIndex].pMaterialAtlas)
+			{
+				StoreColor(fragment, ShadeFromMaterialAtlas(triangle, shadeX, shadeY, worker.lights));
+				++worker.stats.shadesFromMaterialAtlas;
+				continue;
+			}
+			CalculatePixelInfo(pixelInfo, triangle, shadeX, shadeY);
+			break;
+		}
+		case RenderMode::DepthBuffer:
+		{
+			float depthColor;
+			RemapZDepth(fragment.zDepth, depthColor);
+			pixelInfo.color = { depthColor, depthColor, depthColor };
+			break;
+		}
+		case RenderMode::Overdraw:
+			//Returned above, ResolveOverdraw writes the heat map from the shade counts
+			break;
+		}
+
+		StoreColor(fragment, Shade(pixelInfo, *m_pDraws[triangle.drawIndex].pModel, worker.lights));
+	}
+
+	worker.shadeMs += Lap(lapCounter);
+}
+
+uint32_t dae::Renderer::ShadeBlock(uint32_t triangleIdx, const TriangleSetup& triangle, int x, int y, WorkerContext& worker)
+{
+	const int rate{ triangle.shadingRate };
+	const int blockX{ x / rate };
+	const int blockY{ y / rate };
+	const int blockIndex{ blockX + blockY * m_Width };
+	CoarseShade& coarseShade{ worker.pCoarseShades[blockX % m_CoarseBlocksPerTile + (blockY % m_CoarseBlocksPerTile) * m_CoarseBlocksPerTile] };
+	if (coarseShade.triangleIndex == triangleIdx && coarseShade.blockIndex == blockIndex)
+	{
+		++worker.stats.pixelsShadeReused;
+		return coarseShade.color;
+	}
+
+	float centerX{};
+	float centerY{};
+	GetBlockCenter(triangle, x, y, centerX, centerY);
+	if (m_pDraws[triangle.drawIndex].pMaterialAtlas)
+	{
+		++worker.stats.shadesFromMaterialAtlas;
+		coarseShade = { triangleIdx, blockIndex, ShadeFromMaterialAtlas(triangle, centerX, centerY, worker.lights) };
+		return coarseShade.color;
+	}
+
+	Vertex_Out pixelInfo{};
+	CalculatePixelInfo(pixelInfo, triangle, centerX, centerY);
+
+	coarseShade = { triangleIdx, blockIndex, Shade(pixelInfo, *m_pDraws[triangle.drawIndex].pModel, worker.lights) };
+	return coarseShade.color;
+}
+
+void dae::Renderer::GetBlockCenter(const TriangleSetup& triangle, int x, int y, float& centerX, float& centerY) const
+{
+	//The center may lie outside the triangle, the bounding box keeps the attributes from being extrapolated far.
+	//It does not depend on which fragment of the block comes first
+	const int rate{ triangle.shadingRate };
+	const float halfBlock{ (rate - 1) * 0.5f };
+	centerX = std::clamp(x / rate * rate + halfBlock, static_cast<float>(triangle.startingX), static_cast<float>(triangle.endingX - 1));
+	centerY = std::clamp(y / rate * rate + halfBlock, static_cast<float>(triangle.startingY), static_cast<float>(triangle.endingY - 1));
+}
+
+void dae::Renderer::ResolveOverdraw(PipelineStats& stats) const
+{
+	TRACE_ZONE("ResolveOverdraw");
+	//Black (never shaded) -> blue -> cyan -> green -> yellow -> red -> white (8 or more shades)
+	constexpr int nrHeatColors{ 7 };
+	const ColorRGB heatColors[nrHeatColors]{ colors::Black, colors::Blue, colors::Cyan, colors::Green, colors::Yellow, colors::Red, colors::White };
+	constexpr float shadesPerColor{ 8.f / (nrHeatColors - 1) };
+
+	const int nrPixels{ m_Width * m_Height };
+	for (int pixelIdx{}; pixelIdx < nrPixels; ++pixelIdx)
+	{
+		const uint8_t shadeCount{ m_pShadeCountPixels[pixelIdx] };
+		stats.pixelsShadedUnique += shadeCount > 0;
+
+		if (m_RenderMode != RenderMode::Overdraw) continue;
+
+		const float heat{ std::min(static_cast<float>(shadeCount) / shadesPerColor, static_cast<float>(nrHeatColors - 1)) };
+		const int lowerColor{ std::min(static_cast<int>(heat), nrHeatColors - 2) };
+		const ColorRGB color{ ColorRGB::Lerp(heatColors[lowerColor], heatColors[lowerColor + 1], heat - static_cast<float>(lowerColor)) };
+
+		m_pRenderPixels[pixelIdx] = SDL_MapRGB(m_pBackBuffer->format,
+			static_cast<uint8_t>(color.r * 255),
+			static_cast<uint8_t>(color.g * 255),
+			static_cast<uint8_t>(color.b * 255));
+	}
+}
+
+void dae::Renderer::StoreColor(const Fragment& fragment, uint32_t color) const
+{
+	const int pixelIdx{ fragment.pixelIndex };
+	if (fragment.coverageMask == m_FullCoverage)
+	{
+		//Nothing drawn before is left in the pixel, one color holds it again
+		m_pRenderPixels[pixelIdx] = color;
+		if (m_pExpandedPixels)
+			m_pExpandedPixels[pixelIdx] = 0;
+		return;
+	}
+
+	//The samples the fragment did not win keep what the pixel showed so far. Only the worker of the tile touches it
+	uint32_t* pSampleColors{ m_pSampleColors + static_cast<size_t>(pixelIdx) * m_NrSamples };
+	if (!m_pExpandedPixels[pixelIdx])
+	{
+		std::fill_n(pSampleColors, m_NrSamples, m_pRenderPixels[pixelIdx]);
+		m_pExpandedPixels[pixelIdx] = 1;
+		m_pExpandedTiles[pixelIdx % m_Width / m_TileSize + pixelIdx / m_Width / m_TileSize * m_NrTilesX] = 1;
+	}
+	for (int sample{}; sample < m_NrSamples; ++sample)
+	{
+		if (fragment.coverageMask & (1u << sample))
+			pSampleColors[sample] = color;
+	}
+}
+
+void dae::Renderer::GetShadingPosition(const Fragment& fragment, float& x, float& y) const
+{
+	x = static_cast<float>(fragment.pixelIndex % m_Width);
+	y = static_cast<float>(fragment.pixelIndex / m_Width);
+	if (fragment.coverageMask == m_FullCoverage)
+		return;
+
+	//The samples held are all inside the triangle, so is their centroid
+	float offsetX{};
+	float offsetY{};
+	int nrSamples{};
+	for (int sample{}; sample < m_NrSamples; ++sample)
+	{
+		if (!(fragment.coverageMask & (1u << sample)))
+			continue;
+		offsetX += m_SampleOffsetsX[sample];
+		offsetY += m_SampleOffsetsY[sample];
+		++nrSamples;
+	}
+	x += offsetX / static_cast<float>(nrSamples);
+	y += offsetY / static_cast<float>(nrSamples);
+}
+
+void dae::Renderer::ResolveMultisampling()
+{
+	TRACE_ZONE("ResolveMultisampling");
+	m_pJobSystem->ParallelFor(m_NrTilesX * m_NrTilesY, 1, [this](size_t begin, size_t end, int workerIdx)
+		{
+			uint64_t nrPixelsResolved{};
+			for (size_t tileIdx{ begin }; tileIdx < end; ++tileIdx)
+			{
+				//Every pixel of a compressed tile already holds its one color
+				if (!m_pExpandedTiles[tileIdx])
+					continue;
+				m_pExpandedTiles[tileIdx] = 0;
+
+				const int tileX{ static_cast<int>(tileIdx) % m_NrTilesX * m_TileSize };
+				const int tileY{ static_cast<int>(tileIdx) / m_NrTilesX * m_TileSize };
+				const int endingX{ std::min(tileX + m_TileSize, m_Width) };
+				const int endingY{ std::min(tileY + m_TileSize, m_Height) };
+				for (int py{ tileY }; py < endingY; ++py)
+				{
+					for (int pixelIdx{ py * m_Width + tileX }; pixelIdx < py * m_Width + endingX; ++pixelIdx)
+					{
+						if (!m_pExpandedPixels[pixelIdx])
+							continue;
+						m_pExpandedPixels[pixelIdx] = 0;
+						++nrPixelsResolved;
+
+						//Box filter of the samples, two channels at once, rounded to nearest
+						const uint32_t* pSampleColors{ m_pSampleColors + static_cast<size_t>(pixelIdx) * m_NrSamples };
+						uint32_t redBlue{};
+						uint32_t green{};
+						for (int sample{}; sample < m_NrSamples; ++sample)
+						{
+							redBlue += pSampleColors[sample] & 0xFF00FFu;
+							green += pSampleColors[sample] & 0x00FF00u;
+						}
+						m_pRenderPixels[pixelIdx] = (((redBlue + 0x020002u) >> 2) & 0xFF00FFu) | (((green + 0x000200u) >> 2) & 0x00FF00u);
+					}
+				}
+			}
+			m_pWorkers[workerIdx].stats.pixelsMultisampled += nrPixelsResolved;
+		});
+}
+
+bool dae::Renderer::IsMultisamplingActive() const
+{
+	//The bounding box view draws the boxes themselves
+	return m_IsMultisampling && m_RenderMode != RenderMode::BoundingBox;
+}
+
+void dae::Renderer::ReconstructCheckerboard()
+{
+	TRACE_ZONE("ReconstructCheckerboard");
+	const Matrix viewProjection{ m_Camera.viewMatrix * m_Camera.projectionMatrix };
+	const bool isHistoryValid{ m_IsHistoryValid && m_HistoryWorldMatrices.size() == m_Scene.GetNrInstances() };
+	const bool isLightingStill{ m_HistoryLightVersion == m_Scene.GetLightVersion() };
+
+	//From the NDC position of this frame to the clip position in the last one. Draws that did not move find their
+	//pixels at the same place, but the history there may show another instance that moved away since
+	struct DrawReprojection
+	{
+		Matrix toPreviousClip{};
+		bool isStill{};
+	};
+	DrawReprojection* pReprojections{ m_FrameArena.Allocate<DrawReprojection>(m_NrDraws) };
+	for (uint32_t drawIdx{}; isHistoryValid && drawIdx < m_NrDraws; ++drawIdx)
+	{
+		const uint32_t instanceIdx{ m_pDraws[drawIdx].instanceIndex };
+		const Matrix current{ m_Scene.GetInstance(instanceIdx).worldMatrix * viewProjection };
+		const Matrix previous{ m_HistoryWorldMatrices[instanceIdx] * m_HistoryViewProjection };
+		new (&pReprojections[drawIdx]) DrawReprojection{ Matrix::Inverse(current) * previous, current == previous };
+	}
+
+	//Per channel of 0x00RRGGBB pixels
+	const auto channel = [](uint32_t pixel, int shift) { return (pixel >> shift) & 0xFFu; };
+	const auto clampToNeighbours = [channel](uint32_t color, const uint32_t (&neighbours)[4])
+	{
+		uint32_t result{};
+		for (int shift{}; shift < 24; shift += 8)
+		{
+			const uint32_t minValue{ std::min(std::min(channel(neighbours[0], shift), channel(neighbours[1], shift)),
+				std::min(channel(neighbours[2], shift), channel(neighbours[3], shift))) };
+			const uint32_t maxValue{ std::max(std::max(channel(neighbours[0], shift), channel(neighbours[1], shift)),
+				std::max(channel(neighbours[2], shift), channel(neighbours[3], shift))) };
+			result |= std::clamp(channel(color, shift), minValue, maxValue) << shift;
+		}
+		return result;
+	};
+	const auto getDistance = [channel](uint32_t pixel0, uint32_t pixel1)
+	{
+		int distance{};
+		for (int shift{}; shift < 24; shift += 8)
+		{
+			distance += std::abs(static_cast<int>(channel(pixel0, shift)) - static_cast<int>(channel(pixel1, shift)));
+		}
+		return distance;
+	};
+	const auto average = [](uint32_t pixel0, uint32_t pixel1) { return (pixel0 & pixel1) + (((pixel0 ^ pixel1) & 0xFEFEFEu) >> 1); };
+	//Weight of pixel1 out of 256, two channels at once
+	const auto blend = [](uint32_t pixel0, uint32_t pixel1, uint32_t weight)
+	{
+		const uint32_t redBlue{ (((pixel0 & 0xFF00FFu) * (256 - weight) + (pixel1 & 0xFF00FFu) * weight) >> 8) & 0xFF00FFu };
+		const uint32_t green{ (((pixel0 & 0x00FF00u) * (256 - weight) + (pixel1 & 0x00FF00u) * weight) >> 8) & 0x00FF00u };
+		return redBlue | green;
+	};
+	//Parity of the pixels shaded last frame
+	const int shadedParity{ m_CheckerboardParity ^ 1 };
+
+	//Locals, the pixel stores could otherwise alias the members and force them to be read again
+	const int renderWidth{ m_Width };
+	const int renderHeight{ m_Height };
+	const float width{ static_cast<float>(renderWidth) };
+	const float height{ static_cast<float>(renderHeight) };
+	const int unshadedParity{ shadedParity };
+	uint32_t* const pRenderPixels{ m_pRenderPixels };
+	const uint32_t* const pHistoryPixels{ m_pHistoryPixels };
+	uint32_t* const pNextHistoryPixels{ m_pNextHistoryPixels };
+	const float* const pDepthPixels{ m_pDepthBufferPixels };
+	const uint32_t* const pDrawIndexPixels{ m_pDrawIndexPixels };
+	const uint32_t* const pHistoryInstancePixels{ m_pHistoryInstancePixels };
+	uint32_t* const pNextHistoryInstancePixels{ m_pNextHistoryInstancePixels };
+	const InstanceDraw* const pDraws{ m_pDraws };
+	const int currentParity{ m_CheckerboardParity };
+	m_pJobSystem->ParallelFor(renderHeight, 16, [&](size_t begin, size_t end, int workerIdx)
+		{
+			TRACE_ZONE("ReconstructCheckerboard rows");
+			uint64_t nrReprojected{};
+			uint64_t nrInterpolated{};
+			for (int y{ static_cast<int>(begin) }; y < static_cast<int>(end); ++y)
+			{
+				uint32_t* pRow{ pRenderPixels + y * renderWidth };
+				const uint32_t* pRowAbove{ y > 0 ? pRow - renderWidth : pRow + (y + 1 < renderHeight ? renderWidth : 0) };
+				const uint32_t* pRowBelow{ y + 1 < renderHeight ? pRow + renderWidth : pRowAbove };
+				for (int x{ (y + unshadedParity) & 1 }; x < renderWidth; x += 2)
+				{
+					//Nothing covers it, it keeps the background
+					const int pixelIndex{ x + y * renderWidth };
+					const float depth{ pDepthPixels[pixelIndex] };
+					if (depth == FLT_MAX)
+						continue;
+
+					//The four neighbours were all shaded this frame, past the border the opposite one stands in
+					const int leftX{ x > 0 ? x - 1 : std::min(x + 1, renderWidth - 1) };
+					const int rightX{ x + 1 < renderWidth ? x + 1 : leftX };
+					const uint32_t neighbours[4]{ pRow[leftX], pRow[rightX], pRowAbove[x], pRowBelow[x] };
+
+					bool isReprojected{};
+					if (isHistoryValid)
+					{
+						const uint32_t drawIdx{ pDrawIndexPixels[pixelIndex] };
+						const DrawReprojection& reprojection{ pReprojections[drawIdx] };
+						if (reprojection.isStill)
+						{
+							//Taken as is only when the same instance was shaded there under the same lights. Otherwise
+							//it shows an instance that moved away or old light, clamped it cannot leave a trail
+							const uint32_t history{ pHistoryPixels[pixelIndex] };
+							const bool isSameSurface{ isLightingStill && pHistoryInstancePixels[pixelIndex] == pDraws[drawIdx].instanceIndex };
+							pRow[x] = isSameSurface ? history : clampToNeighbours(history, neighbours);
+							isReprojected = true;
+						}
+						else
+						{
+							const float ndcX{ 2.f * static_cast<float>(x) / width - 1.f };
+							const float ndcY{ 1.f - 2.f * static_cast<float>(y) / height };
+							const Vector4 previous{ reprojection.toPreviousClip.TransformPoint(ndcX, ndcY, depth, 1.f) };
+							const float invW{ 1.f / previous.w };
+							const float previousX{ (previous.x * invW + 1.f) * 0.5f * width };
+							const float previousY{ (1.f - previous.y * invW) * 0.5f * height };
+							//Bilinear over the pixels shaded last frame only, the ones reconstructed in between would pile
+							//up their error frame after frame. They lie on a grid rotated by 45 degrees: (u, v) = (x + y, x - y) / 2
+							const float u{ (previousX + previousY - static_cast<float>(shadedParity)) * 0.5f };
+							const float v{ (previousX - previousY - static_cast<float>(shadedParity)) * 0.5f };
+							const float floorU{ std::floor(u) };
+							const float floorV{ std::floor(v) };
+							const int u0{ static_cast<int>(floorU) };
+							const int v0{ static_cast<int>(floorV) };
+							const int cornerX{ u0 + v0 + shadedParity };
+							const int cornerY{ u0 - v0 };
+							//Corners (u0, v0), (u0 + 1, v0), (u0, v0 + 1) and (u0 + 1, v0 + 1)
+							if (previous.w > 0.f && cornerX >= 0 && cornerX + 2 < renderWidth && cornerY >= 1 && cornerY + 1 < renderHeight)
+							{
+								const uint32_t* pCorner{ pHistoryPixels + cornerX + cornerY * renderWidth };
+								const uint32_t weightU{ static_cast<uint32_t>(static_cast<int>((u - floorU) * 256.f)) };
+								const uint32_t weightV{ static_cast<uint32_t>(static_cast<int>((v - floorV) * 256.f)) };
+								const uint32_t history{ blend(blend(pCorner[0], pCorner[1 + renderWidth], weightU), blend(pCorner[1 - renderWidth], pCorner[2], weightU), weightV) };
+								//Clamped to what the neighbours show now, so a surface that was revealed or relit keeps
+								//at most the color range around it instead of the old one
+								pRow[x] = clampToNeighbours(history, neighbours);
+								isReprojected = true;
+							}
+						}
+					}
+
+					if (isReprojected)
+					{
+						++nrReprojected;
+						continue;
+					}
+					//Along the neighbours that agree most, so an edge is followed instead of blurred
+					pRow[x] = getDistance(neighbours[0], neighbours[1]) <= getDistance(neighbours[2], neighbours[3]) ?
+						average(neighbours[0], neighbours[1]) : average(neighbours[2], neighbours[3]);
+					++nrInterpolated;
+				}
+				std::copy_n(pRow, renderWidth, pNextHistoryPixels + y * renderWidth);
+				//Next frame reconstructs the pixels shaded in this one
+				for (int x{ (y + currentParity) & 1 }; x < renderWidth; x += 2)
+				{
+					const int pixelIndex{ x + y * renderWidth };
+					pNextHistoryInstancePixels[pixelIndex] = pDepthPixels[pixelIndex] == FLT_MAX ? m_NoInstance : pDraws[pDrawIndexPixels[pixelIndex]].instanceIndex;
+				}
+			}
+			m_pWorkers[workerIdx].stats.pixelsReprojected += nrReprojected;
+			m_pWorkers[workerIdx].stats.pixelsInterpolated += nrInterpolated;
+		});
+
+	std::swap(m_pHistoryPixels, m_pNextHistoryPixels);
+	std::swap(m_pHistoryInstancePixels, m_pNextHistoryInstancePixels);
+	m_HistoryViewProjection = viewProjection;
+	m_HistoryLightVersion = m_Scene.GetLightVersion();
+	m_HistoryWorldMatrices.resize(m_Scene.GetNrInstances());
+	for (uint32_t instanceIdx{}; instanceIdx < m_Scene.GetNrInstances(); ++instanceIdx)
+	{
+		m_HistoryWorldMatrices[instanceIdx] = m_Scene.GetInstance(instanceIdx).worldMatrix;
+	}
+	m_IsHistoryValid = true;
+	m_CheckerboardParity ^= 1;
+}
+
+bool dae::Renderer::IsCheckerboardActive() const
+{
+	//Reconstruction reads one depth and color per pixel
+	return m_IsCheckerboard && m_RenderMode == RenderMode::Normal && !IsMultisamplingActive();
+}
+
+void dae::Renderer::MergeWorkerStats()
+{
+	m_PipelineStats = {};
+	m_PipelineStats.arenaBytes = m_FrameArena.GetUsedBytes();
+	for (int workerIdx{}; workerIdx < GetNrWorkers(); ++workerIdx)
+	{
+		WorkerContext& worker{ m_pWorkers[workerIdx] };
+		m_PipelineStats += worker.stats;
+		m_PipelineStats.arenaBytes += worker.arena.GetUsedBytes();
+		worker.stats = {};
+	}
+}
+
+void dae::Renderer::ClearBackground() const
+{
+	std::fill_n(m_pRenderPixels, m_Width * m_Height, SDL_MapRGB(m_pBackBuffer->format, 100, 100, 100));
+}
+
+void dae::Renderer::UpscaleToOutput()
+{
+	TRACE_ZONE("Upscale");
+	//Every output column and row falls between two source texels, the weight of the second one is in 1/256
+	struct Tap
+	{
+		int first;
+		int second;
+		uint32_t weight;
+	};
+	const auto createTaps = [](Tap* pTaps, int outputSize, int sourceSize)
+	{
+		const float step{ static_cast<float>(sourceSize) / static_cast<float>(outputSize) };
+		for (int i{}; i < outputSize; ++i)
+		{
+			//Pixel centers line up, the border texels are held
+			const float source{ std::max((static_cast<float>(i) + 0.5f) * step - 0.5f, 0.f) };
+			const int first{ std::min(static_cast<int>(source), sourceSize - 1) };
+			pTaps[i] = Tap{ first, std::min(first + 1, sourceSize - 1), static_cast<uint32_t>((source - static_cast<float>(first)) * 256.f + 0.5f) };
+		}
+	};
+	Tap* pColumns{ m_FrameArena.Allocate<Tap>(m_OutputWidth) };
+	Tap* pRows{ m_FrameArena.Allocate<Tap>(m_OutputHeight) };
+	createTaps(pColumns, m_OutputWidth, m_Width);
+	createTaps(pRows, m_OutputHeight, m_Height);
+
+	//Two channels at a time in the 16 bit halves of a word, whatever the layout of the surface.
+	//The weights add up to 256 at most, so a channel times its weight stays inside its half
+	constexpr uint32_t evenChannels{ 0x00FF00FF };
+	const auto blend = [](uint32_t color0, uint32_t color1, uint32_t weight1)
+	{
+		const uint32_t weight0{ 256 - weight1 };
+		const uint32_t even{ ((color0 & evenChannels) * weight0 + (color1 & evenChannels) * weight1) >> 8 };
+		const uint32_t odd{ ((color0 >> 8) & evenChannels) * weight0 + ((color1 >> 8) & evenChannels) * weight1 };
+		return (even & evenChannels) | (odd & ~evenChannels);
+	};
+
+	if (m_UpscaleFilter == UpscaleFilter::Bilinear)
+	{
+		m_pJobSystem->ParallelFor(m_OutputHeight, 16, [&](size_t begin, size_t end, int workerIdx)
+			{
+				TRACE_ZONE("Upscale rows");
+				//Source rows scaled to the output width, neighbouring output rows mostly need the same two
+				FrameArena& arena{ m_pWorkers[workerIdx].arena };
+				uint32_t* pScaledRows[2]{ arena.Allocate<uint32_t>(m_OutputWidth), arena.Allocate<uint32_t>(m_OutputWidth) };
+				int scaledRows[2]{ -1, -1 };
+				const auto getScaledRow = [&](int sourceRow, int keptRow)
+				{
+					for (int slot{}; slot < 2; ++slot)
+					{
+						if (scaledRows[slot] == sourceRow)
+							return static_cast<const uint32_t*>(pScaledRows[slot]);
+					}
+					const int slot{ scaledRows[0] == keptRow ? 1 : 0 };
+					const uint32_t* pSource{ m_pRenderPixels + sourceRow * m_Width };
+					for (int x{}; x < m_OutputWidth; ++x)
+					{
+						const Tap& column{ pColumns[x] };
+						pScaledRows[slot][x] = blend(pSource[column.first], pSource[column.second], column.weight);
+					}
+					scaledRows[slot] = sourceRow;
+					return static_cast<const uint32_t*>(pScaledRows[slot]);
+				};
+
+				for (size_t y{ begin }; y < end; ++y)
+				{
+					const Tap& row{ pRows[y] };
+					const uint32_t* pFirstRow{ getScaledRow(row.first, row.second) };
+					const uint32_t* pSecondRow{ getScaledRow(row.second, row.first) };
+					uint32_t* pOut{ m_pBackBufferPixels + y * m_OutputWidth };
+					for (int x{}; x < m_OutputWidth; ++x)
+					{
+						pOut[x] = blend(pFirstRow[x], pSecondRow[x], row.weight);
+					}
+				}
+			});
+		return;
+	}
+
+	//Weight left to a neighbour by the summed channel difference to the nearest texel, in 1/256
+	static const auto edgeFactors = []()
+	{
+		std::array<uint32_t, 3 * 255 + 1> factors{};
+		for (size_t difference{}; difference < factors.size(); ++difference)
+		{
+			factors[difference] = static_cast<uint32_t>(256 * 32 / (32 + difference));
+		}
+		return factors;
+	}();
+
+	m_pJobSystem->ParallelFor(m_OutputHeight, 16, [&](size_t begin, size_t end, int)
+		{
+			TRACE_ZONE("Upscale rows");
+			for (size_t y{ begin }; y < end; ++y)
+			{
+				const Tap& row{ pRows[y] };
+				const uint32_t* pFirstRow{ m_pRenderPixels + row.first * m_Width };
+				const uint32_t* pSecondRow{ m_pRenderPixels + row.second * m_Width };
+				uint32_t* pOut{ m_pBackBufferPixels + y * m_OutputWidth };
+
+				for (int x{}; x < m_OutputWidth; ++x)
+				{
+					const Tap& column{ pColumns[x] };
+					const uint32_t texels[4]{ pFirstRow[column.first], pFirstRow[column.second], pSecondRow[column.first], pSecondRow[column.second] };
+					uint32_t weights[4]{
+						(256 - column.weight) * (256 - row.weight),
+						column.weight * (256 - row.weight),
+						(256 - column.weight) * row.weight,
+						column.weight * row.weight };
+
+					//Flat areas need no filtering at all
+					const uint32_t nearest{ texels[std::max_element(weights, weights + 4) - weights] };
+					if (texels[0] == nearest && texels[1] == nearest && texels[2] == nearest && texels[3] == nearest)
+					{
+						pOut[x] = nearest;
+						continue;
+					}
+
+					//Neighbours far from the color of the nearest one are most likely across an edge
+					uint32_t totalWeight{};
+					for (int texel{}; texel < 4; ++texel)
+					{
+						int difference{};
+						for (int shift{}; shift < 24; shift += 8)
+						{
+							difference += std::abs(static_cast<int>((texels[texel] >> shift) & 0xFF) - static_cast<int>((nearest >> shift) & 0xFF));
+						}
+						weights[texel] = (weights[texel] * edgeFactors[difference]) >> 8;
+						totalWeight += weights[texel];
+					}
+
+					//Back to 256 in total, rounded down so it never overflows a channel
+					const uint32_t normalize{ (256u << 16) / totalWeight };
+					uint32_t even{};
+					uint32_t odd{};
+					for (int texel{}; texel < 4; ++texel)
+					{
+						const uint32_t weight{ (weights[texel] * normalize) >> 16 };
+						even += (texels[texel] & evenChannels) * weight;
+						odd += ((texels[texel] >> 8) & evenChannels) * weight;
+					}
+					pOut[x] = ((even >> 8) & evenChannels) | (odd & ~evenChannels);
+				}
+			}
+		});
+}
+
+void dae::Renderer::ResetDepthBuffer() const
+{
+	const int nrPixels{ m_Width * m_Height };
+	std::fill_n(m_pDepthBufferPixels, nrPixels, FLT_MAX);
+}
+
+uint32_t dae::Renderer::Shade(const Vertex_Out& pxlInfo, const Model& model, const LightList& lights) const
+{
+	const Texture* pTexture{ model.GetDiffuseTexture() };
+	const Texture* pNormalTexture{ model.GetNormalTexture() };
+	const Texture* pGlossinessTexture{ model.GetGlossinessTexture() };
+	const Texture* pSpecularTexture{ model.GetSpecularTexture() };
+
+	Vector3 normal{ pxlInfo.normal };
+
+	ColorRGB finalColor{};
+
+	if (pNormalTexture != nullptr && m_IsNormalActive)
+	{
+		const Vector3 binormal = Vector3::Cross(pxlInfo.normal, pxlInfo.tangent);
+		const Matrix tangentSpaceAxis = Matrix{ pxlInfo.tangent, binormal, pxlInfo.normal, Vector3::Zero };
+
+		//Clamp uv between -1 and 1;
+		const ColorRGB currentNormalMap{ 2.0f * pNormalTexture->Sample(pxlInfo.uv) - ColorRGB{ 1.0f, 1.0f, 1.0f } };
+		
+		const Vector3 normalMapSample{ currentNormalMap.r, currentNormalMap.g, currentNormalMap.b };
+		normal = tangentSpaceAxis.TransformVector(normalMapSample);
+	}
+
+	switch (m_RenderMode)
+	{
+	case RenderMode::Normal:
+	{
+		const bool isDiffuse{ m_LightingMode == LightingMode::Combined || m_LightingMode == LightingMode::Diffuse };
+		const bool isSpecular{ m_LightingMode == LightingMode::Combined || m_LightingMode == LightingMode::Specular };
+		if (isSpecular && (!pGlossinessTexture || !pSpecularTexture))
+		{
+			assert(false);
+		}
+
+		//The textures are read once, whatever the number of lights
+		// cd * (kd) / PI
+		const ColorRGB lambert{ isDiffuse ? pTexture->Sample(pxlInfo.uv) / PI : ColorRGB{} };
+		const float phongExponent{ isSpecular ? m_SpecularShininess * pGlossinessTexture->Sample(pxlInfo.uv).r : 0.f };
+		const ColorRGB specularColor{ isSpecular ? pSpecularTexture->Sample(pxlInfo.uv) : ColorRGB{} };
+		const Vector3 unitNormal{ normal.Normalized() };
+
+		for (uint32_t lightNr{}; lightNr < lights.nrLights; ++lightNr)
+		{
+			const FrameLight& light{ m_pFrameLights[lights.pIndices[lightNr]] };
+			Vector3 toLight{};
+			const float attenuation{ EvaluateLight(light, pxlInfo.worldPosition, toLight) };
+			if (attenuation <= 0.f)
+				continue;
+			const float observedArea{ std::max(Vector3::Dot(unitNormal, toLight), 0.0f) * attenuation };
+
+			switch (m_LightingMode)
+			{
+			case LightingMode::Combined:
+			{
+				const ColorRGB specular{ specularColor * CalculatePhong(phongExponent, toLight, pxlInfo.viewDirection, normal) };
+				finalColor += (light.intensity * lambert + specular) * light.color * observedArea;
+				break;
+			}
+			case LightingMode::ObservedArea:
+			{
+				finalColor += light.color * observedArea;
+				break;
+			}
+			case LightingMode::Diffuse:
+			{
+				finalColor += light.intensity * observedArea * lambert * light.color;
+				break;
+			}
+			case LightingMode::Specular:
+			{
+				const ColorRGB specular{ specularColor * CalculatePhong(phongExponent, toLight, pxlInfo.viewDirection, normal) };
+				finalColor += specular * light.color * observedArea;
+				break;
+			}
+			}
+		}
+		break;
+	}
+	case RenderMode::DepthBuffer:
+	{
+			//Depthbuffer is stored in pxlinfo.color
+		finalColor += pxlInfo.color;
+		break;
+	}
+	case RenderMode::Overdraw:
+		//Never shaded, ResolveOverdraw writes the heat map from the shade counts
+		break;
+	}
+
+	//Packed for the color target, the caller decides which pixels it goes to
+	finalColor.MaxToOne();
+
+	return SDL_MapRGB(m_pBackBuffer->format,
+		static_cast<uint8_t>(finalColor.r * 255),
+		static_cast<uint8_t>(finalColor.g * 255),
+		static_cast<uint8_t>(finalColor.b * 255));
+}
+
+uint32_t dae::Renderer::ShadeFromMaterialAtlas(const TriangleSetup& triangle, float x, float y, const LightList& lights) const
+{
+	const InstanceDraw& draw{ m_pDraws[triangle.drawIndex] };
+	const float wDepth{ 1.0f / triangle.invW.Evaluate(x, y) };
+	const Vector2 uv{ Vector2{
+		triangle.uvOverW[0].Evaluate(x, y),
+		triangle.uvOverW[1].Evaluate(x, y) } * wDepth };
+	const MaterialTexel& texel{ draw.pMaterialAtlas->GetTexel(uv) };
+
+	Vector3 normal{ Vector3{
+		triangle.normalOverW[0].Evaluate(x, y),
+		triangle.normalOverW[1].Evaluate(x, y),
+		triangle.normalOverW[2].Evaluate(x, y) }.Normalized() };
+	if (draw.pModel->GetNormalTexture() != nullptr && m_IsNormalActive)
+	{
+		const Vector3 tangent{ Vector3{
+			triangle.tangentOverW[0].Evaluate(x, y),
+			triangle.tangentOverW[1].Evaluate(x, y),
+			triangle.tangentOverW[2].Evaluate(x, y) }.Normalized() };
+		const Matrix tangentSpaceAxis{ tangent, Vector3::Cross(normal, tangent), normal, Vector3::Zero };
+		normal = tangentSpaceAxis.TransformVector(texel.normalSample);
+	}
+
+	const Vector3 viewDirection{ Vector3{
+		triangle.viewDirectionOverW[0].Evaluate(x, y),
+		triangle.viewDirectionOverW[1].Evaluate(x, y),
+		triangle.viewDirectionOverW[2].Evaluate(x, y) }.Normalized() };
+	const Vector3 worldPosition{ m_Camera.origin + (m_PixelRay + m_PixelRayStepX * x + m_PixelRayStepY * y) * wDepth };
+
+	//The combined lighting of Shade
+	const Vector3 unitNormal{ normal.Normalized() };
+	const ColorRGB specularColor{ texel.GetSpecularColor() };
+	ColorRGB finalColor{};
+	for (uint32_t lightNr{}; lightNr < lights.nrLights; ++lightNr)
+	{
+		const FrameLight& light{ m_pFrameLights[lights.pIndices[lightNr]] };
+		Vector3 toLight{};
+		const float attenuation{ EvaluateLight(light, worldPosition, toLight) };
+		if (attenuation <= 0.f)
+			continue;
+		const float observedArea{ std::max(Vector3::Dot(unitNormal, toLight), 0.0f) * attenuation };
+		const ColorRGB specular{ specularColor * CalculatePhong(texel.phongExponent, toLight, viewDirection, normal) };
+		finalColor += (light.intensity * texel.lambert + specular) * light.color * observedArea;
+	}
+	finalColor.MaxToOne();
+
+	return SDL_MapRGB(m_pBackBuffer->format,
+		static_cast<uint8_t>(finalColor.r * 255),
+		static_cast<uint8_t>(finalColor.g * 255),
+		static_cast<uint8_t>(finalColor.b * 255));
+}
+
+void dae::Renderer::PrepareLights()
+{
+	TRACE_ZONE("PrepareLights");
+	const uint32_t nrLights{ m_Scene.GetNrLights() };
+	m_pFrameLights = m_FrameArena.Allocate<FrameLight>(nrLights);
+	m_NrFrameLights = 0;
+	for (uint32_t lightIdx{}; lightIdx < nrLights; ++lightIdx)
+	{
+		const Light& light{ m_Scene.GetLight(lightIdx) };
+		if (light.type != LightType::Directional)
+			continue;
+
+		FrameLight* pFrameLight{ new (&m_pFrameLights[m_NrFrameLights++]) FrameLight{} };
+		pFrameLight->type = light.type;
+		pFrameLight->toLight = -light.direction.Normalized();
+		pFrameLight->color = light.color;
+		pFrameLight->intensity = light.intensity;
+	}
+	m_NrDirectionalLights = m_NrFrameLights;
+
+	//World space rays under the pixels, raster y points down
+	const float rayScaleX{ m_Camera.aspectRatio * m_Camera.fov };
+	const float rayScaleY{ m_Camera.fov };
+	m_PixelRay = m_Camera.forward - m_Camera.right * rayScaleX + m_Camera.up * rayScaleY;
+	m_PixelRayStepX = m_Camera.right * (2.f * rayScaleX / static_cast<float>(m_Width));
+	m_PixelRayStepY = m_Camera.up * (-2.f * rayScaleY / static_cast<float>(m_Height));
+
+	//Local lights that reach nothing on screen are gone before any tile looks at them
+	const float maxX{ static_cast<float>(m_Width) - 0.5f };
+	const float maxY{ static_cast<float>(m_Height) - 0.5f };
+	for (uint32_t lightIdx{}; lightIdx < nrLights; ++lightIdx)
+	{
+		const Light& light{ m_Scene.GetLight(lightIdx) };
+		if (light.type == LightType::Directional)
+			continue;
+
+		FrameLight& frameLight{ *new (&m_pFrameLights[m_NrFrameLights]) FrameLight{} };
+		frameLight.type = light.type;
+		frameLight.position = light.position;
+		frameLight.viewPosition = m_Camera.viewMatrix.TransformPoint(light.position);
+		frameLight.direction = light.direction.Normalized();
+		frameLight.color = light.color;
+		frameLight.intensity = light.intensity;
+		frameLight.range = light.range;
+		frameLight.invSqrRange = 1.f / (light.range * light.range);
+		frameLight.cosOuterCone = std::cos(light.outerConeAngle);
+		frameLight.invConeFalloff = 1.f / std::max(std::cos(light.innerConeAngle) - frameLight.cosOuterCone, 1e-4f);
+		if (IsLightInFrustum(frameLight, -0.5f, -0.5f, maxX, maxY, m_Camera.nearPlane, m_Camera.farPlane))
+			++m_NrFrameLights;
+	}
+	m_pWorkers[0].stats.lightsLocalVisible += m_NrFrameLights - m_NrDirectionalLights;
+
+	//Every batch starts from the directional lights and adds the local ones of its tile behind them
+	for (int workerIdx{}; workerIdx < GetNrWorkers(); ++workerIdx)
+	{
+		WorkerContext& worker{ m_pWorkers[workerIdx] };
+		worker.pLightIndices = worker.arena.Allocate<uint32_t>(m_NrFrameLights);
+		for (uint32_t lightIdx{}; lightIdx < m_NrDirectionalLights; ++lightIdx)
+		{
+			worker.pLightIndices[lightIdx] = lightIdx;
+		}
+		worker.lights = LightList{ worker.pLightIndices, m_NrDirectionalLights };
+	}
+}
+
+void dae::Renderer::CullTileLights(const Fragment* pFragments, size_t nrFragments, WorkerContext& worker) const
+{
+	worker.lights.nrLights = m_NrDirectionalLights;
+	const uint32_t nrLocalLights{ m_NrFrameLights - m_NrDirectionalLights };
+	if (nrFragments == 0 || nrLocalLights == 0)
+		return;
+
+	//View depth range of the batch at the positions it is shaded at, from the plane the shading reads it from.
+	//Coarse blocks and partly covered multisampled pixels are not shaded at the pixel center
+	float minInvW{ FLT_MAX };
+	float maxInvW{ -FLT_MAX };
+	for (size_t fragmentIdx{}; fragmentIdx < nrFragments; ++fragmentIdx)
+	{
+		const Fragment& fragment{ pFragments[fragmentIdx] };
+		const TriangleSetup& triangle{ m_pTriangles[fragment.triangleIndex] };
+		float shadeX{};
+		float shadeY{};
+		if (triangle.shadingRate > 1)
+			GetBlockCenter(triangle, fragment.pixelIndex % m_Width, fragment.pixelIndex / m_Width, shadeX, shadeY);
+		else
+			GetShadingPosition(fragment, shadeX, shadeY);
+		const float invW{ triangle.invW.Evaluate(shadeX, shadeY) };
+		minInvW = std::min(minInvW, invW);
+		maxInvW = std::max(maxInvW, invW);
+	}
+
+	//The whole tile up to its pixel borders, every shading position above lies inside it
+	const int tileX{ pFragments[0].pixelIndex % m_Width / m_TileSize * m_TileSize };
+	const int tileY{ pFragments[0].pixelIndex / m_Width / m_TileSize * m_TileSize };
+	const float minX{ static_cast<float>(tileX) - 0.5f };
+	const float minY{ static_cast<float>(tileY) - 0.5f };
+	const float maxX{ static_cast<float>(std::min(tileX + m_TileSize, m_Width)) - 0.5f };
+	const float maxY{ static_cast<float>(std::min(tileY + m_TileSize, m_Height)) - 0.5f };
+
+	uint32_t nrLights{ m_NrDirectionalLights };
+	for (uint32_t lightIdx{ m_NrDirectionalLights }; lightIdx < m_NrFrameLights; ++lightIdx)
+	{
+		if (IsLightInFrustum(m_pFrameLights[lightIdx], minX, minY, maxX, maxY, 1.f / maxInvW, 1.f / minInvW))
+			worker.pLightIndices[nrLights++] = lightIdx;
+	}
+	worker.lights.nrLights = nrLights;
+	worker.stats.tileLightsTested += nrLocalLights;
+	worker.stats.tileLightsKept += nrLights - m_NrDirectionalLights;
+}
+
+bool dae::Renderer::IsLightInFrustum(const FrameLight& light, float minX, float minY, float maxX, float maxY, float nearDepth, float farDepth) const
+{
+	const Vector3& center{ light.viewPosition };
+	const float radius{ light.range };
+	if (center.z + radius < nearDepth || center.z - radius > farDepth)
+		return false;
+
+	//The side planes go through the camera, a slope is x / z or y / z of the view space points under a raster edge
+	const float rayScaleX{ m_Camera.aspectRatio * m_Camera.fov };
+	const float rayScaleY{ m_Camera.fov };
+	const float minSlopeX{ rayScaleX * (2.f * minX / static_cast<float>(m_Width) - 1.f) };
+	const float maxSlopeX{ rayScaleX * (2.f * maxX / static_cast<float>(m_Width) - 1.f) };
+	const float minSlopeY{ rayScaleY * (1.f - 2.f * maxY / static_cast<float>(m_Height)) };
+	const float maxSlopeY{ rayScaleY * (1.f - 2.f * minY / static_cast<float>(m_Height)) };
+
+	//Signed distance of the center to a plane, positive on the inside
+	const auto isInside = [radius](float coordinate, float depth, float slope, float side)
+		{
+			return side * (coordinate - slope * depth) >= -radius * std::sqrt(1.f + slope * slope);
+		};
+	return isInside(center.x, center.z, minSlopeX, 1.f) && isInside(center.x, center.z, maxSlopeX, -1.f)
+		&& isInside(center.y, center.z, minSlopeY, 1.f) && isInside(center.y, center.z, maxSlopeY, -1.f);
+}
+
+float dae::Renderer::EvaluateLight(const FrameLight& light, const Vector3& position, Vector3& toLight) const
+{
+	if (light.type == LightType::Directional)
+	{
+		toLight = light.toLight;
+		return 1.f;
+	}
+
+	const Vector3 offset{ light.position - position };
+	const float sqrDistance{ offset.SqrMagnitude() };
+	const float window{ 1.f - Square(sqrDistance * light.invSqrRange) };
+	if (window <= 0.f)
+		return 0.f;
+
+	const float distance{ std::max(std::sqrt(sqrDistance), m_MinLightDistance) };
+	toLight = offset / distance;
+	float attenuation{ window * window / (distance * distance) };
+	if (light.type == LightType::Spot)
+	{
+		const float cone{ std::clamp((Vector3::Dot(-toLight, light.direction) - light.cosOuterCone) * light.invConeFalloff, 0.f, 1.f) };
+		attenuation *= cone * cone;
+	}
+	return attenuation;
+}
+
+void dae::Renderer::InitializeBuffer()
+{
+	//Headless renderers have no front buffer, the back buffer is a plain memory surface
+	if (m_pWindow)
+	{
+		m_pFrontBuffer = SDL_GetWindowSurface(m_pWindow);
+	}
+	m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
+	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
+	m_pRenderPixels = m_pBackBufferPixels;
+	//Room for any render scale, so a resize never allocates
+	m_pScaledPixels = new uint32_t[m_Width * m_Height];
+	m_pDepthBufferPixels = new float[m_Width * m_Height];
+	m_pShadeCountPixels = new uint8_t[m_Width * m_Height]{};
+	m_pHistoryPixels = new uint32_t[m_Width * m_Height];
+	m_pNextHistoryPixels = new uint32_t[m_Width * m_Height];
+	m_pDrawIndexPixels = new uint32_t[m_Width * m_Height];
+	m_pHistoryInstancePixels = new uint32_t[m_Width * m_Height];
+	m_pNextHistoryInstancePixels = new uint32_t[m_Width * m_Height];
+	ResetDepthBuffer();
+
+	m_NrTilesX = (m_Width + m_TileSize - 1) / m_TileSize;
+	m_NrTilesY = (m_Height + m_TileSize - 1) / m_TileSize;
+
+	m_pOcclusionBuffer = std::make_unique<OcclusionBuffer>(m_OcclusionWidth, m_OcclusionHeight, m_Width, m_Height);
+	m_Occluders.reserve(m_MaxOccluders);
+}
+
+void dae::Renderer::InitializeCamera()
+{
+	m_AspectRatio = (float)m_Width / (float)m_Height;
+	m_Camera.Initialize(60.f, { .0f,.0f,-10.f }, m_AspectRatio);
+}
+
+void dae::Renderer::InitializeScene(std::shared_ptr<const Model> pModel)
+{
+	const uint32_t modelIndex{ m_Scene.AddModel(std::move(pModel)) };
+
+	const Vector3 translation{ m_Camera.origin + Vector3{ 0.0f, -10.0f, 30.0f } };
+	const Vector3 rotation{ };
+	const Vector3 scale{ Vector3{ 1.0f, 1.0f, 1.0f } };
+	m_Scene.AddInstance(modelIndex, Matrix::CreateScale(scale) * Matrix::CreateRotation(rotation) * Matrix::CreateTranslation(translation));
+
+	Light sun{};
+	sun.type = LightType::Directional;
+	sun.direction = Vector3{ 0.577f, -0.577f, 0.577f }.Normalized();
+	sun.intensity = m_SunIntensity;
+	m_Scene.AddLight(sun);
+}
+
+void dae::Renderer::CullInstances()
+{
+	TRACE_ZONE("CullInstances");
+	if (m_Scene.GetVersion() != m_TransformedSceneVersion)
+	{
+		m_InstanceBvh.Update(m_Scene);
+	}
+
+	const uint32_t nrInstances{ m_Scene.GetNrInstances() };
+	const Matrix viewProjectionMatrix{ m_Camera.viewMatrix * m_Camera.projectionMatrix };
+	m_VisibleInstances.resize(nrInstances);
+	m_NrVisibleInstances = m_InstanceBvh.Cull(Frustum::FromViewProjection(viewProjectionMatrix), m_VisibleInstances.data());
+	m_NrInstancesCulledFrustum = nrInstances - m_NrVisibleInstances;
+	m_NrInstancesCulledOcclusion = 0;
+
+	//The occluders promise the depth of the level they are drawn at, so the levels are picked first
+	m_InstanceLods.resize(nrInstances);
+	for (uint32_t visibleIdx{}; visibleIdx < m_NrVisibleInstances; ++visibleIdx)
+	{
+		const uint32_t instanceIdx{ m_VisibleInstances[visibleIdx] };
+		m_InstanceLods[instanceIdx] = SelectLod(m_Scene.GetInstance(instanceIdx), m_InstanceBvh.GetInstanceBounds(instanceIdx));
+	}
+
+	m_Occluders.clear();
+	if (!IsOcclusionCullingActive())
+		return;
+
+	SelectOccluders(viewProjectionMatrix);
+	RenderOccluders();
+
+	//The occluders themselves are always drawn, the depth they promise has to end up in the image
+	uint32_t nrKept{};
+	for (uint32_t visibleIdx{}; visibleIdx < m_NrVisibleInstances; ++visibleIdx)
+	{
+		const uint32_t instanceIdx{ m_VisibleInstances[visibleIdx] };
+		ScreenBounds bounds{};
+		const bool isOccluded{ !IsOccluder(instanceIdx)
+			&& OcclusionBuffer::ProjectBox(m_InstanceBvh.GetInstanceBounds(instanceIdx), viewProjectionMatrix, m_Width, m_Height, bounds)
+			&& m_pOcclusionBuffer->IsOccluded(bounds) };
+		if (!isOccluded)
+			m_VisibleInstances[nrKept++] = instanceIdx;
+	}
+	m_NrInstancesCulledOcclusion = m_NrVisibleInstances - nrKept;
+	m_NrVisibleInstances = nrKept;
+}
+
+uint8_t dae::Renderer::SelectLod(const Instance& instance, const BoundingBox& worldBounds) const
+{
+	if (m_LodPixelError <= 0.f)
+		return 0;
+
+	//Nearest point of the instance, the camera inside its box keeps full detail
+	const Vector3 nearestPoint{ Vector3::Max(worldBounds.min, Vector3::Min(m_Camera.origin, worldBounds.max)) };
+	const float distance{ (nearestPoint - m_Camera.origin).Magnitude() };
+	if (distance <= m_Camera.nearPlane)
+		return 0;
+
+	//World space error to pixels under the vertical field of view, scaled like the instance
+	const float worldScale{ std::max(instance.worldMatrix.GetAxisX().Magnitude(), std::max(instance.worldMatrix.GetAxisY().Magnitude(), instance.worldMatrix.GetAxisZ().Magnitude())) };
+	const float pixelsPerUnit{ static_cast<float>(m_Height) / (2.f * m_Camera.fov * distance) };
+
+	const Model& model{ m_Scene.GetModel(instance.modelIndex) };
+	uint8_t lod{};
+	while (lod + 1u < model.GetNrLods() && model.GetLod(lod + 1).lodError * worldScale * pixelsPerUnit <= m_LodPixelError)
+	{
+		++lod;
+	}
+	return lod;
+}
+
+void dae::Renderer::SelectOccluders(const Matrix& viewProjectionMatrix)
+{
+	//The visible instances with the largest footprint on screen
+	const float screenArea{ static_cast<float>(m_Width * m_Height) };
+	float occluderAreas[m_MaxOccluders]{};
+	for (uint32_t visibleIdx{}; visibleIdx < m_NrVisibleInstances; ++visibleIdx)
+	{
+		const uint32_t instanceIdx{ m_VisibleInstances[visibleIdx] };
+		ScreenBounds bounds{};
+		if (!OcclusionBuffer::ProjectBox(m_InstanceBvh.GetInstanceBounds(instanceIdx), viewProjectionMatrix, m_Width, m_Height, bounds))
+			continue;
+
+		const Vector2 min{ Vector2::Max(bounds.min, Vector2{}) };
+		const Vector2 max{ Vector2::Min(bounds.max, Vector2{ static_cast<float>(m_Width), static_cast<float>(m_Height) }) };
+		const float area{ std::max(max.x - min.x, 0.f) * std::max(max.y - min.y, 0.f) };
+		if (area < m_MinOccluderScreenShare * screenArea)
+			continue;
+
+		//Insertion into the list sorted by decreasing area
+		size_t slot{ m_Occluders.size() };
+		if (slot == m_MaxOccluders)
+		{
+			if (area <= occluderAreas[slot - 1])
+				continue;
+			m_Occluders.pop_back();
+			--slot;
+		}
+		m_Occluders.push_back(instanceIdx);
+		for (; slot > 0 && occluderAreas[slot - 1] < area; --slot)
+		{
+			occluderAreas[slot] = occluderAreas[slot - 1];
+			m_Occluders[slot] = m_Occluders[slot - 1];
+		}
+		occluderAreas[slot] = area;
+		m_Occluders[slot] = instanceIdx;
+	}
+}
+
+void dae::Renderer::RenderOccluders()
+{
+	TRACE_ZONE("RenderOccluders");
+	m_pOcclusionBuffer->Clear();
+
+	for (const uint32_t instanceIdx : m_Occluders)
+	{
+		const Instance& instance{ m_Scene.GetInstance(instanceIdx) };
+		const Mesh& mesh{ m_Scene.GetModel(instance.modelIndex).GetLod(m_InstanceLods[instanceIdx]) };
+
+		//Positions only, through the same kernel math as the vertex stage so the culling decisions below match
+		const Matrix worldViewProjectionMatrix{ instance.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix };
+		const VertexBlockTransform transform{ worldViewProjectionMatrix, instance.worldMatrix, m_Width, m_Height };
+		const bool isCompact{ mesh.vertexFormat == VertexFormat::Compact };
+		const float* pPositionX{ isCompact ? mesh.compactStreams.positionX.data() : mesh.streams.positionX.data() };
+		const float* pPositionY{ isCompact ? mesh.compactStreams.positionY.data() : mesh.streams.positionY.data() };
+		const float* pPositionZ{ isCompact ? mesh.compactStreams.positionZ.data() : mesh.streams.positionZ.data() };
+
+		const size_t nrVertices{ GetPaddedVertexCount(mesh.nrVertices) };
+		float* pNdcX{ m_FrameArena.Allocate<float>(nrVertices) };
+		float* pNdcY{ m_FrameArena.Allocate<float>(nrVertices) };
+		float* pNdcZ{ m_FrameArena.Allocate<float>(nrVertices) };
+		float* pW{ m_FrameArena.Allocate<float>(nrVertices) };
+		float* pRasterX{ m_FrameArena.Allocate<float>(nrVertices) };
+		float* pRasterY{ m_FrameArena.Allocate<float>(nrVertices) };
+		for (size_t i{}; i < nrVertices; i += Simd::Float8::laneCount)
+		{
+			Simd::Float8 clip[4]{};
+			transform.TransformPosition(Simd::Float8::Load(pPositionX + i), Simd::Float8::Load(pPositionY + i), Simd::Float8::Load(pPositionZ + i), clip);
+			transform.ProjectPosition(clip, pNdcX + i, pNdcY + i, pNdcZ + i, pW + i, pRasterX + i, pRasterY + i);
+		}
+
+		//Only triangles triangle setup keeps can promise their depth
+		const size_t nrTriangles{ mesh.GetNrTriangles() };
+		for (size_t triangleNr{}; triangleNr < nrTriangles; ++triangleNr)
+		{
+			uint32_t triangle[3]{};
+			mesh.GetTriangle(triangleNr, triangle);
+			if (IsVertexSame(triangle[0], triangle[1], triangle[2]))
+				continue;
+
+			const auto isOutsideFrustum = [&](uint32_t vertex)
+			{
+				return m_Camera.IsOutsideFrustum(Vector4{ pNdcX[vertex], pNdcY[vertex], pNdcZ[vertex], pW[vertex] });
+			};
+			if (isOutsideFrustum(triangle[0]) || isOutsideFrustum(triangle[1]) || isOutsideFrustum(triangle[2]))
+				continue;
+
+			const Vector2 v0{ pRasterX[triangle[0]], pRasterY[triangle[0]] };
+			const Vector2 v1{ pRasterX[triangle[1]], pRasterY[triangle[1]] };
+			const Vector2 v2{ pRasterX[triangle[2]], pRasterY[triangle[2]] };
+			if (Vector2::Cross(v1 - v0, v2 - v1) < FLT_EPSILON)
+				continue;
+
+			m_pOcclusionBuffer->RasterizeTriangle(v0, v1, v2, pNdcZ[triangle[0]], pNdcZ[triangle[1]], pNdcZ[triangle[2]]);
+		}
+	}
+	m_pOcclusionBuffer->Resolve();
+}
+
+bool dae::Renderer::IsOccluder(uint32_t instanceIdx) const
+{
+	return std::find(m_Occluders.begin(), m_Occluders.end(), instanceIdx) != m_Occluders.end();
+}
+
+bool dae::Renderer::IsOcclusionCullingActive() const
+{
+	//The bounding box view draws hidden triangles too. The occluders only cover the pixel centers, a sample next to
+	//one can still see past them
+	return m_IsOcclusionCulling && m_RenderMode != RenderMode::BoundingBox && !IsMultisamplingActive();
+}
+
+void dae::Renderer::ToggleOcclusionCulling()
+{
+	SetOcclusionCulling(!m_IsOcclusionCulling);
+}
+
+void dae::Renderer::SetRenderScale(float scale)
+{
+	assert(scale > 0.f && scale <= 1.f);
+	m_RenderScale = scale;
+	const int width{ std::clamp(static_cast<int>(std::lround(static_cast<float>(m_OutputWidth) * scale)), 1, m_OutputWidth) };
+	const int height{ std::clamp(static_cast<int>(std::lround(static_cast<float>(m_OutputHeight) * scale)), 1, m_OutputHeight) };
+	if (width == m_Width && height == m_Height)
+		return;
+
+	//Everything sized per frame follows on its own, the buffers have room for the output size
+	m_Width = width;
+	m_Height = height;
+	m_NrTilesX = (m_Width + m_TileSize - 1) / m_TileSize;
+	m_NrTilesY = (m_Height + m_TileSize - 1) / m_TileSize;
+	m_pOcclusionBuffer->SetTargetSize(m_Width, m_Height);
+	m_pRenderPixels = width == m_OutputWidth && height == m_OutputHeight ? m_pBackBufferPixels : m_pScaledPixels;
+	ResetHistory();
+	Invalidate();
+}
+
+void dae::Renderer::SetDynamicResolution(const DynamicResolutionSettings& settings)
+{
+	m_DynamicResolution = DynamicResolutionController{ settings };
+	SetUpscaleFilter(settings.upscaleFilter);
+	SetDynamicResolutionEnabled(true);
+}
+
+void dae::Renderer::SetDynamicResolutionEnabled(bool isEnabled)
+{
+	m_IsDynamicResolution = isEnabled;
+	m_DynamicResolution.Reset();
+	SetRenderScale(isEnabled ? m_DynamicResolution.GetScale() : 1.f);
+}
+
+void dae::Renderer::ToggleDynamicResolution()
+{
+	SetDynamicResolutionEnabled(!m_IsDynamicResolution);
+}
+
+void dae::Renderer::UpdateDynamicResolution(float elapsedSec)
+{
+	//A presented again frame says nothing about the cost of rendering one
+	if (!m_IsDynamicResolution || m_IsFrameReused)
+		return;
+
+	SetRenderScale(m_DynamicResolution.Update(elapsedSec * 1000.f));
+}
+
+void dae::Renderer::ToggleDrawSorting()
+{
+	SetDrawSorting(!m_IsSortingDraws);
+}
+
+void dae::Renderer::SetMaxShadingRate(int maxRate)
+{
+	assert(maxRate == 1 || maxRate == 2 || maxRate == 4);
+	m_MaxShadingRate = maxRate;
+	ResetHistory();
+	Invalidate();
+}
+
+void dae::Renderer::ToggleShadingRate()
+{
+	SetMaxShadingRate(m_MaxShadingRate == 4 ? 1 : m_MaxShadingRate * 2);
+}
+
+void dae::Renderer::SetCheckerboard(bool isEnabled)
+{
+	m_IsCheckerboard = isEnabled;
+	ResetHistory();
+	Invalidate();
+}
+
+void dae::Renderer::ToggleCheckerboard()
+{
+	SetCheckerboard(!m_IsCheckerboard);
+}
+
+void dae::Renderer::SetMaterialAtlas(bool isEnabled)
+{
+	m_IsMaterialAtlas = isEnabled;
+	if (isEnabled)
+	{
+		BuildMaterialAtlases();
+	}
+	m_IsFrameDirty = true;
+}
 
-using namespace dae;
+void dae::Renderer::BuildMaterialAtlases()
+{
+	m_pMaterialAtlases.resize(m_Scene.GetNrModels());
+	for (uint32_t modelIdx{}; modelIdx < m_Scene.GetNrModels(); ++modelIdx)
+	{
+		const Model& model{ m_Scene.GetModel(modelIdx) };
+		if (!m_pMaterialAtlases[modelIdx] && MaterialAtlas::CanBuild(model))
+			m_pMaterialAtlases[modelIdx] = std::make_unique<const MaterialAtlas>(model, m_SpecularShininess);
+	}
+}
 
-Renderer::Renderer(SDL_Window* pWindow)
-	:m_pWindow(pWindow)
-	,m_pTexture{ Texture::LoadFromFile("Resources/vehicle_diffuse.png") }
-	,m_pNormalTexture(Texture::LoadFromFile("Resources/vehicle_normal.png"))
-	,m_pGlossinessTexture(Texture::LoadFromFile("Resources/vehicle_gloss.png"))
-	,m_pSpecularTexture(Texture::LoadFromFile("Resources/vehicle_specular.png"))
+void dae::Renderer::ToggleMaterialAtlas()
 {
-	//Initialize
-	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
-	InitializeBuffer(pWindow);
-	InitializeCamera();
-	InitializeMesh("Resources/vehicle.obj");
+	SetMaterialAtlas(!m_IsMaterialAtlas);
 }
 
-Renderer::~Renderer()
+bool dae::Renderer::IsMaterialAtlasActive() const
 {
-	delete m_pTexture;
-	delete m_pNormalTexture;
-	delete m_pGlossinessTexture;
-	delete m_pSpecularTexture;
+	return m_IsMaterialAtlas && m_RenderMode == RenderMode::Normal && m_LightingMode == LightingMode::Combined;
+}
 
-	SDL_FreeSurface(m_pFrontBuffer);
-	SDL_FreeSurface(m_pBackBuffer);
-	//delete[] m_pBackBufferPixels; // Where is it freed?
-	delete[] m_pDepthBufferPixels;
+void dae::Renderer::SetMultisampling(bool isEnabled)
+{
+	m_IsMultisampling = isEnabled;
+	if (isEnabled && !m_pSampleDepths)
+	{
+		//Room for the output size, like the other render target buffers
+		const int nrPixels{ m_OutputWidth * m_OutputHeight };
+		const int nrTiles{ ((m_OutputWidth + m_TileSize - 1) / m_TileSize) * ((m_OutputHeight + m_TileSize - 1) / m_TileSize) };
+		m_pSampleDepths = new float[static_cast<size_t>(nrPixels) * m_NrSamples];
+		m_pSampleColors = new uint32_t[static_cast<size_t>(nrPixels) * m_NrSamples];
+		m_pExpandedPixels = new uint8_t[nrPixels]{};
+		m_pExpandedTiles = new uint8_t[nrTiles]{};
+	}
+	ResetHistory();
+	Invalidate();
 }
 
-void Renderer::Update(Timer* pTimer)
+void dae::Renderer::ToggleMultisampling()
 {
-	m_Camera.Update(pTimer);
+	SetMultisampling(!m_IsMultisampling);
+}
 
-	if (m_IsMeshRotating)
+void dae::Renderer::SortVisibleInstances()
+{
+	if (!m_IsSortingDraws || m_NrVisibleInstances < 2)
+		return;
+
+	TRACE_ZONE("SortVisibleInstances");
+	const Matrix viewProjectionMatrix{ m_Camera.viewMatrix * m_Camera.projectionMatrix };
+	float* pDepths{ m_FrameArena.Allocate<float>(m_NrVisibleInstances) };
+	for (uint32_t visibleIdx{}; visibleIdx < m_NrVisibleInstances; ++visibleIdx)
 	{
-		const float meshRotationPerSecond{ 1.0f };
-		m_Mesh.Rotate(meshRotationPerSecond * pTimer->GetElapsed());
+		pDepths[visibleIdx] = GetNearestDepth(m_InstanceBvh.GetInstanceBounds(m_VisibleInstances[visibleIdx]), viewProjectionMatrix);
 	}
 
+	uint32_t* pOrder{ m_FrameArena.Allocate<uint32_t>(m_NrVisibleInstances) };
+	RadixSort::SortByDepth(pDepths, m_NrVisibleInstances, pOrder, m_FrameArena);
+
+	uint32_t* pSorted{ m_FrameArena.Allocate<uint32_t>(m_NrVisibleInstances) };
+	for (uint32_t visibleIdx{}; visibleIdx < m_NrVisibleInstances; ++visibleIdx)
+	{
+		pSorted[visibleIdx] = m_VisibleInstances[pOrder[visibleIdx]];
+	}
+	std::copy_n(pSorted, m_NrVisibleInstances, m_VisibleInstances.begin());
 }
 
-void Renderer::Render()
+float dae::Renderer::GetNearestDepth(const BoundingBox& box, const Matrix& toClip)
 {
-	ResetState();
+	//Clip w is linear in the position, the nearest corner is the center minus the half extent along its gradient
+	const Vector3 center{ box.GetCenter() };
+	const Vector3 halfExtent{ box.GetExtent() * 0.5f };
+	const float centerDepth{ toClip.TransformPoint(Vector4{ center.x, center.y, center.z, 1.f }).w };
+	return centerDepth - (std::abs(toClip[0].w) * halfExtent.x + std::abs(toClip[1].w) * halfExtent.y + std::abs(toClip[2].w) * halfExtent.z);
+}
+
+void dae::Renderer::BuildClusterDraws()
+{
+	TRACE_ZONE("BuildClusterDraws");
 
-	const Matrix worldViewProjectionMatrix{ m_Mesh.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix };
-	WorldToNDC(worldViewProjectionMatrix);
+	//Every cluster of every draw gets a slot, the visible ones are compacted afterwards
+	uint32_t* pFirstSlots{ m_FrameArena.Allocate<uint32_t>(m_NrDraws + 1) };
+	pFirstSlots[0] = 0;
+	for (uint32_t drawIdx{}; drawIdx < m_NrDraws; ++drawIdx)
+	{
+		pFirstSlots[drawIdx + 1] = pFirstSlots[drawIdx] + static_cast<uint32_t>(m_pDraws[drawIdx].pMesh->clusters.size());
+	}
+	ClusterDraw* pClusterDraws{ m_FrameArena.Allocate<ClusterDraw>(pFirstSlots[m_NrDraws]) };
+	uint32_t* pNrVisibleClusters{ m_FrameArena.Allocate<uint32_t>(m_NrDraws) };
+	float* pClusterDepths{ m_IsSortingDraws ? m_FrameArena.Allocate<float>(pFirstSlots[m_NrDraws]) : nullptr };
 
-	std::vector<Vector2> rasterVertices{};
-	NDCToRaster(rasterVertices);
+	const bool isOcclusionCulling{ IsOcclusionCullingActive() };
+	m_pJobSystem->ParallelFor(m_NrDraws, 16, [&](size_t begin, size_t end, int workerIdx)
+		{
+			TRACE_ZONE("BuildClusterDraws chunk");
+			PipelineStats& stats{ m_pWorkers[workerIdx].stats };
+			for (size_t drawIdx{ begin }; drawIdx < end; ++drawIdx)
+			{
+				const InstanceDraw& draw{ m_pDraws[drawIdx] };
+				const Matrix worldViewProjectionMatrix{ m_Scene.GetInstance(draw.instanceIndex).worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix };
+				//In object space, so the cluster boxes are tested as they are
+				const Frustum frustum{ Frustum::FromViewProjection(worldViewProjectionMatrix) };
+
+				ClusterDraw* pVisible{ pClusterDraws + pFirstSlots[drawIdx] };
+				uint32_t nrVisible{};
+				for (const MeshCluster& cluster : draw.pMesh->clusters)
+				{
+					uint32_t planeMask{ Frustum::allPlanesMask };
+					if (!frustum.Intersects(cluster.bounds, planeMask))
+					{
+						++stats.clustersCulledFrustum;
+						continue;
+					}
+
+					ScreenBounds bounds{};
+					if (isOcclusionCulling && !draw.isOccluder
+						&& OcclusionBuffer::ProjectBox(cluster.bounds, worldViewProjectionMatrix, m_Width, m_Height, bounds)
+						&& m_pOcclusionBuffer->IsOccluded(bounds))
+					{
+						++stats.clustersCulledOcclusion;
+						continue;
+					}
+
+					if (pClusterDepths)
+						pClusterDepths[pFirstSlots[drawIdx] + nrVisible] = GetNearestDepth(cluster.bounds, worldViewProjectionMatrix);
+					pVisible[nrVisible++] = ClusterDraw{ static_cast<uint32_t>(drawIdx), cluster.firstTriangle, cluster.nrTriangles, 0 };
+				}
+				pNrVisibleClusters[drawIdx] = nrVisible;
+			}
+		});
 
-	//Render on TopologyType
-	switch (m_Mesh.primitiveTopology)
+	//Compact in draw order
+	uint32_t nrClusterDraws{};
+	for (uint32_t drawIdx{}; drawIdx < m_NrDraws; ++drawIdx)
 	{
-	case PrimitiveTopology::TriangleList:
-		for (int VertexIndex{}; VertexIndex < m_Mesh.indices.size(); VertexIndex += 3)
+		for (uint32_t clusterIdx{ pFirstSlots[drawIdx] }; clusterIdx < pFirstSlots[drawIdx] + pNrVisibleClusters[drawIdx]; ++clusterIdx)
 		{
-			RenderTriangle(rasterVertices, VertexIndex, false);
-			//Don't render the mesh if its too far or too close (Frustum culling)
-			//const auto distance = (m_Mesh.vertices[VertexIndex].position - m_Camera.origin).SqrMagnitude();
-			//if (!(distance <= m_Camera.nearPlane || distance >= m_Camera.farPlane))
-			//{
-			//	RenderTriangle(rasterVertices, VertexIndex, false);
-			//}	
-		
+			if (pClusterDepths)
+				pClusterDepths[nrClusterDraws] = pClusterDepths[clusterIdx];
+			pClusterDraws[nrClusterDraws++] = pClusterDraws[clusterIdx];
 		}
-		break;
-	case PrimitiveTopology::TriangleStrip:
-		for (int VertexIndex{}; VertexIndex < m_Mesh.indices.size() - 2; ++VertexIndex)
+	}
+
+	//Front to back over all draws, the clusters of one instance can end up between those of another
+	if (pClusterDepths && nrClusterDraws > 1)
+	{
+		TRACE_ZONE("SortClusterDraws");
+		uint32_t* pOrder{ m_FrameArena.Allocate<uint32_t>(nrClusterDraws) };
+		RadixSort::SortByDepth(pClusterDepths, nrClusterDraws, pOrder, m_FrameArena);
+
+		ClusterDraw* pSorted{ m_FrameArena.Allocate<ClusterDraw>(nrClusterDraws) };
+		for (uint32_t clusterIdx{}; clusterIdx < nrClusterDraws; ++clusterIdx)
 		{
-			RenderTriangle(rasterVertices, VertexIndex, VertexIndex % 2);
-			//const auto distance = (m_Mesh.vertices[VertexIndex].position - m_Camera.origin).SqrMagnitude();
-			//if (!(distance <= m_Camera.nearPlane || distance >= m_Camera.farPlane))
-			//{
-			//	RenderTriangle(rasterVertices, VertexIndex, VertexIndex % 2);
-			//}
+			pSorted[clusterIdx] = pClusterDraws[pOrder[clusterIdx]];
 		}
-		break;
+		pClusterDraws = pSorted;
 	}
 
-	UpdateSDL();
+	//Number the triangles back to back in submission order
+	uint32_t nrTriangles{};
+	for (uint32_t clusterIdx{}; clusterIdx < nrClusterDraws; ++clusterIdx)
+	{
+		pClusterDraws[clusterIdx].firstSubmitted = nrTriangles;
+		nrTriangles += pClusterDraws[clusterIdx].nrTriangles;
+	}
+
+	m_pClusterDraws = pClusterDraws;
+	m_NrClusterDraws = nrClusterDraws;
+	m_NrTrianglesSubmitted = nrTriangles;
+	m_pWorkers[0].stats.clustersDrawn = nrClusterDraws;
 }
 
-void dae::Renderer::RenderTriangle(const std::vector<Vector2>& rasterVertices, int curVertexIdx, bool swapVertices) const
+void dae::Renderer::BuildInstanceDraws()
 {
-	const uint32_t vertIndex0{ m_Mesh.indices[curVertexIdx] };
-	const uint32_t vertIndex1{ m_Mesh.indices[curVertexIdx + 1 * !swapVertices + 2 * swapVertices] };
-	const uint32_t vertIndex2{ m_Mesh.indices[curVertexIdx + 2 * !swapVertices + 1 * swapVertices] };
+	m_pDraws = m_FrameArena.Allocate<InstanceDraw>(m_NrVisibleInstances);
+	m_NrDraws = m_NrVisibleInstances;
 
-	if (IsVertexSame(vertIndex0, vertIndex1, vertIndex2) || IsOutsideFrustum(vertIndex0, vertIndex1, vertIndex2)) return;
+	size_t nrVertices{};
+	uint64_t nrInstancesReducedLod{};
+	uint64_t nrTrianglesSavedLod{};
+	for (uint32_t drawIdx{}; drawIdx < m_NrDraws; ++drawIdx)
+	{
+		const uint32_t instanceIdx{ m_VisibleInstances[drawIdx] };
+		const uint32_t modelIndex{ m_Scene.GetInstance(instanceIdx).modelIndex };
+		const Model& model{ m_Scene.GetModel(modelIndex) };
+		const Mesh& mesh{ model.GetLod(m_InstanceLods[instanceIdx]) };
+
+		InstanceDraw& draw{ m_pDraws[drawIdx] };
+		draw.instanceIndex = instanceIdx;
+		draw.pModel = &model;
+		draw.pMesh = &mesh;
+		draw.firstVertex = static_cast<uint32_t>(nrVertices);
+		draw.isOccluder = IsOccluder(instanceIdx);
+		//Plain shading for a model without an atlas
+		draw.pMaterialAtlas = IsMaterialAtlasActive() && modelIndex < m_pMaterialAtlases.size() ? m_pMaterialAtlases[modelIndex].get() : nullptr;
+
+		nrVertices += GetPaddedVertexCount(mesh.nrVertices);
+		if (&mesh != &model.GetMesh())
+		{
+			++nrInstancesReducedLod;
+			nrTrianglesSavedLod += model.GetMesh().GetNrTriangles() - mesh.GetNrTriangles();
+		}
+	}
 
-	const Vector2 v0{ rasterVertices[vertIndex0] };
-	const Vector2 v1{ rasterVertices[vertIndex1] };
-	const Vector2 v2{ rasterVertices[vertIndex2] };
-	const Vector2 edge01{ v1 - v0 };
-	const Vector2 edge12{ v2 - v1 };
-	const Vector2 edge20{ v0 - v2 };
+	m_NrVerticesOut = nrVertices;
 
-	//Area
-	const float triangleArea{ Vector2::Cross(edge01, edge12) };
-	if (triangleArea < FLT_EPSILON) return;
+	PipelineStats& stats{ m_pWorkers[0].stats };
+	stats.instancesReducedLod = nrInstancesReducedLod;
+	stats.trianglesSavedLod = nrTrianglesSavedLod;
+	stats.instancesDrawn = m_NrDraws;
+	stats.instancesCulledFrustum = m_NrInstancesCulledFrustum;
+	stats.instancesCulledOcclusion = m_NrInstancesCulledOcclusion;
+}
 
-	//BoundingBox
-	int startingX, StartingY, endingX, endingY;
-	CalculateBoundingBox(v0, v1, v2, startingX, StartingY, endingX, endingY);
+void dae::Renderer::SetInstanceGrid(int nrInstances)
+{
+	const Matrix origin{ m_Scene.GetInstance(0).worldMatrix };
+	const Mesh& mesh{ m_Scene.GetModel(0).GetMesh() };
+	const Vector3 extent{ mesh.bounds.GetExtent() };
+
+	//A quarter of the mesh size as gap between neighbours
+	m_Scene.ClearInstances();
+	m_Scene.AddInstanceGrid(0, nrInstances, origin, 1.25f * std::max(extent.x, extent.z));
+	ResetHistory();
+}
 
+void dae::Renderer::SetLocalLights(int nrLights)
+{
+	assert(nrLights >= 0);
+	std::vector<Light> directionalLights{};
+	for (uint32_t lightIdx{}; lightIdx < m_Scene.GetNrLights(); ++lightIdx)
+	{
+		if (m_Scene.GetLight(lightIdx).type == LightType::Directional)
+			directionalLights.emplace_back(m_Scene.GetLight(lightIdx));
+	}
+	m_Scene.ClearLights();
+	for (const Light& light : directionalLights)
+	{
+		m_Scene.AddLight(light);
+	}
+	ResetHistory();
+	if (nrLights == 0)
+		return;
 
-	for (int py{ StartingY }; py < endingY; ++py)
+	BoundingBox bounds{};
+	for (uint32_t instanceIdx{}; instanceIdx < m_Scene.GetNrInstances(); ++instanceIdx)
 	{
-		for (int px{ startingX }; px < endingX; ++px)
+		const Instance& instance{ m_Scene.GetInstance(instanceIdx) };
+		bounds.Grow(m_Scene.GetModel(instance.modelIndex).GetMesh().bounds.Transform(instance.worldMatrix));
+	}
+	const Vector3 extent{ bounds.GetExtent() };
+
+	//One light per cell of a grid over the top of the instances, reaching about a cell past its own
+	const int nrColumns{ static_cast<int>(std::ceil(std::sqrt(static_cast<float>(nrLights)))) };
+	const int nrRows{ (nrLights + nrColumns - 1) / nrColumns };
+	const float cellWidth{ extent.x / static_cast<float>(nrColumns) };
+	const float cellDepth{ extent.z / static_cast<float>(nrRows) };
+	const float range{ 2.f * std::max({ cellWidth, cellDepth, 0.25f * extent.y }) };
+	const ColorRGB palette[]{ colors::Red, colors::Green, colors::Blue, colors::Yellow, colors::Cyan, colors::Magenta };
+	for (int lightNr{}; lightNr < nrLights; ++lightNr)
+	{
+		Light light{};
+		light.position = Vector3{
+			bounds.min.x + (static_cast<float>(lightNr % nrColumns) + 0.5f) * cellWidth,
+			bounds.max.y,
+			bounds.min.z + (static_cast<float>(lightNr / nrColumns) + 0.5f) * cellDepth };
+		light.color = palette[lightNr % std::size(palette)];
+		light.range = range;
+		//About the intensity of the sun halfway to the range
+		light.intensity = 0.25f * range * range;
+		if (lightNr % 3 == 2)
 		{
-			// Calculate the pixel index and create a Vector2 of the current pixel
-			const int pixelIdx{ px + py * m_Width };
-			const Vector2 curPixel{ static_cast<float>(px), static_cast<float>(py) };
-
-			if (m_RenderMode == RenderMode::BoundingBox)
-			{
-				RenderBoundingBox(pixelIdx);
-				continue;
-			}
-
-			//VertexToPoint
-			const Vector2 v0ToPoint{ curPixel - v0 };
-			const Vector2 v1ToPoint{ curPixel - v1 };
-			const Vector2 v2ToPoint{ curPixel - v2 };
-			const float edge01Point{ Vector2::Cross(edge01, v0ToPoint) };
-			const float edge12Point{ Vector2::Cross(edge12, v1ToPoint) };
-			const float edge20Point{ Vector2::Cross(edge20, v2ToPoint) };
-			if (!IsInsideTriangle(edge01Point, edge12Point, edge20Point)) continue;
+			light.type = LightType::Spot;
+			light.direction = -Vector3::UnitY;
+			light.range = 1.5f * range;
+		}
+		m_Scene.AddLight(light);
+	}
+}
 
-			// Barycentric weights
-			const float weightV0{ edge12Point / triangleArea };
-			const float weightV1{ edge20Point / triangleArea };
-			const float weightV2{ edge01Point / triangleArea };
+int dae::Renderer::GetNrLocalLights() const
+{
+	int nrLights{};
+	for (uint32_t lightIdx{}; lightIdx < m_Scene.GetNrLights(); ++lightIdx)
+	{
+		nrLights += m_Scene.GetLight(lightIdx).type != LightType::Directional;
+	}
+	return nrLights;
+}
 
-			// Calculate the Z depth at this pixel
-			const float interpolatedZDepth
-			{
-				1.0f / (weightV0 / m_Mesh.vertices_out[vertIndex0].position.z +
-						weightV1 / m_Mesh.vertices_out[vertIndex1].position.z +
-						weightV2 / m_Mesh.vertices_out[vertIndex2].position.z)
-			};
-			if (IsCurrentDepthBufferLessThenDepth(pixelIdx, interpolatedZDepth)) continue;
-			m_pDepthBufferPixels[pixelIdx] = interpolatedZDepth;
+void dae::Renderer::ToggleLocalLights()
+{
+	SetLocalLights(GetNrLocalLights() > 0 ? 0 : m_ViewerLocalLights);
+}
 
+size_t dae::Renderer::GetSourceVertexBytes() const
+{
+	size_t nrBytes{};
+	for (uint32_t modelIdx{}; modelIdx < m_Scene.GetNrModels(); ++modelIdx)
+	{
+		const Model& model{ m_Scene.GetModel(modelIdx) };
+		for (size_t lod{}; lod < model.GetNrLods(); ++lod)
+		{
+			nrBytes += model.GetLod(lod).GetVertexByteSize();
+		}
+	}
+	return nrBytes;
+}
 
-			Vertex_Out pixelInfo{};
+void dae::Renderer::ResetState()
+{
+	TRACE_ZONE("Clear");
+	ResetDepthBuffer();
+	ClearBackground();
+	if (IsTrackingOverdraw())
+	{
+		std::fill_n(m_pShadeCountPixels, m_Width * m_Height, uint8_t{});
+	}
+	SDL_LockSurface(m_pBackBuffer);
 
-			// Switch between all the render states
-			switch (m_RenderMode)
-			{
-			case RenderMode::Normal:
-			{
-				// Calculate the W depth
-				const float interpolatedWDepth
-				{
-					1.0f /
-						(weightV0 / m_Mesh.vertices_out[vertIndex0].position.w +
-						weightV1 / m_Mesh.vertices_out[vertIndex1].position.w +
-						weightV2 / m_Mesh.vertices_out[vertIndex2].position.w)
-				};
-				CalculatePixelInfo(pixelInfo, weightV0, weightV1, weightV2, vertIndex0, vertIndex1, vertIndex2, interpolatedWDepth);
-				break;
-			}
-			case RenderMode::DepthBuffer:
-			{
-				float depthColor;
-				RemapZDepth(interpolatedZDepth, depthColor);
-				pixelInfo.color = { depthColor, depthColor, depthColor };
-				break;
-			}
-			}
+	//Everything transient of the last frame goes at once, nothing below touches the heap once the arenas are warm
+	m_FrameArena.Reset();
+	//Any worker may pick up any share of the work, so every arena gets the room the largest one needed
+	size_t workerCapacity{};
+	for (int workerIdx{}; workerIdx < GetNrWorkers(); ++workerIdx)
+	{
+		m_pWorkers[workerIdx].arena.Reset();
+		workerCapacity = std::max(workerCapacity, m_pWorkers[workerIdx].arena.GetCapacity());
+	}
+	for (int workerIdx{}; workerIdx < GetNrWorkers(); ++workerIdx)
+	{
+		WorkerContext& worker{ m_pWorkers[workerIdx] };
+		worker.arena.Reserve(workerCapacity);
+		worker.pFragments = worker.arena.Allocate<Fragment>(m_FragmentBatchSize);
+		worker.nrFragments = 0;
+		//Triangle indices start over every frame, no shade of the last one may be found again
+		worker.pCoarseShades = worker.arena.Allocate<CoarseShade>(m_CoarseBlocksPerTile * m_CoarseBlocksPerTile);
+		std::fill_n(worker.pCoarseShades, m_CoarseBlocksPerTile * m_CoarseBlocksPerTile, CoarseShade{});
+	}
+}
 
-			Shade(pixelIdx, pixelInfo);
+void dae::Renderer::UpdateMesh(float elapsedSec)
+{
+	if (m_IsMeshRotating)
+	{
+		const float meshRotationPerSecond{ 1.0f };
+		if (elapsedSec != 0.f)
+		{
+			m_Scene.TransformInstances(Matrix::CreateRotationY(meshRotationPerSecond * elapsedSec));
 		}
+		m_MeshYaw += meshRotationPerSecond * elapsedSec;
 	}
 }
 
-void dae::Renderer::ClearBackground() const
+CameraKey dae::Renderer::GetCameraKey() const
 {
-	SDL_FillRect(m_pBackBuffer, NULL, SDL_MapRGB(m_pBackBuffer->format, 100, 100, 100));
+	return CameraKey{ m_Camera.origin, m_Camera.totalPitch, m_Camera.totalYaw, m_MeshYaw };
 }
 
-void dae::Renderer::ResetDepthBuffer() const
+void dae::Renderer::ApplyCameraKey(const CameraKey& key)
 {
-	const int nrPixels{ m_Width * m_Height };
-	std::fill_n(m_pDepthBufferPixels, nrPixels, FLT_MAX);
+	m_Camera.origin = key.origin;
+	m_Camera.totalPitch = key.pitch;
+	m_Camera.totalYaw = key.yaw;
+
+	//The instances only ever rotate around their local Y axis, so apply the difference
+	if (key.meshYaw != m_MeshYaw)
+	{
+		m_Scene.TransformInstances(Matrix::CreateRotationY(key.meshYaw - m_MeshYaw));
+		m_MeshYaw = key.meshYaw;
+	}
 }
 
-void dae::Renderer::Shade(int pixelIndex,Vertex_Out pxlInfo) const
+void dae::Renderer::ReserveVertexOutput()
 {
-	Vector3 normal{ pxlInfo.normal };
-
-	ColorRGB finalColor{};
+	size_t nrVertices{};
+	for (uint32_t instanceIdx{}; instanceIdx < m_Scene.GetNrInstances(); ++instanceIdx)
+	{
+		nrVertices += GetPaddedVertexCount(m_Scene.GetModel(m_Scene.GetInstance(instanceIdx).modelIndex).GetMesh().nrVertices);
+	}
 
-	const Vector3 lightDirection{ Vector3(0.577f, -0.577f, 0.577f).Normalized() };
-	constexpr float lightIntensity{ 7.0f };
-	constexpr float specularShininess{ 25.0f };
+	if (m_Scene.GetVertexFormat() == VertexFormat::Compact)
+		m_CompactVerticesOut.Reserve(nrVertices);
+	else
+		m_VerticesOut.Reserve(nrVertices);
+	m_ReservedSceneVersion = m_Scene.GetVersion();
+}
 
-	if (m_pNormalTexture != nullptr && m_IsNormalActive)
+void dae::Renderer::TransformVertices()
+{
+	TRACE_ZONE("TransformVertices");
+	if (m_Scene.GetVersion() != m_ReservedSceneVersion)
 	{
-		const Vector3 binormal = Vector3::Cross(pxlInfo.normal, pxlInfo.tangent);
-		const Matrix tangentSpaceAxis = Matrix{ pxlInfo.tangent, binormal, pxlInfo.normal, Vector3::Zero };
-
-		//Clamp uv between -1 and 1;
-		const ColorRGB currentNormalMap{ 2.0f * m_pNormalTexture->Sample(pxlInfo.uv) - ColorRGB{ 1.0f, 1.0f, 1.0f } };
-		
-		const Vector3 normalMapSample{ currentNormalMap.r, currentNormalMap.g, currentNormalMap.b };
-		normal = tangentSpaceAxis.TransformVector(normalMapSample);
+		ReserveVertexOutput();
 	}
 
-	switch (m_RenderMode)
-	{
-	case RenderMode::Normal:
-	{
-		const float observedArea{ std::max(Vector3::Dot(normal.Normalized(), -lightDirection.Normalized()), 0.0f) };
-			
-		switch (m_LightingMode)
-		{
-		case LightingMode::Combined:
+	const bool isCompact{ m_Scene.GetVertexFormat() == VertexFormat::Compact };
+	if (isCompact)
+		m_CompactVerticesOut.Resize(m_NrVerticesOut);
+	else
+		m_VerticesOut.Resize(m_NrVerticesOut);
+
+	const VertexBlockTransform* pTransforms{ TransformInstances() };
+
+	//The chunk size is a multiple of the block size and every instance starts on a whole block,
+	//so a chunk holds whole blocks of one or more instances
+	static_assert(m_VertexChunkSize % VertexBlockSize == 0);
+	m_pJobSystem->ParallelFor(m_NrVerticesOut, m_VertexChunkSize, [this, pTransforms, isCompact](size_t begin, size_t end, int workerIdx)
 		{
+			TRACE_ZONE("TransformVertices chunk");
+			const InstanceDraw* pDrawsEnd{ m_pDraws + m_NrDraws };
+			const InstanceDraw* pDraw{ std::upper_bound(static_cast<const InstanceDraw*>(m_pDraws), pDrawsEnd, static_cast<uint32_t>(begin),
+				[](uint32_t vertexNr, const InstanceDraw& draw) { return vertexNr < draw.firstVertex; }) - 1 };
 
-			if (!m_pGlossinessTexture || !m_pSpecularTexture)
+			size_t vertexNr{ begin };
+			for (; pDraw != pDrawsEnd && vertexNr < end; ++pDraw)
 			{
-				assert(false);
+				const Mesh& mesh{ *pDraw->pMesh };
+				const size_t drawEnd{ std::min(end, pDraw->firstVertex + GetPaddedVertexCount(mesh.nrVertices)) };
+				const VertexBlockTransform& transform{ pTransforms[pDraw - m_pDraws] };
+				if (isCompact)
+					TransformCompactVertexBlocks(transform, mesh, vertexNr - pDraw->firstVertex, drawEnd - pDraw->firstVertex, pDraw->firstVertex);
+				else
+					TransformVertexBlocks(transform, mesh, vertexNr - pDraw->firstVertex, drawEnd - pDraw->firstVertex, pDraw->firstVertex);
+
+				m_pWorkers[workerIdx].stats.verticesTransformed += std::min(drawEnd - pDraw->firstVertex, mesh.nrVertices) -
+					std::min(vertexNr - pDraw->firstVertex, mesh.nrVertices);
+				vertexNr = drawEnd;
 			}
+		});
+}
 
-			// cd * (kd) / PI
-			const ColorRGB lambert{ m_pTexture->Sample(pxlInfo.uv) / PI };
+const dae::Renderer::VertexBlockTransform* dae::Renderer::TransformInstances()
+{
+	TRACE_ZONE("TransformInstances");
+	VertexBlockTransform* pTransforms{ m_FrameArena.Allocate<VertexBlockTransform>(m_NrDraws) };
 
-			const float phongExponent{ specularShininess * m_pGlossinessTexture->Sample(pxlInfo.uv).r };
-			const ColorRGB specular{ m_pSpecularTexture->Sample(pxlInfo.uv) * CalculatePhong(phongExponent, -lightDirection, pxlInfo.viewDirection, normal) };
+	for (uint32_t drawIdx{}; drawIdx < m_NrDraws; ++drawIdx)
+	{
+		const Matrix& worldMatrix{ m_Scene.GetInstance(m_pDraws[drawIdx].instanceIndex).worldMatrix };
+		const Matrix worldViewProjectionMatrix{ worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix };
+		new (&pTransforms[drawIdx]) VertexBlockTransform{ worldViewProjectionMatrix, worldMatrix, m_Width, m_Height };
+	}
+	return pTransforms;
+}
 
-			finalColor += (lightIntensity * lambert + specular) * observedArea;
-			break;
-		}
-		case LightingMode::ObservedArea:
-		{
-			finalColor += ColorRGB{ observedArea, observedArea, observedArea };
-			break;
-		}
-		case LightingMode::Diffuse:
-		{
-			// cd * (kd) / PI
-			const ColorRGB lambert{ m_pTexture->Sample(pxlInfo.uv) / PI };
-			finalColor += ColorRGB(lightIntensity * observedArea * lambert);
-			break;
-		}
-		case LightingMode::Specular:
+dae::Renderer::VertexBlockTransform::VertexBlockTransform(const Matrix& worldViewProjectionMatrix, const Matrix& worldMatrix, int width, int height)
+	:width{ Simd::Float8::Set(static_cast<float>(width)) }
+	,height{ Simd::Float8::Set(static_cast<float>(height)) }
+{
+	for (int row{}; row < 4; ++row)
+	{
+		for (int column{}; column < 4; ++column)
 		{
-			const float phongExponent{ specularShininess * m_pGlossinessTexture->Sample(pxlInfo.uv).r };
-			const ColorRGB specular{ m_pSpecularTexture->Sample(pxlInfo.uv) * CalculatePhong(phongExponent, -lightDirection, pxlInfo.viewDirection, normal) };
-			finalColor += specular * observedArea;
-			break;
-		}
+			worldViewProjection[row][column] = Simd::Float8::Set(worldViewProjectionMatrix[row][column]);
 		}
-		break;
 	}
-	case RenderMode::DepthBuffer:
+	for (int row{}; row < 3; ++row)
 	{
-			//Depthbuffer is stored in pxlinfo.color
-		finalColor += pxlInfo.color;
-		break;
-	}
+		for (int column{}; column < 3; ++column)
+		{
+			world[row][column] = Simd::Float8::Set(worldMatrix[row][column]);
+		}
 	}
-
-	//Update Color in Buffer
-	finalColor.MaxToOne();
-
-	m_pBackBufferPixels[pixelIndex] = SDL_MapRGB(m_pBackBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
 }
 
-void dae::Renderer::InitializeBuffer(SDL_Window* pWindow)
+void dae::Renderer::VertexBlockTransform::TransformPosition(const Simd::Float8& x, const Simd::Float8& y, const Simd::Float8& z, Simd::Float8 (&clip)[4]) const
 {
-	m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
-	m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
-	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
-	m_pDepthBufferPixels = new float[m_Width * m_Height];
-	ResetDepthBuffer();
+	const auto& m{ worldViewProjection };
+	for (int column{}; column < 4; ++column)
+	{
+		clip[column] = m[0][column] * x + m[1][column] * y + m[2][column] * z + m[3][column];
+	}
 }
 
-void dae::Renderer::InitializeCamera()
+void dae::Renderer::VertexBlockTransform::ProjectPosition(const Simd::Float8 (&clip)[4], float* pNdcX, float* pNdcY, float* pNdcZ, float* pW, float* pRasterX, float* pRasterY) const
 {
-	m_AspectRatio = (float)m_Width / (float)m_Height;
-	m_Camera.Initialize(60.f, { .0f,.0f,-10.f }, m_AspectRatio);
+	using Simd::Float8;
+	const Float8 one{ Float8::Set(1.f) };
+	const Float8 two{ Float8::Set(2.f) };
+
+	// Divide positions by old z (stored in w)
+	const Float8 ndcX{ clip[0] / clip[3] };
+	const Float8 ndcY{ clip[1] / clip[3] };
+	ndcX.Store(pNdcX);
+	ndcY.Store(pNdcY);
+	(clip[2] / clip[3]).Store(pNdcZ);
+	clip[3].Store(pW);
+
+	//Viewport
+	((ndcX + one) / two * width).Store(pRasterX);
+	((one - ndcY) / two * height).Store(pRasterY);
 }
 
-void dae::Renderer::InitializeMesh(const char* filename)
+void dae::Renderer::VertexBlockTransform::TransformDirection(const Simd::Float8& x, const Simd::Float8& y, const Simd::Float8& z, float* pX, float* pY, float* pZ) const
 {
-	bool isObjLoaded{ Utils::ParseOBJ(filename, m_Mesh.vertices, m_Mesh.indices) };
-	assert(isObjLoaded);
-
-	const Vector3 translation{ m_Camera.origin + Vector3{ 0.0f, -10.0f, 30.0f } };
-	const Vector3 rotation{ };
-	const Vector3 scale{ Vector3{ 1.0f, 1.0f, 1.0f } };
-	m_Mesh.worldMatrix = Matrix::CreateScale(scale) * Matrix::CreateRotation(rotation) * Matrix::CreateTranslation(translation);
+	const auto& m{ world };
+	(m[0][0] * x + m[1][0] * y + m[2][0] * z).Store(pX);
+	(m[0][1] * x + m[1][1] * y + m[2][1] * z).Store(pY);
+	(m[0][2] * x + m[1][2] * y + m[2][2] * z).Store(pZ);
 }
 
-void dae::Renderer::ResetState()
+void dae::Renderer::TransformVertexBlocks(const VertexBlockTransform& transform, const Mesh& mesh, size_t firstVertex, size_t endVertex, size_t outOffset)
 {
-	m_Mesh.vertices_out.clear();
-	ResetDepthBuffer();
-	ClearBackground();
-	SDL_LockSurface(m_pBackBuffer);
-}
+	//Transform, perspective divide, viewport mapping and normal/tangent transform fused into one pass,
+	//8 vertices per iteration. Every lane computes exactly what the scalar code would, in the same order
+	using Simd::Float8;
+	const MeshStreams& in{ mesh.streams };
+	VertexStreams& out{ m_VerticesOut };
 
-void dae::Renderer::WorldToNDC(const Matrix& worldViewProjectionMatrix)
-{
-	m_Mesh.vertices_out.reserve(m_Mesh.vertices.size());
-	for (const Vertex& vertex : m_Mesh.vertices)
+	for (size_t i{ firstVertex }; i < endVertex; i += Float8::laneCount)
 	{
-		Vertex_Out vOut{ {}, vertex.color, vertex.uv, vertex.normal, vertex.tangent };
+		const size_t o{ i + outOffset };
 
-		//Transform
-		vOut.position = worldViewProjectionMatrix.TransformPoint({ vertex.position, 1.0f });
-		vOut.normal = m_Mesh.worldMatrix.TransformVector(vertex.normal);
-		vOut.tangent = m_Mesh.worldMatrix.TransformVector(vertex.tangent);
+		//Position
+		Float8 clip[4]{};
+		transform.TransformPosition(Float8::Load(&in.positionX[i]), Float8::Load(&in.positionY[i]), Float8::Load(&in.positionZ[i]), clip);
 
-		vOut.viewDirection = Vector3{ vOut.position.x, vOut.position.y, vOut.position.z };
-		vOut.viewDirection.Normalize();
+		const Float8 magnitude{ Float8::Sqrt(clip[0] * clip[0] + clip[1] * clip[1] + clip[2] * clip[2]) };
+		(clip[0] / magnitude).Store(&out.viewDirectionX[o]);
+		(clip[1] / magnitude).Store(&out.viewDirectionY[o]);
+		(clip[2] / magnitude).Store(&out.viewDirectionZ[o]);
 
-		// Divide positions by old z (stored in w)
-		vOut.position.x /= vOut.position.w;
-		vOut.position.y /= vOut.position.w;
-		vOut.position.z /= vOut.position.w;
+		transform.ProjectPosition(clip, &out.positionX[o], &out.positionY[o], &out.positionZ[o], &out.positionW[o], &out.rasterX[o], &out.rasterY[o]);
 
-		m_Mesh.vertices_out.emplace_back(vOut);
+		//Normal and tangent, world space
+		transform.TransformDirection(Float8::Load(&in.normalX[i]), Float8::Load(&in.normalY[i]), Float8::Load(&in.normalZ[i]),
+			&out.normalX[o], &out.normalY[o], &out.normalZ[o]);
+		transform.TransformDirection(Float8::Load(&in.tangentX[i]), Float8::Load(&in.tangentY[i]), Float8::Load(&in.tangentZ[i]),
+			&out.tangentX[o], &out.tangentY[o], &out.tangentZ[o]);
 	}
 }
 
-void dae::Renderer::NDCToRaster(std::vector<Vector2>& rasterVertices) const
+void dae::Renderer::TransformCompactVertexBlocks(const VertexBlockTransform& transform, const Mesh& mesh, size_t firstVertex, size_t endVertex, size_t outOffset)
 {
-	rasterVertices.clear();
-	rasterVertices.reserve(m_Mesh.vertices_out.size());
+	//Same pass as TransformVertexBlocks, the packed normals and tangents are decoded per lane before and encoded after
+	//the transform. The view direction is not stored, setup rebuilds it from the position
+	using Simd::Float8;
+	using namespace VertexPacking;
+	const CompactMeshStreams& in{ mesh.compactStreams };
+	CompactVertexStreams& out{ m_CompactVerticesOut };
+
+	constexpr int laneCount{ Float8::laneCount };
+	const auto transformPacked = [&transform](const uint32_t* pIn, uint32_t* pOut)
+	{
+		float x[laneCount]{}, y[laneCount]{}, z[laneCount]{};
+		for (int lane{}; lane < laneCount; ++lane)
+		{
+			const Vector3 direction{ DecodeOctahedral(pIn[lane]) };
+			x[lane] = direction.x;
+			y[lane] = direction.y;
+			z[lane] = direction.z;
+		}
+
+		transform.TransformDirection(Float8::Load(x), Float8::Load(y), Float8::Load(z), x, y, z);
+
+		for (int lane{}; lane < laneCount; ++lane)
+		{
+			pOut[lane] = EncodeOctahedral({ x[lane], y[lane], z[lane] });
+		}
+	};
 
-	for (const auto& ndcVertex : m_Mesh.vertices_out)
+	for (size_t i{ firstVertex }; i < endVertex; i += laneCount)
 	{
-		rasterVertices.emplace_back((ndcVertex.position.x + 1) / 2.0f * m_Width
-			, (1.0f - ndcVertex.position.y) / 2.0f * m_Height);
+		const size_t o{ i + outOffset };
+		Float8 clip[4]{};
+		transform.TransformPosition(Float8::Load(&in.positionX[i]), Float8::Load(&in.positionY[i]), Float8::Load(&in.positionZ[i]), clip);
+		transform.ProjectPosition(clip, &out.positionX[o], &out.positionY[o], &out.positionZ[o], &out.positionW[o], &out.rasterX[o], &out.rasterY[o]);
+
+		transformPacked(&in.normal[i], &out.normal[o]);
+		transformPacked(&in.tangent[i], &out.tangent[o]);
 	}
 }
 
 void dae::Renderer::UpdateSDL() const
 {
+	TRACE_ZONE("Present");
 	SDL_UnlockSurface(m_pBackBuffer);
+	if (!m_pWindow) return;
+
 	SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
 	SDL_UpdateWindowSurface(m_pWindow);
 }
 
+float dae::Renderer::Lap(uint64_t& lapCounter) const
+{
+	const uint64_t currentCounter{ SDL_GetPerformanceCounter() };
+	const float elapsedMs{ static_cast<float>(currentCounter - lapCounter) * m_MsPerCount };
+	lapCounter = currentCounter;
+
+	return elapsedMs;
+}
+
+bool dae::Renderer::IsTrackingOverdraw() const
+{
+	return m_IsTrackingOverdraw || m_RenderMode == RenderMode::Overdraw;
+}
+
 bool dae::Renderer::IsVertexSame(uint32_t vertex0, uint32_t vertex1, uint32_t vertex2) const
 {
 	return vertex0 == vertex1 || vertex1 == vertex2 || vertex0 == vertex2;
@@ -370,9 +2907,20 @@ bool dae::Renderer::IsVertexSame(uint32_t vertex0, uint32_t vertex1, uint32_t ve
 
 bool dae::Renderer::IsOutsideFrustum(uint32_t vertex0, uint32_t vertex1, uint32_t vertex2) const
 {
-	return m_Camera.IsOutsideFrustum(m_Mesh.vertices_out[vertex0].position) ||
-		m_Camera.IsOutsideFrustum(m_Mesh.vertices_out[vertex1].position) ||
-		m_Camera.IsOutsideFrustum(m_Mesh.vertices_out[vertex2].position);
+	if (m_Scene.GetVertexFormat() == VertexFormat::Compact)
+	{
+		return m_Camera.IsOutsideFrustum(m_CompactVerticesOut.GetPosition(vertex0)) ||
+			m_Camera.IsOutsideFrustum(m_CompactVerticesOut.GetPosition(vertex1)) ||
+			m_Camera.IsOutsideFrustum(m_CompactVerticesOut.GetPosition(vertex2));
+	}
+	return m_Camera.IsOutsideFrustum(m_VerticesOut.GetPosition(vertex0)) ||
+		m_Camera.IsOutsideFrustum(m_VerticesOut.GetPosition(vertex1)) ||
+		m_Camera.IsOutsideFrustum(m_VerticesOut.GetPosition(vertex2));
+}
+
+Vector2 dae::Renderer::GetRasterPosition(uint32_t vertex) const
+{
+	return m_Scene.GetVertexFormat() == VertexFormat::Compact ? m_CompactVerticesOut.GetRaster(vertex) : m_VerticesOut.GetRaster(vertex);
 
 }
 
@@ -381,7 +2929,8 @@ void dae::Renderer::CalculateBoundingBox(const Vector2& v0, const Vector2& v1, c
 	// Calculate the bounding box of this triangle
 	const Vector2 minBoundingBox{ Vector2::Min(v0, Vector2::Min(v1, v2)) };
 	const Vector2 maxBoundingBox{ Vector2::Max(v0, Vector2::Max(v1, v2)) };
-	constexpr int margin{ 1 };
+	//Samples lie up to m_MaxSampleOffset from the pixel centers, one more pixel keeps those inside the box
+	const int margin{ IsMultisamplingActive() ? 2 : 1 };
 
 	startingX = { std::clamp(static_cast<int>(minBoundingBox.x - margin), 0, m_Width) };
 	StartingY = { std::clamp(static_cast<int>(minBoundingBox.y - margin), 0, m_Height) };
@@ -391,7 +2940,7 @@ void dae::Renderer::CalculateBoundingBox(const Vector2& v0, const Vector2& v1, c
 
 void dae::Renderer::RenderBoundingBox(const int pixelIndex) const
 {
-	m_pBackBufferPixels[pixelIndex] = SDL_MapRGB(m_pBackBuffer->format,
+	m_pRenderPixels[pixelIndex] = SDL_MapRGB(m_pBackBuffer->format,
 		static_cast<uint8_t>(255),
 		static_cast<uint8_t>(255),
 		static_cast<uint8_t>(255));
@@ -407,31 +2956,32 @@ bool dae::Renderer::IsCurrentDepthBufferLessThenDepth(const int pixelIndex, cons
 	return m_pDepthBufferPixels[pixelIndex] < ZDepth;
 }
 
-void dae::Renderer::CalculatePixelInfo(Vertex_Out& pixelInfo, float weightV0, float weightV1,float weightV2, uint32_t vertIndex0, uint32_t vertIndex1, uint32_t vertIndex2, float wDepth) const
+void dae::Renderer::CalculatePixelInfo(Vertex_Out& pixelInfo, const TriangleSetup& triangle, float x, float y) const
 {
+	// Calculate the W depth
+	const float wDepth{ 1.0f / triangle.invW.Evaluate(x, y) };
+
 	pixelInfo.uv = Vector2{
-		(weightV0 * m_Mesh.vertices_out[vertIndex0].uv / m_Mesh.vertices_out[vertIndex0].position.w +
-		weightV1 * m_Mesh.vertices_out[vertIndex1].uv / m_Mesh.vertices_out[vertIndex1].position.w +
-		weightV2 * m_Mesh.vertices_out[vertIndex2].uv / m_Mesh.vertices_out[vertIndex2].position.w)
-		* wDepth};
+		triangle.uvOverW[0].Evaluate(x, y),
+		triangle.uvOverW[1].Evaluate(x, y) } * wDepth;
 
+	//Normalized anyway, so the vectors skip the multiplication by w
 	pixelInfo.normal = Vector3{
-		(weightV0 * m_Mesh.vertices_out[vertIndex0].normal / m_Mesh.vertices_out[vertIndex0].position.w +
-		weightV1 * m_Mesh.vertices_out[vertIndex1].normal / m_Mesh.vertices_out[vertIndex1].position.w +
-		weightV2 * m_Mesh.vertices_out[vertIndex2].normal / m_Mesh.vertices_out[vertIndex2].position.w)
-		* wDepth}.Normalized();
+		triangle.normalOverW[0].Evaluate(x, y),
+		triangle.normalOverW[1].Evaluate(x, y),
+		triangle.normalOverW[2].Evaluate(x, y) }.Normalized();
 
 	pixelInfo.tangent = Vector3{
-		(weightV0 * m_Mesh.vertices_out[vertIndex0].tangent / m_Mesh.vertices_out[vertIndex0].position.w +
-		weightV1 * m_Mesh.vertices_out[vertIndex1].tangent / m_Mesh.vertices_out[vertIndex1].position.w +
-		weightV2 * m_Mesh.vertices_out[vertIndex2].tangent / m_Mesh.vertices_out[vertIndex2].position.w)
-		* wDepth}.Normalized();
+		triangle.tangentOverW[0].Evaluate(x, y),
+		triangle.tangentOverW[1].Evaluate(x, y),
+		triangle.tangentOverW[2].Evaluate(x, y) }.Normalized();
 
 	pixelInfo.viewDirection = Vector3{
-		(weightV0 * m_Mesh.vertices_out[vertIndex0].viewDirection / m_Mesh.vertices_out[vertIndex0].position.w +
-		weightV1 * m_Mesh.vertices_out[vertIndex1].viewDirection / m_Mesh.vertices_out[vertIndex1].position.w +
-		weightV2 * m_Mesh.vertices_out[vertIndex2].viewDirection / m_Mesh.vertices_out[vertIndex2].position.w)
-		* wDepth}.Normalized();
+		triangle.viewDirectionOverW[0].Evaluate(x, y),
+		triangle.viewDirectionOverW[1].Evaluate(x, y),
+		triangle.viewDirectionOverW[2].Evaluate(x, y) }.Normalized();
+
+	pixelInfo.worldPosition = m_Camera.origin + (m_PixelRay + m_PixelRayStepX * x + m_PixelRayStepY * y) * wDepth;
 }
 
 void dae::Renderer::RemapZDepth(float interpolatedZDepth,float& depthColor) const
@@ -452,11 +3002,54 @@ ColorRGB dae::Renderer::CalculatePhong(const float exponent, const Vector3& ligh
 	return ColorRGB{ phong, phong, phong };
 }
 
+void dae::Renderer::SetNrWorkers(int nrWorkers, bool isPinningWorkers)
+{
+	delete m_pJobSystem;
+	m_pJobSystem = new JobSystem{ nrWorkers, isPinningWorkers };
+
+	m_pWorkers = std::make_unique<WorkerContext[]>(m_pJobSystem->GetNrWorkers());
+}
+
+int dae::Renderer::GetNrWorkers() const
+{
+	return m_pJobSystem->GetNrWorkers();
+}
+
 bool Renderer::SaveBufferToImage() const
 {
 	return SDL_SaveBMP(m_pBackBuffer, "Rasterizer_ColorBuffer.bmp");
 }
 
+bool Renderer::SaveBufferToFile(const std::string& path, ImageFormat format) const
+{
+	if (format == ImageFormat::PNG)
+	{
+		return IMG_SavePNG(m_pBackBuffer, path.c_str()) == 0;
+	}
+
+	std::ofstream file{ path, std::ios::binary };
+	if (!file) return false;
+
+	if (format == ImageFormat::PPM)
+	{
+		file << "P6\n" << m_OutputWidth << ' ' << m_OutputHeight << "\n255\n";
+	}
+
+	//Convert one row at a time from the surface format to packed RGB
+	std::vector<uint8_t> row(static_cast<size_t>(m_OutputWidth) * 3);
+	for (int py{}; py < m_OutputHeight; ++py)
+	{
+		for (int px{}; px < m_OutputWidth; ++px)
+		{
+			uint8_t* pRgb{ &row[static_cast<size_t>(px) * 3] };
+			SDL_GetRGB(m_pBackBufferPixels[px + py * m_OutputWidth], m_pBackBuffer->format, &pRgb[0], &pRgb[1], &pRgb[2]);
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+	}
+
+	return file.good();
+}
+
 void dae::Renderer::ToggleRenderMode()
 {
 	//gets current render mode as int
@@ -466,8 +3059,10 @@ void dae::Renderer::ToggleRenderMode()
 	//after increasing int convert it back to rendermode while limiting it to its boundaries
 	current %= static_cast<int>(RenderMode::Last);
 
-	//Set new render mode as current render mode
+	//Set new render mode as current render mode, the bounding box view culls differently
 	m_RenderMode = static_cast<RenderMode>(current);
+	ResetHistory();
+	Invalidate();
 }
 
 void dae::Renderer::ToggleLightingMode()
@@ -481,11 +3076,15 @@ void dae::Renderer::ToggleLightingMode()
 
 	//Set new Lighting mode as current Lighting mode
 	m_LightingMode = static_cast<LightingMode>(current);
+	ResetHistory();
+	m_IsFrameDirty = true;
 }
 
 void dae::Renderer::ToggleNormalMap()
 {
-	m_IsNormalActive = !m_IsNormalActive; 
+	m_IsNormalActive = !m_IsNormalActive;
+	ResetHistory();
+	m_IsFrameDirty = true;
 }
 
 void dae::Renderer::ToggleMeshRotation()
@@ -1,11 +1,20 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "Camera.h"
 #include "DataTypes.h"
+#include "DynamicResolution.h"
+#include "FrameArena.h"
+#include "FrameStats.h"
+#include "InstanceBvh.h"
+#include "MaterialAtlas.h"
+#include "OcclusionBuffer.h"
+#include "Scene.h"
+#include "Simd.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -13,15 +22,47 @@ struct SDL_Surface;
 namespace dae
 {
 	class Texture;
+	class Model;
 	struct Mesh;
 	struct Vertex;
 	class Timer;
-	class Scene;
+	struct CameraKey;
+	class JobSystem;
+
+	//File formats the back buffer can be written to
+	enum class ImageFormat
+	{
+		Raw,	//Tightly packed 8-bit RGB, no header
+		PPM,	//Binary P6
+		PNG
+	};
 
 	class Renderer final
 	{
 	public:
+		enum class RenderMode
+		{
+			Normal,
+			DepthBuffer,
+			BoundingBox,
+			Overdraw,
+			Last
+		};
+
+		enum class LightingMode
+		{
+			Combined,
+			Diffuse,
+			ObservedArea,
+			Specular,
+			Last
+		};
+
 		Renderer(SDL_Window* pWindow);
+		//Headless renderer: draws into a memory back buffer, no window or video subsystem needed
+		Renderer(int width, int height, VertexFormat vertexFormat = VertexFormat::Float);
+		//Headless renderer sharing an already loaded model, one renderer per view/thread
+		Renderer(std::shared_ptr<const Model> pModel, int width, int height);
 		~Renderer();
 
 		Renderer(const Renderer&) = delete;
@@ -30,77 +71,459 @@ namespace dae
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
 		void Update(Timer* pTimer);
+		//Advances the scene by a fixed step without polling any input
+		void Advance(float elapsedSec);
 		void Render();
 		bool SaveBufferToImage() const;
+		bool SaveBufferToFile(const std::string& path, ImageFormat format) const;
+
+		//Output size, the frame itself can be rendered smaller and upscaled to it
+		int GetWidth() const { return m_OutputWidth; }
+		int GetHeight() const { return m_OutputHeight; }
+		//Renders at scale times the output size per axis, 1 renders straight into the back buffer
+		void SetRenderScale(float scale);
+		float GetRenderScale() const { return m_RenderScale; }
+		void SetUpscaleFilter(UpscaleFilter filter) { m_UpscaleFilter = filter; m_IsFrameDirty = true; }
+		//Picks the render scale of every frame to hold a frame time budget, fed by the frame times Update receives
+		void SetDynamicResolution(const DynamicResolutionSettings& settings);
+		void SetDynamicResolutionEnabled(bool isEnabled);
+		bool IsDynamicResolution() const { return m_IsDynamicResolution; }
+		void ToggleDynamicResolution();
+		//Feeds the controller the time of the last frame, for loops that do not call Update
+		void UpdateDynamicResolution(float elapsedSec);
+
+		//Worker threads of the frame, including the calling thread. Defaults to one per hardware thread
+		void SetNrWorkers(int nrWorkers, bool isPinningWorkers = false);
+		int GetNrWorkers() const;
+
+		//Vertex memory in bytes: the source meshes (once per model, however many instances), and the vertex stage output
+		size_t GetSourceVertexBytes() const;
+		size_t GetTransformedVertexBytes() const { return m_VerticesOut.GetByteSize() + m_CompactVerticesOut.GetByteSize(); }
+		VertexFormat GetVertexFormat() const { return m_Scene.GetVertexFormat(); }
+
+		const StageTimings& GetStageTimings() const { return m_StageTimings; }
+		const PipelineStats& GetPipelineStats() const { return m_PipelineStats; }
+		//Counts shades per pixel (always on in the Overdraw render mode), fills PipelineStats::pixelsShadedUnique
+		void SetOverdrawTracking(bool isTracking) { m_IsTrackingOverdraw = isTracking; m_IsFrameDirty = true; }
+		//True when the last Render found nothing changed and only presented the previous frame again
+		bool WasFrameReused() const { return m_IsFrameReused; }
+		//Forces the next Render to transform and draw everything, even when nothing changed
+		void Invalidate() { m_TransformedSceneVersion = UINT64_MAX; m_IsFrameDirty = true; }
+
+		Camera& GetCamera() { return m_Camera; }
+		//Starts with the loaded model, one instance of it and one directional light
+		Scene& GetScene() { return m_Scene; }
+		//Replaces the instances by nrInstances copies of the first model on a grid, starting at the first instance
+		void SetInstanceGrid(int nrInstances);
+		//Replaces the point and spot lights of the scene by nrLights colored ones spread over the instances, every
+		//third one a spot light pointing down. The directional lights stay
+		void SetLocalLights(int nrLights);
+		int GetNrLocalLights() const;
+		//Switches between no local lights and a few dozen
+		void ToggleLocalLights();
+
+		CameraKey GetCameraKey() const;
+		//Moves the camera and mesh to a recorded key, call Advance afterwards to rebuild the matrices
+		void ApplyCameraKey(const CameraKey& key);
 
 		void ToggleRenderMode();
+		void SetRenderMode(RenderMode renderMode) { m_RenderMode = renderMode; ResetHistory(); Invalidate(); }
 		void ToggleLightingMode();
 		void ToggleNormalMap();
 		void ToggleMeshRotation();
+		//Skips instances and clusters hidden behind the largest instances on screen, the image stays the same
+		void SetOcclusionCulling(bool isEnabled) { m_IsOcclusionCulling = isEnabled; Invalidate(); }
+		bool IsOcclusionCulling() const { return m_IsOcclusionCulling; }
+		void ToggleOcclusionCulling();
+		//Instances are drawn at the simplest level of detail whose error stays below this many pixels on screen,
+		//0 draws everything at full detail
+		void SetLodPixelError(float pixelError) { m_LodPixelError = pixelError; Invalidate(); }
+		float GetLodPixelError() const { return m_LodPixelError; }
+		//Submits the visible instances and their clusters front to back, so the depth test rejects more fragments before
+		//they are shaded. Only pixels at exactly the same depth can end up different
+		void SetDrawSorting(bool isEnabled) { m_IsSortingDraws = isEnabled; Invalidate(); }
+		bool IsDrawSorting() const { return m_IsSortingDraws; }
+		void ToggleDrawSorting();
+		//Shades blocks of up to maxRate x maxRate pixels once, where the texture and normals change little across them.
+		//Coverage and depth stay per pixel. 1 shades every pixel on its own, otherwise 2 or 4
+		void SetMaxShadingRate(int maxRate);
+		int GetMaxShadingRate() const { return m_MaxShadingRate; }
+		//Cycles the max rate through 1, 2 and 4
+		void ToggleShadingRate();
+		//Shades half of the pixels every frame in an alternating checkerboard. The other half is reprojected from the last
+		//frame and clamped to its shaded neighbours, a still view converges to the full image after two frames.
+		//Only in the Normal render mode
+		void SetCheckerboard(bool isEnabled);
+		bool IsCheckerboard() const { return m_IsCheckerboard; }
+		void ToggleCheckerboard();
+		//Reads the albedo, specular color and exponent and normal map sample of a pixel from one texel of an atlas
+		//built per model in texture space, instead of sampling four textures. It holds nothing that depends on the
+		//lights, view or world transform, so it is built once and only the light terms are left per pixel.
+		//Only in the Normal render mode with the combined lighting
+		void SetMaterialAtlas(bool isEnabled);
+		bool IsMaterialAtlas() const { return m_IsMaterialAtlas; }
+		void ToggleMaterialAtlas();
+		//4x multisample anti-aliasing: coverage and depth are tested at four samples per pixel, a fragment is still
+		//shaded once at the pixel center and its color goes to the samples it won. Pixels covered by a single fragment
+		//keep one color, only pixels along edges store all four and are averaged by a resolve at the end of the frame.
+		//Not in the bounding box render mode, turns the checkerboard and occlusion culling off while on
+		void SetMultisampling(bool isEnabled);
+		bool IsMultisampling() const { return m_IsMultisampling; }
+		void ToggleMultisampling();
+		//Output image, one 0x00RRGGBB pixel per output pixel
+		const uint32_t* GetOutputPixels() const { return m_pBackBufferPixels; }
 
 	private:
+		Renderer(SDL_Window* pWindow, std::shared_ptr<const Model> pModel, int width, int height);
+
 		SDL_Window* m_pWindow{};
 
 		SDL_Surface* m_pFrontBuffer{ nullptr };
 		SDL_Surface* m_pBackBuffer{ nullptr };
 		uint32_t* m_pBackBufferPixels{};
+		//Color target of the frame: the back buffer at full scale, otherwise m_pScaledPixels packed at m_Width
+		uint32_t* m_pRenderPixels{};
+		uint32_t* m_pScaledPixels{};
 
 		float* m_pDepthBufferPixels{};
+		uint8_t* m_pShadeCountPixels{};
 
 		Camera m_Camera{};
 
-		Texture* m_pTexture{};
-		Texture* m_pNormalTexture{};
-		Texture* m_pGlossinessTexture{};
-		Texture* m_pSpecularTexture{};
+		//Shared, read-only models with the instances of this view
+		Scene m_Scene{};
+		//Hierarchy over the instances, culled again whenever the transforms are
+		InstanceBvh m_InstanceBvh{};
+		std::vector<uint32_t> m_VisibleInstances{};
+		uint32_t m_NrVisibleInstances{};
+		uint32_t m_NrInstancesCulledFrustum{};
+		uint32_t m_NrInstancesCulledOcclusion{};
+
+		//Conservative depth of the occluders, the largest visible instances on screen
+		static constexpr int m_OcclusionWidth{ 256 };
+		static constexpr int m_OcclusionHeight{ 128 };
+		static constexpr size_t m_MaxOccluders{ 8 };
+		static constexpr float m_MinOccluderScreenShare{ 0.01f };
+		std::unique_ptr<OcclusionBuffer> m_pOcclusionBuffer{};
+		std::vector<uint32_t> m_Occluders{};
+		bool m_IsOcclusionCulling{ true };
+
+		//Level of detail of every visible instance, picked together with the visibility
+		std::vector<uint8_t> m_InstanceLods{};
+		float m_LodPixelError{ 1.f };
+
+		bool m_IsSortingDraws{ true };
+
+		//Variable rate shading: a block may share one shade when no more than this many texels and this much change
+		//of the unit normal fall across it
+		int m_MaxShadingRate{ 1 };
+		static constexpr float m_CoarseTexelsPerBlock{ 2.f };
+		static constexpr float m_CoarseNormalChangePerBlock{ 0.05f };
+
+		//Checkerboard rendering: pixels with (x + y) % 2 == m_CheckerboardParity are shaded this frame
+		bool m_IsCheckerboard{ false };
+		int m_CheckerboardParity{};
+		//Last frame at the render size and the transforms it was rendered with, the next one is written while
+		//the last one is read
+		uint32_t* m_pHistoryPixels{};
+		uint32_t* m_pNextHistoryPixels{};
+		Matrix m_HistoryViewProjection{};
+		std::vector<Matrix> m_HistoryWorldMatrices{};
+		uint64_t m_HistoryLightVersion{};
+		bool m_IsHistoryValid{ false };
+		//Instance every shaded pixel of the history showed, m_NoInstance for the background
+		uint32_t* m_pHistoryInstancePixels{};
+		uint32_t* m_pNextHistoryInstancePixels{};
+		static constexpr uint32_t m_NoInstance{ UINT32_MAX };
+		//Draw of the closest fragment of every covered pixel
+		uint32_t* m_pDrawIndexPixels{};
+
+		bool m_IsMaterialAtlas{ false };
+		//Per model index, built the first time the atlas is turned on. Empty for models without the textures it needs
+		std::vector<std::unique_ptr<const MaterialAtlas>> m_pMaterialAtlases{};
+
+		//Multisampling, allocated for the output size the first time it is turned on. Samples of a pixel are stored
+		//next to each other, at these offsets from the pixel center: a rotated grid, no two share a row or column
+		bool m_IsMultisampling{ false };
+		static constexpr int m_NrSamples{ 4 };
+		static constexpr uint8_t m_FullCoverage{ (1u << m_NrSamples) - 1 };
+		static constexpr float m_SampleOffsetsX[m_NrSamples]{ -0.125f, 0.375f, -0.375f, 0.125f };
+		static constexpr float m_SampleOffsetsY[m_NrSamples]{ -0.375f, -0.125f, 0.125f, 0.375f };
+		static constexpr float m_MaxSampleOffset{ 0.375f };
+		float* m_pSampleDepths{};
+		//Only valid for pixels that are expanded, the others hold their one color in the render target
+		uint32_t* m_pSampleColors{};
+		uint8_t* m_pExpandedPixels{};
+		//Tiles with any expanded pixel, the resolve skips the others. Both are all zero again after every resolve
+		uint8_t* m_pExpandedTiles{};
+
+		//Directional light every scene starts with
+		static constexpr float m_SunIntensity{ 7.0f };
+		static constexpr float m_SpecularShininess{ 25.0f };
+
+		//Lights of the frame as the shading reads them: the directional ones first, then the point and spot lights
+		//that reach into the view frustum. Each batch of fragments is shaded with the directional lights and the
+		//local lights that reach its tile
+		struct FrameLight
+		{
+			LightType type{};
+			Vector3 position{};			//World space
+			Vector3 viewPosition{};
+			Vector3 toLight{};			//Directional: unit vector against the direction
+			Vector3 direction{};		//Spot: unit vector
+			ColorRGB color{};
+			float intensity{};
+			float range{};
+			float invSqrRange{};
+			float cosOuterCone{};
+			float invConeFalloff{};		//1 / (cos inner - cos outer)
+		};
+		FrameLight* m_pFrameLights{};
+		uint32_t m_NrFrameLights{};
+		uint32_t m_NrDirectionalLights{};
+		uint64_t m_LitLightVersion{ UINT64_MAX };
+		//The inverse square falloff is clamped this close to a light
+		static constexpr float m_MinLightDistance{ 0.1f };
+		static constexpr int m_ViewerLocalLights{ 32 };
+		//World space ray from the camera to view depth 1 under raster position (0, 0) and its steps per pixel: the
+		//world position of a pixel is the camera origin plus its view depth times the ray under it
+		Vector3 m_PixelRay{};
+		Vector3 m_PixelRayStepX{};
+		Vector3 m_PixelRayStepY{};
+
+		struct LightList
+		{
+			const uint32_t* pIndices{};		//Into m_pFrameLights
+			uint32_t nrLights{};
+		};
 
 		bool m_IsNormalActive{ false };
 		bool m_IsMeshRotating{ false };
 
+		//Size the frame is rendered at, the back buffer is m_OutputWidth x m_OutputHeight
 		int m_Width{};
 		int m_Height{};
+		int m_OutputWidth{};
+		int m_OutputHeight{};
 		float m_AspectRatio{};
+		float m_RenderScale{ 1.f };
+		UpscaleFilter m_UpscaleFilter{ UpscaleFilter::Bilinear };
+		DynamicResolutionController m_DynamicResolution{};
+		bool m_IsDynamicResolution{ false };
 
-		Mesh m_Mesh{};
+		//Rotation applied to every instance around its own Y axis
+		float m_MeshYaw{};
+		//Dirty tracking: the vertices are only transformed again when the camera or an instance changed,
+		//the frame is only rendered again when anything that ends up in the image changed
+		uint64_t m_TransformedSceneVersion{ UINT64_MAX };
+		bool m_IsFrameDirty{ true };
+		bool m_IsFrameReused{ false };
+		VertexStreams m_VerticesOut{};
+		CompactVertexStreams m_CompactVerticesOut{};
+		static constexpr size_t m_FragmentBatchSize{ 4096 };
 
-		enum class RenderMode
+		//Transient buffers of the frame that are not tied to a worker, reset at the start of every frame
+		FrameArena m_FrameArena{};
+
+		//Work is split in chunks over the job system, the chunk outputs are kept in submission order
+		JobSystem* m_pJobSystem{};
+		static constexpr size_t m_VertexChunkSize{ 1024 };
+		static constexpr size_t m_TriangleChunkSize{ 1024 };
+
+		//Screen tiles, rasterized in parallel
+		static constexpr int m_TileSize{ 64 };
+		//Triangles with at most this many candidate samples per axis take the small path
+		static constexpr int m_SmallTriangleSamples{ 3 };
+		//Triangles with a bounding box of at least this many pixels take the span path
+		static constexpr int m_SpanTrianglePixels{ 64 };
+		int m_NrTilesX{};
+		int m_NrTilesY{};
+
+		//Output of one setup chunk in the arena of the worker that ran it. Bin of a tile:
+		//pBinTriangles[pBinOffsets[tile], pBinOffsets[tile + 1]) holds the chunk triangles touching the tile
+		struct TriangleChunk
 		{
-			Normal,
-			DepthBuffer,
-			BoundingBox,
-			Last
+			TriangleSetup* pTriangles{};
+			uint32_t nrTriangles{};
+			uint32_t firstTriangle{};	//Index of the first triangle in m_pTriangles
+			uint32_t* pBinOffsets{};
+			uint32_t* pBinTriangles{};
 		};
+		TriangleChunk* m_pChunks{};
+		size_t m_NrChunks{};
+		TriangleSetup* m_pTriangles{};		//All setup chunks gathered in submission order
 
-		enum class LightingMode
+		//Per-frame draw of one visible instance. Vertices and triangles of all draws are numbered back to back
+		//in instance order, every draw starts its vertices on a whole block
+		struct InstanceDraw
 		{
-			Combined,
-			Diffuse,
-			ObservedArea,
-			Specular,
-			Last
+			uint32_t instanceIndex{};
+			const Model* pModel{};
+			const Mesh* pMesh{};
+			uint32_t firstVertex{};		//Of the instance in the vertex stage output
+			bool isOccluder{};			//Never occlusion culled
+			const MaterialAtlas* pMaterialAtlas{};	//Only while the atlas is used
+		};
+		InstanceDraw* m_pDraws{};
+		uint32_t m_NrDraws{};
+		size_t m_NrVerticesOut{};
+		//Scene version the vertex stage output was last reserved for
+		uint64_t m_ReservedSceneVersion{ UINT64_MAX };
+
+		//Per-frame run of triangles of a draw that survived cluster culling
+		struct ClusterDraw
+		{
+			uint32_t drawIndex{};
+			uint32_t firstTriangle{};	//In the mesh
+			uint32_t nrTriangles{};
+			uint32_t firstSubmitted{};	//Number of its first triangle in triangle setup
+		};
+		ClusterDraw* m_pClusterDraws{};
+		uint32_t m_NrClusterDraws{};
+		size_t m_NrTrianglesSubmitted{};
+
+		StageTimings m_StageTimings{};
+		float m_MsPerCount{};
+
+		//Last shade of a block of a coarse triangle. Blocks never straddle tiles and a tile is shaded by one worker,
+		//so a slot per block of a tile at the finest coarse rate is enough
+		struct CoarseShade
+		{
+			uint32_t triangleIndex{ UINT32_MAX };
+			int blockIndex{};
+			uint32_t color{};
+		};
+		static constexpr int m_CoarseBlocksPerTile{ m_TileSize / 2 };
+
+		//Scratch state of one worker, the stats are merged into m_PipelineStats at the end of the frame
+		struct WorkerContext
+		{
+			PipelineStats stats{};
+			FrameArena arena{};
+			Fragment* pFragments{};		//Batch of m_FragmentBatchSize in the arena
+			size_t nrFragments{};
+			CoarseShade* pCoarseShades{};	//m_CoarseBlocksPerTile squared, in the arena
+			uint32_t* pLightIndices{};		//m_NrFrameLights in the arena, starts with the directional lights
+			LightList lights{};				//Of the batch being shaded
+			float busyMs{};
+			float shadeMs{};
+		};
+		std::unique_ptr<WorkerContext[]> m_pWorkers{};
+		PipelineStats m_PipelineStats{};
+		bool m_IsTrackingOverdraw{ false };
+
+		//Broadcast matrices and viewport of the vertex kernels, 8 vertices at a time
+		struct VertexBlockTransform
+		{
+			Simd::Float8 worldViewProjection[4][4]{};
+			Simd::Float8 world[3][3]{};
+			Simd::Float8 width{};
+			Simd::Float8 height{};
+
+			VertexBlockTransform(const Matrix& worldViewProjectionMatrix, const Matrix& worldMatrix, int width, int height);
+			void TransformPosition(const Simd::Float8& x, const Simd::Float8& y, const Simd::Float8& z, Simd::Float8 (&clip)[4]) const;
+			//Perspective divide and viewport mapping, w keeps the view depth
+			void ProjectPosition(const Simd::Float8 (&clip)[4], float* pNdcX, float* pNdcY, float* pNdcZ, float* pW, float* pRasterX, float* pRasterY) const;
+			//World rotation of a normal or tangent
+			void TransformDirection(const Simd::Float8& x, const Simd::Float8& y, const Simd::Float8& z, float* pX, float* pY, float* pZ) const;
 		};
 
 		RenderMode m_RenderMode{ RenderMode::Normal };
 		LightingMode m_LightingMode{ LightingMode::Combined };
 		
-		void RenderTriangle(const std::vector<Vector2>& rasterVertices, int vertexIdx, bool swapVertices) const;
+		void SetupTriangles();
+		void SetupTriangle(uint32_t drawIdx, uint32_t meshTriangleNr, TriangleChunk& chunk, PipelineStats& stats) const;
+		//Sends triangles with only a few candidate samples to the small path
+		void ClassifyTriangle(TriangleSetup& triangle) const;
+		//Coverage of the small triangles of a chunk, SIMD over the triangles. Drops the ones without samples
+		void TestSmallTriangles(TriangleChunk& chunk, PipelineStats& stats) const;
+		void SetupAttributePlanes(TriangleSetup& triangle) const;
+		//Coarsest shading rate whose blocks stay below the texture and normal detail limits at all three corners
+		[[nodiscard]] uint8_t SelectShadingRate(const TriangleSetup& triangle) const;
+		void BinTriangles(TriangleChunk& chunk, FrameArena& arena) const;
+		//Returns the share of the worker time spent shading
+		float RasterizeTriangles();
+		void RasterizeTile(int tileIdx, WorkerContext& worker);
+		void RenderTriangle(uint32_t triangleIdx, int tileIdx, WorkerContext& worker);
+		void RenderSmallTriangle(uint32_t triangleIdx, int tileIdx, WorkerContext& worker);
+		void RenderSpanTriangle(uint32_t triangleIdx, int tileIdx, WorkerContext& worker);
+		//Coverage and depth per sample, emits the fragments with the samples they won
+		void RenderMultisampledTriangle(uint32_t triangleIdx, int tileIdx, WorkerContext& worker);
+		void ClearSampleDepths(int tileIdx) const;
+		void ShadeFragments(WorkerContext& worker);
+		//Shade of the block of a coarse triangle the pixel lies in, evaluated at the block center on the first fragment
+		[[nodiscard]] uint32_t ShadeBlock(uint32_t triangleIdx, const TriangleSetup& triangle, int x, int y, WorkerContext& worker);
+		//Raster position the block of a coarse triangle around pixel (x, y) is shaded at
+		void GetBlockCenter(const TriangleSetup& triangle, int x, int y, float& centerX, float& centerY) const;
+		void ResolveOverdraw(PipelineStats& stats) const;
+		//Writes the color of a shaded fragment to the samples it won, expanding the pixel when that is not all of them
+		void StoreColor(const Fragment& fragment, uint32_t color) const;
+		//Raster position a fragment is shaded at: its pixel center, or the centroid of its samples when it does not
+		//hold all of them. The center of a partly covered pixel may lie outside the triangle
+		void GetShadingPosition(const Fragment& fragment, float& x, float& y) const;
+		//Averages the samples of every expanded pixel into the render target and compresses them again
+		void ResolveMultisampling();
+		[[nodiscard]] bool IsMultisamplingActive() const;
+		//Fills the pixels the checkerboard left out from the history, then makes this frame the history
+		void ReconstructCheckerboard();
+		[[nodiscard]] bool IsCheckerboardActive() const;
+		void ResetHistory() { m_IsHistoryValid = false; }
+		void MergeWorkerStats();
 		void ClearBackground() const;
+		//Scales the frame rendered below the output size up into the back buffer
+		void UpscaleToOutput();
 		void ResetDepthBuffer() const;
-		void Shade(int pixelIndex,Vertex_Out pxlInfo) const;
-		void InitializeBuffer(SDL_Window* pWindow);
+		[[nodiscard]] uint32_t Shade(const Vertex_Out& pxlInfo, const Model& model, const LightList& lights) const;
+		//Shade of the combined lighting with the material atlas texel under the pixel in place of the texture samples
+		[[nodiscard]] uint32_t ShadeFromMaterialAtlas(const TriangleSetup& triangle, float x, float y, const LightList& lights) const;
+		//Frame lights, the pixel rays and the light list every worker starts from
+		void PrepareLights();
+		//Keeps the local lights that reach the fragments of a batch in the list of the worker. The fragments of a batch
+		//all lie in one tile, their depth range bounds the tile
+		void CullTileLights(const Fragment* pFragments, size_t nrFragments, WorkerContext& worker) const;
+		//Sphere of a local light against the view frustum under a rectangle of raster positions, between two view depths
+		[[nodiscard]] bool IsLightInFrustum(const FrameLight& light, float minX, float minY, float maxX, float maxY, float nearDepth, float farDepth) const;
+		//Share of the intensity of a light that reaches a world position, and the unit vector towards the light
+		[[nodiscard]] float EvaluateLight(const FrameLight& light, const Vector3& position, Vector3& toLight) const;
+		[[nodiscard]] bool IsMaterialAtlasActive() const;
+		//Builds the material atlases of the models that have none yet, also those added to the scene since the last call
+		void BuildMaterialAtlases();
+		void InitializeBuffer();
 		void InitializeCamera();
-		void InitializeMesh(const char* filename);
+		void InitializeScene(std::shared_ptr<const Model> pModel);
+		void CullInstances();
+		[[nodiscard]] uint8_t SelectLod(const Instance& instance, const BoundingBox& worldBounds) const;
+		void SelectOccluders(const Matrix& viewProjectionMatrix);
+		void RenderOccluders();
+		[[nodiscard]] bool IsOccluder(uint32_t instanceIdx) const;
+		[[nodiscard]] bool IsOcclusionCullingActive() const;
+		void SortVisibleInstances();
+		//Smallest clip w, the view depth, of a box under a projection
+		[[nodiscard]] static float GetNearestDepth(const BoundingBox& box, const Matrix& toClip);
+		void BuildInstanceDraws();
+		//Frustum and occlusion culls the clusters of every draw
+		void BuildClusterDraws();
 		void ResetState();
-		void WorldToNDC(const Matrix& worldViewProjectionMatrix);
-		void NDCToRaster(std::vector<Vector2>& rasterVertices) const;
+		void UpdateMesh(float elapsedSec);
+		void TransformVertices();
+		//Room for every instance at full detail in the vertex stage output, so a frame that sees more of the scene
+		//than the ones before does not allocate
+		void ReserveVertexOutput();
+		//Batched: the world-view-projection matrices and kernel broadcasts of all instances in one pass
+		const VertexBlockTransform* TransformInstances();
+		void TransformVertexBlocks(const VertexBlockTransform& transform, const Mesh& mesh, size_t firstVertex, size_t endVertex, size_t outOffset);
+		void TransformCompactVertexBlocks(const VertexBlockTransform& transform, const Mesh& mesh, size_t firstVertex, size_t endVertex, size_t outOffset);
 		void UpdateSDL() const;
+		float Lap(uint64_t& lapCounter) const;
+		[[nodiscard]] bool IsTrackingOverdraw() const;
 		[[nodiscard]] bool IsVertexSame(uint32_t vertex0, uint32_t vertex1, uint32_t vertex2) const;
 		[[nodiscard]] bool IsOutsideFrustum(uint32_t vertex0, uint32_t vertex1, uint32_t vertex2) const;
+		[[nodiscard]] Vector2 GetRasterPosition(uint32_t vertex) const;
 		void CalculateBoundingBox(const Vector2& v0, const Vector2& v1, const Vector2& v2, int& startingX, int& StartingY, int& endingX, int& endingY)const;
 		void RenderBoundingBox(const int pixelIndex) const;
 		[[nodiscard]] bool IsInsideTriangle(const float edgePoint01, const float edgePoint12, const float edgePoint20) const;
 		[[nodiscard]] bool IsCurrentDepthBufferLessThenDepth(const int pixelIndex, const float ZDepth) const;
-		void CalculatePixelInfo(Vertex_Out& pixelInfo, float weightV0, float weightV1, float weightV2, uint32_t vertIndex0, uint32_t vertIndex1, uint32_t vertIndex2, float wDepth) const;
+		void CalculatePixelInfo(Vertex_Out& pixelInfo, const TriangleSetup& triangle, float x, float y) const;
 		void RemapZDepth(float interpolatedZDepth, float& depthColor)const;
 		ColorRGB CalculatePhong(const float exponent, const Vector3& lightDirection, const Vector3& viewDirection, const Vector3& normal) const;
 	};
@@ -0,0 +1,90 @@
+#include "Scene.h"
+
+#include <cassert>
+#include <cmath>
+
+#include "Model.h"
+
+namespace dae
+{
+	uint32_t Scene::AddModel(std::shared_ptr<const Model> pModel)
+	{
+		assert(pModel && "Model is not loaded");
+		assert((m_pModels.empty() || pModel->GetMesh().vertexFormat == GetVertexFormat()) && "All models of a scene need the same vertex format");
+
+		m_pModels.emplace_back(std::move(pModel));
+		return static_cast<uint32_t>(m_pModels.size() - 1);
+	}
+
+	uint32_t Scene::AddInstance(uint32_t modelIndex, const Matrix& worldMatrix)
+	{
+		assert(modelIndex < m_pModels.size());
+
+		m_Instances.emplace_back(Instance{ modelIndex, worldMatrix });
+		++m_Version;
+		return static_cast<uint32_t>(m_Instances.size() - 1);
+	}
+
+	void Scene::AddInstanceGrid(uint32_t modelIndex, int nrInstances, const Matrix& origin, float spacing)
+	{
+		const int nrColumns{ static_cast<int>(std::ceil(std::sqrt(static_cast<float>(nrInstances)))) };
+		m_Instances.reserve(m_Instances.size() + nrInstances);
+
+		for (int instance{}; instance < nrInstances; ++instance)
+		{
+			const int column{ instance % nrColumns };
+			const int row{ instance / nrColumns };
+			const float x{ (static_cast<float>(column) - static_cast<float>(nrColumns - 1) * 0.5f) * spacing };
+			const float z{ static_cast<float>(row) * spacing };
+			AddInstance(modelIndex, Matrix::CreateTranslation(x, 0.f, z) * origin);
+		}
+	}
+
+	void Scene::ClearInstances()
+	{
+		m_Instances.clear();
+		++m_Version;
+	}
+
+	uint32_t Scene::AddLight(const Light& light)
+	{
+		assert((light.type == LightType::Directional || light.range > 0.f) && "Point and spot lights need a range");
+		assert((light.type != LightType::Spot || light.innerConeAngle <= light.outerConeAngle) && "The inner cone of a spot light is inside the outer one");
+
+		m_Lights.emplace_back(light);
+		++m_LightVersion;
+		return static_cast<uint32_t>(m_Lights.size() - 1);
+	}
+
+	void Scene::SetLight(uint32_t lightIndex, const Light& light)
+	{
+		m_Lights[lightIndex] = light;
+		++m_LightVersion;
+	}
+
+	void Scene::ClearLights()
+	{
+		m_Lights.clear();
+		++m_LightVersion;
+	}
+
+	VertexFormat Scene::GetVertexFormat() const
+	{
+		return m_pModels.empty() ? VertexFormat::Float : m_pModels.front()->GetMesh().vertexFormat;
+	}
+
+	void Scene::SetWorldMatrix(uint32_t instanceIndex, const Matrix& worldMatrix)
+	{
+		m_Instances[instanceIndex].worldMatrix = worldMatrix;
+		++m_Version;
+	}
+
+	void Scene::TransformInstances(const Matrix& localTransform)
+	{
+		for (Instance& instance : m_Instances)
+		{
+			instance.worldMatrix = localTransform * instance.worldMatrix;
+		}
+		++m_Version;
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "DataTypes.h"
+#include "Math.h"
+
+namespace dae
+{
+	class Model;
+
+	//One placement of a model
+	struct Instance
+	{
+		uint32_t modelIndex{};
+		Matrix worldMatrix{};
+	};
+
+	enum class LightType : uint8_t
+	{
+		Directional,	//Reaches everything from one direction, never culled
+		Point,
+		Spot
+	};
+
+	//Point and spot lights fall off with the inverse square of the distance, windowed to reach 0 at their range, so
+	//they can be culled exactly by a sphere of that range
+	struct Light
+	{
+		LightType type{ LightType::Point };
+		Vector3 position{};						//Point and spot, world space
+		Vector3 direction{ Vector3::UnitZ };	//Directional and spot: the direction the light travels in
+		ColorRGB color{ colors::White };
+		float intensity{ 1.f };					//Scales the diffuse term, the specular one only takes the color
+		float range{ 10.f };					//Point and spot
+		float innerConeAngle{ 0.3f };			//Spot, radians from the direction: full intensity inside,
+		float outerConeAngle{ 0.5f };			//no light outside
+	};
+
+	//Models and their instances. The models are immutable and can be shared with other scenes and threads,
+	//the instances belong to the scene. Every instance reuses the mesh data of its model
+	class Scene final
+	{
+	public:
+		Scene() = default;
+		~Scene() = default;
+
+		Scene(const Scene&) = delete;
+		Scene(Scene&&) noexcept = delete;
+		Scene& operator=(const Scene&) = delete;
+		Scene& operator=(Scene&&) noexcept = delete;
+
+		//All models of a scene share one vertex format
+		uint32_t AddModel(std::shared_ptr<const Model> pModel);
+		uint32_t AddInstance(uint32_t modelIndex, const Matrix& worldMatrix);
+		//nrInstances copies of a model on a square grid in the local XZ plane of origin, rows going away along +Z
+		void AddInstanceGrid(uint32_t modelIndex, int nrInstances, const Matrix& origin, float spacing);
+		void ClearInstances();
+
+		uint32_t GetNrModels() const { return static_cast<uint32_t>(m_pModels.size()); }
+		const Model& GetModel(uint32_t modelIndex) const { return *m_pModels[modelIndex]; }
+		const std::shared_ptr<const Model>& GetModelPointer(uint32_t modelIndex) const { return m_pModels[modelIndex]; }
+		VertexFormat GetVertexFormat() const;
+
+		uint32_t GetNrInstances() const { return static_cast<uint32_t>(m_Instances.size()); }
+		const Instance& GetInstance(uint32_t instanceIndex) const { return m_Instances[instanceIndex]; }
+		void SetWorldMatrix(uint32_t instanceIndex, const Matrix& worldMatrix);
+		//worldMatrix = localTransform * worldMatrix on every instance, e.g. to spin all of them around their own axis
+		void TransformInstances(const Matrix& localTransform);
+
+		uint32_t AddLight(const Light& light);
+		void SetLight(uint32_t lightIndex, const Light& light);
+		void ClearLights();
+		uint32_t GetNrLights() const { return static_cast<uint32_t>(m_Lights.size()); }
+		const Light& GetLight(uint32_t lightIndex) const { return m_Lights[lightIndex]; }
+
+		//Changes whenever an instance is added, removed or moved, so views can tell their transforms are stale
+		uint64_t GetVersion() const { return m_Version; }
+		//Changes whenever a light is added, removed or changed, the transforms stay valid
+		uint64_t GetLightVersion() const { return m_LightVersion; }
+
+	private:
+		std::vector<std::shared_ptr<const Model>> m_pModels{};
+		std::vector<Instance> m_Instances{};
+		std::vector<Light> m_Lights{};
+		uint64_t m_Version{};
+		uint64_t m_LightVersion{};
+	};
+}
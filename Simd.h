@@ -0,0 +1,169 @@
+#pragma once
+#include <cmath>
+
+//SSE2 is used for Vector4 and Matrix whenever the target supports it (always on x64),
+//define RASTERIZER_NO_SIMD to force the scalar fallback
+#if !defined(RASTERIZER_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RASTERIZER_SIMD_SSE 1
+#include <emmintrin.h>
+#else
+#define RASTERIZER_SIMD_SSE 0
+#endif
+
+//The 8-wide kernels use one AVX register when the target has AVX, two SSE registers otherwise
+#if RASTERIZER_SIMD_SSE && defined(__AVX__)
+#define RASTERIZER_SIMD_AVX 1
+#include <immintrin.h>
+#else
+#define RASTERIZER_SIMD_AVX 0
+#endif
+
+namespace dae::Simd
+{
+	constexpr bool IsEnabled()
+	{
+		return RASTERIZER_SIMD_SSE != 0;
+	}
+
+#if RASTERIZER_SIMD_SSE
+	template<int Lane>
+	inline __m128 Splat(__m128 v)
+	{
+		return _mm_shuffle_ps(v, v, _MM_SHUFFLE(Lane, Lane, Lane, Lane));
+	}
+
+	//Sum of all four lanes, added in x, y, z, w order to match the scalar path
+	inline float HorizontalAdd(__m128 v)
+	{
+		const __m128 xy{ _mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))) };
+		const __m128 xyz{ _mm_add_ss(xy, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))) };
+		return _mm_cvtss_f32(_mm_add_ss(xyz, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+	}
+
+	inline float Dot3(__m128 a, __m128 b)
+	{
+		const __m128 m{ _mm_mul_ps(a, b) };
+		const __m128 xy{ _mm_add_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1))) };
+		return _mm_cvtss_f32(_mm_add_ss(xy, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 2, 2, 2))));
+	}
+
+	//Cross product of the xyz lanes, w of the result is 0 when both inputs have w == 0
+	inline __m128 Cross3(__m128 a, __m128 b)
+	{
+		const __m128 aYZX{ _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1)) };
+		const __m128 bYZX{ _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1)) };
+		const __m128 c{ _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b)) };
+		return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+	}
+
+	inline __m128 ClearW(__m128 v)
+	{
+		const __m128 mask{ _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1)) };
+		return _mm_and_ps(v, mask);
+	}
+#endif
+
+	//8 floats processed as one value, the lane count of the structure-of-arrays kernels
+	struct Float8
+	{
+		static constexpr int laneCount{ 8 };
+
+#if RASTERIZER_SIMD_AVX
+		__m256 value;
+
+		static Float8 Set(float f) { return { _mm256_set1_ps(f) }; }
+		static Float8 Load(const float* pData) { return { _mm256_loadu_ps(pData) }; }
+		void Store(float* pData) const { _mm256_storeu_ps(pData, value); }
+
+		Float8 operator+(const Float8& f) const { return { _mm256_add_ps(value, f.value) }; }
+		Float8 operator-(const Float8& f) const { return { _mm256_sub_ps(value, f.value) }; }
+		Float8 operator*(const Float8& f) const { return { _mm256_mul_ps(value, f.value) }; }
+		Float8 operator/(const Float8& f) const { return { _mm256_div_ps(value, f.value) }; }
+		static Float8 Sqrt(const Float8& f) { return { _mm256_sqrt_ps(f.value) }; }
+		static Float8 Min(const Float8& a, const Float8& b) { return { _mm256_min_ps(a.value, b.value) }; }
+		static Float8 Max(const Float8& a, const Float8& b) { return { _mm256_max_ps(a.value, b.value) }; }
+		//ifTrue in the lanes where test >= 0, ifFalse in the others
+		static Float8 SelectNotNegative(const Float8& test, const Float8& ifTrue, const Float8& ifFalse)
+		{
+			const __m256 mask{ _mm256_cmp_ps(test.value, _mm256_setzero_ps(), _CMP_GE_OQ) };
+			return { _mm256_blendv_ps(ifFalse.value, ifTrue.value, mask) };
+		}
+		//Bit per lane, set where the lane is >= 0
+		static int NotNegativeMask(const Float8& f) { return _mm256_movemask_ps(_mm256_cmp_ps(f.value, _mm256_setzero_ps(), _CMP_GE_OQ)); }
+#elif RASTERIZER_SIMD_SSE
+		__m128 low;
+		__m128 high;
+
+		static Float8 Set(float f) { return { _mm_set1_ps(f), _mm_set1_ps(f) }; }
+		static Float8 Load(const float* pData) { return { _mm_loadu_ps(pData), _mm_loadu_ps(pData + 4) }; }
+		void Store(float* pData) const { _mm_storeu_ps(pData, low); _mm_storeu_ps(pData + 4, high); }
+
+		Float8 operator+(const Float8& f) const { return { _mm_add_ps(low, f.low), _mm_add_ps(high, f.high) }; }
+		Float8 operator-(const Float8& f) const { return { _mm_sub_ps(low, f.low), _mm_sub_ps(high, f.high) }; }
+		Float8 operator*(const Float8& f) const { return { _mm_mul_ps(low, f.low), _mm_mul_ps(high, f.high) }; }
+		Float8 operator/(const Float8& f) const { return { _mm_div_ps(low, f.low), _mm_div_ps(high, f.high) }; }
+		static Float8 Sqrt(const Float8& f) { return { _mm_sqrt_ps(f.low), _mm_sqrt_ps(f.high) }; }
+		static Float8 Min(const Float8& a, const Float8& b) { return { _mm_min_ps(a.low, b.low), _mm_min_ps(a.high, b.high) }; }
+		static Float8 Max(const Float8& a, const Float8& b) { return { _mm_max_ps(a.low, b.low), _mm_max_ps(a.high, b.high) }; }
+		static Float8 SelectNotNegative(const Float8& test, const Float8& ifTrue, const Float8& ifFalse)
+		{
+			const auto select = [](__m128 test, __m128 ifTrue, __m128 ifFalse)
+			{
+				const __m128 mask{ _mm_cmpge_ps(test, _mm_setzero_ps()) };
+				return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+			};
+			return { select(test.low, ifTrue.low, ifFalse.low), select(test.high, ifTrue.high, ifFalse.high) };
+		}
+		static int NotNegativeMask(const Float8& f)
+		{
+			return _mm_movemask_ps(_mm_cmpge_ps(f.low, _mm_setzero_ps())) | _mm_movemask_ps(_mm_cmpge_ps(f.high, _mm_setzero_ps())) << 4;
+		}
+#else
+		float value[laneCount];
+
+		static Float8 Set(float f)
+		{
+			Float8 result;
+			for (float& lane : result.value) lane = f;
+			return result;
+		}
+		static Float8 Load(const float* pData)
+		{
+			Float8 result;
+			for (int i{ 0 }; i < laneCount; ++i) result.value[i] = pData[i];
+			return result;
+		}
+		void Store(float* pData) const
+		{
+			for (int i{ 0 }; i < laneCount; ++i) pData[i] = value[i];
+		}
+
+		template<typename Operation>
+		Float8 Apply(const Float8& f, Operation operation) const
+		{
+			Float8 result;
+			for (int i{ 0 }; i < laneCount; ++i) result.value[i] = operation(value[i], f.value[i]);
+			return result;
+		}
+		Float8 operator+(const Float8& f) const { return Apply(f, [](float a, float b) { return a + b; }); }
+		Float8 operator-(const Float8& f) const { return Apply(f, [](float a, float b) { return a - b; }); }
+		Float8 operator*(const Float8& f) const { return Apply(f, [](float a, float b) { return a * b; }); }
+		Float8 operator/(const Float8& f) const { return Apply(f, [](float a, float b) { return a / b; }); }
+		static Float8 Sqrt(const Float8& f) { return f.Apply(f, [](float a, float) { return sqrtf(a); }); }
+		static Float8 Min(const Float8& a, const Float8& b) { return a.Apply(b, [](float x, float y) { return y < x ? y : x; }); }
+		static Float8 Max(const Float8& a, const Float8& b) { return a.Apply(b, [](float x, float y) { return x < y ? y : x; }); }
+		static Float8 SelectNotNegative(const Float8& test, const Float8& ifTrue, const Float8& ifFalse)
+		{
+			Float8 result;
+			for (int i{ 0 }; i < laneCount; ++i) result.value[i] = test.value[i] >= 0.f ? ifTrue.value[i] : ifFalse.value[i];
+			return result;
+		}
+		static int NotNegativeMask(const Float8& f)
+		{
+			int mask{};
+			for (int i{ 0 }; i < laneCount; ++i) mask |= (f.value[i] >= 0.f) << i;
+			return mask;
+		}
+#endif
+	};
+}
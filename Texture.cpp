@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cassert>
 
+#include "Trace.h"
 #include "Vector2.h"
 #include <SDL_image.h>
 
@@ -25,6 +26,8 @@ namespace dae
 
 	Texture* Texture::LoadFromFile(const std::string& path)
 	{
+		TRACE_ZONE("Texture::LoadFromFile");
+
 		//create an SDL_Surface from the file
 		SDL_Surface* file = IMG_Load(path.c_str());
 
@@ -47,10 +50,11 @@ namespace dae
 		Uint8 g{};
 		Uint8 b{};
 
-		const float xCord = std::clamp(uv.x, 0.0f, 1.0f) * m_pSurface->w;
-		const float yCord = std::clamp(uv.y, 0.0f, 1.0f) * m_pSurface->h;
+		//uv 1 lands on the last texel, not one past it
+		const int xCord{ std::min(static_cast<int>(std::clamp(uv.x, 0.0f, 1.0f) * m_pSurface->w), m_pSurface->w - 1) };
+		const int yCord{ std::min(static_cast<int>(std::clamp(uv.y, 0.0f, 1.0f) * m_pSurface->h), m_pSurface->h - 1) };
 
-		const Uint32 pixelIndex{ m_pSurfacePixels[static_cast<int>(xCord) + static_cast<int>(yCord) * m_pSurface->w] };
+		const Uint32 pixelIndex{ m_pSurfacePixels[xCord + yCord * m_pSurface->w] };
 
 		SDL_GetRGB(pixelIndex, m_pSurface->format, &r, &g, &b);
 
@@ -14,6 +14,8 @@ namespace dae
 
 		static Texture* LoadFromFile(const std::string& path);
 		ColorRGB Sample(const Vector2& uv) const;
+		int GetWidth() const { return m_pSurface->w; }
+		int GetHeight() const { return m_pSurface->h; }
 
 	private:
 		Texture(SDL_Surface* pSurface);
@@ -0,0 +1,158 @@
+#include "Trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dae
+{
+	namespace Trace
+	{
+		namespace
+		{
+			struct Event
+			{
+				const char* pName{};
+				uint64_t startNs{};
+				uint64_t endNs{};
+			};
+
+			//Single producer (the owning thread), read by WriteChromeJson once capturing stopped
+			struct ThreadBuffer
+			{
+				static constexpr uint64_t capacity{ 1 << 16 };
+
+				std::unique_ptr<Event[]> pEvents{ new Event[capacity] };
+				std::atomic<uint64_t> writeIndex{ 0 };
+				uint32_t threadId{};
+				std::string name{};
+			};
+
+			std::atomic<bool> g_IsCapturing{ false };
+			uint64_t g_CaptureStartNs{};
+
+			//Only locked when a thread records its first event and when dumping
+			std::mutex g_RegistryMutex{};
+			std::vector<std::unique_ptr<ThreadBuffer>> g_ThreadBuffers{};
+
+			ThreadBuffer& GetThreadBuffer()
+			{
+				thread_local ThreadBuffer* pBuffer{ nullptr };
+				if (!pBuffer)
+				{
+					const std::lock_guard lock{ g_RegistryMutex };
+					g_ThreadBuffers.emplace_back(std::make_unique<ThreadBuffer>());
+					pBuffer = g_ThreadBuffers.back().get();
+					pBuffer->threadId = static_cast<uint32_t>(g_ThreadBuffers.size());
+				}
+				return *pBuffer;
+			}
+
+			void WriteEscaped(std::ostream& stream, const std::string& text)
+			{
+				for (const char character : text)
+				{
+					if (character == '"' || character == '\\')
+						stream << '\\';
+					stream << character;
+				}
+			}
+		}
+
+		void BeginCapture()
+		{
+			{
+				const std::lock_guard lock{ g_RegistryMutex };
+				for (const std::unique_ptr<ThreadBuffer>& pBuffer : g_ThreadBuffers)
+				{
+					pBuffer->writeIndex.store(0, std::memory_order_relaxed);
+				}
+			}
+
+			g_CaptureStartNs = GetTimeNs();
+			g_IsCapturing.store(true, std::memory_order_release);
+		}
+
+		void EndCapture()
+		{
+			g_IsCapturing.store(false, std::memory_order_release);
+		}
+
+		bool IsCapturing()
+		{
+			return g_IsCapturing.load(std::memory_order_relaxed);
+		}
+
+		bool WriteChromeJson(const std::string& path)
+		{
+			std::ofstream file{ path };
+			if (!file)
+				return false;
+
+			const std::lock_guard lock{ g_RegistryMutex };
+
+			file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+			bool isFirstEvent{ true };
+			const auto separate = [&]()
+			{
+				file << (isFirstEvent ? "" : ",\n");
+				isFirstEvent = false;
+			};
+
+			file.setf(std::ios::fixed);
+			file.precision(3);
+			for (const std::unique_ptr<ThreadBuffer>& pBuffer : g_ThreadBuffers)
+			{
+				if (!pBuffer->name.empty())
+				{
+					separate();
+					file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << pBuffer->threadId << ",\"args\":{\"name\":\"";
+					WriteEscaped(file, pBuffer->name);
+					file << "\"}}";
+				}
+
+				//Only the last 'capacity' events survive in the ring
+				const uint64_t writeIndex{ pBuffer->writeIndex.load(std::memory_order_acquire) };
+				const uint64_t firstIndex{ writeIndex > ThreadBuffer::capacity ? writeIndex - ThreadBuffer::capacity : 0 };
+				for (uint64_t index{ firstIndex }; index < writeIndex; ++index)
+				{
+					const Event& event{ pBuffer->pEvents[index % ThreadBuffer::capacity] };
+					if (event.startNs < g_CaptureStartNs)
+						continue;
+
+					separate();
+					file << "{\"name\":\"" << event.pName << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << pBuffer->threadId
+						<< ",\"ts\":" << static_cast<double>(event.startNs - g_CaptureStartNs) / 1000.0
+						<< ",\"dur\":" << static_cast<double>(event.endNs - event.startNs) / 1000.0 << "}";
+				}
+			}
+			file << "\n]}\n";
+
+			return file.good();
+		}
+
+		void SetThreadName(const std::string& name)
+		{
+			ThreadBuffer& buffer{ GetThreadBuffer() };
+			const std::lock_guard lock{ g_RegistryMutex };
+			buffer.name = name;
+		}
+
+		uint64_t GetTimeNs()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		void Record(const char* pName, uint64_t startNs, uint64_t endNs)
+		{
+			ThreadBuffer& buffer{ GetThreadBuffer() };
+			const uint64_t index{ buffer.writeIndex.load(std::memory_order_relaxed) };
+			buffer.pEvents[index % ThreadBuffer::capacity] = Event{ pName, startNs, endNs };
+			buffer.writeIndex.store(index + 1, std::memory_order_release);
+		}
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+//Scoped timeline zones, dumped as a chrome://tracing / Perfetto JSON trace.
+//Zones are only compiled in when RASTERIZER_TRACE is defined, otherwise TRACE_ZONE expands to nothing.
+//Every thread records into its own ring buffer, so recording takes no locks.
+
+namespace dae
+{
+	namespace Trace
+	{
+		constexpr bool IsCompiledIn()
+		{
+#ifdef RASTERIZER_TRACE
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		//Starts recording (clears earlier events). Call in between frames.
+		void BeginCapture();
+		void EndCapture();
+		bool IsCapturing();
+
+		//Writes the last recorded events of every thread, call after EndCapture
+		bool WriteChromeJson(const std::string& path);
+
+		//Name shown for the calling thread in the trace viewer
+		void SetThreadName(const std::string& name);
+
+		uint64_t GetTimeNs();
+		void Record(const char* pName, uint64_t startNs, uint64_t endNs);
+
+		class Zone final
+		{
+		public:
+			explicit Zone(const char* pName)
+				: m_pName{ pName }
+				, m_StartNs{ IsCapturing() ? GetTimeNs() : 0 }
+			{
+			}
+
+			~Zone()
+			{
+				if (m_StartNs)
+					Record(m_pName, m_StartNs, GetTimeNs());
+			}
+
+			Zone(const Zone&) = delete;
+			Zone(Zone&&) noexcept = delete;
+			Zone& operator=(const Zone&) = delete;
+			Zone& operator=(Zone&&) noexcept = delete;
+
+		private:
+			const char* m_pName;	//Must be a string literal
+			uint64_t m_StartNs;
+		};
+	}
+}
+
+#ifdef RASTERIZER_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) const dae::Trace::Zone TRACE_CONCAT(traceZone, __LINE__){ name }
+#define TRACE_THREAD_NAME(name) dae::Trace::SetThreadName(name)
+#else
+#define TRACE_ZONE(name)
+#define TRACE_THREAD_NAME(name)
+#endif
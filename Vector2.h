@@ -1,4 +1,7 @@
 #pragma once
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 
 namespace dae
 {
@@ -8,35 +11,35 @@ namespace dae
 		float y{};
 
 		Vector2() = default;
-		Vector2(float _x, float _y);
-		Vector2(const Vector2& from, const Vector2& to);
+		constexpr Vector2(float _x, float _y);
+		constexpr Vector2(const Vector2& from, const Vector2& to);
 
 		float Magnitude() const;
-		float SqrMagnitude() const;
+		constexpr float SqrMagnitude() const;
 		float Normalize();
 		Vector2 Normalized() const;
-		void Clamp(float minX, float minY, float maxX, float maxY);
-		void Clamp(float maxX, float maxY);
+		constexpr void Clamp(float minX, float minY, float maxX, float maxY);
+		constexpr void Clamp(float maxX, float maxY);
 
 
-		static float Dot(const Vector2& v1, const Vector2& v2);
-		static float Cross(const Vector2& v1, const Vector2& v2);
-		static Vector2 Min(const Vector2& v1, const Vector2& v2);
-		static Vector2 Max(const Vector2& v1, const Vector2& v2);
+		static constexpr float Dot(const Vector2& v1, const Vector2& v2);
+		static constexpr float Cross(const Vector2& v1, const Vector2& v2);
+		static constexpr Vector2 Min(const Vector2& v1, const Vector2& v2);
+		static constexpr Vector2 Max(const Vector2& v1, const Vector2& v2);
 
 		//Member Operators
-		Vector2 operator*(float scale) const;
-		Vector2 operator/(float scale) const;
-		Vector2 operator+(const Vector2& v) const;
-		Vector2 operator-(const Vector2& v) const;
-		Vector2 operator-() const;
+		constexpr Vector2 operator*(float scale) const;
+		constexpr Vector2 operator/(float scale) const;
+		constexpr Vector2 operator+(const Vector2& v) const;
+		constexpr Vector2 operator-(const Vector2& v) const;
+		constexpr Vector2 operator-() const;
 		//Vector2& operator-();
-		Vector2& operator+=(const Vector2& v);
-		Vector2& operator-=(const Vector2& v);
-		Vector2& operator/=(float scale);
-		Vector2& operator*=(float scale);
-		float& operator[](int index);
-		float operator[](int index) const;
+		constexpr Vector2& operator+=(const Vector2& v);
+		constexpr Vector2& operator-=(const Vector2& v);
+		constexpr Vector2& operator/=(float scale);
+		constexpr Vector2& operator*=(float scale);
+		constexpr float& operator[](int index);
+		constexpr float operator[](int index) const;
 
 		static const Vector2 UnitX;
 		static const Vector2 UnitY;
@@ -44,8 +47,146 @@ namespace dae
 	};
 
 	//Global Operators
-	inline Vector2 operator*(float scale, const Vector2& v)
+	constexpr Vector2 operator*(float scale, const Vector2& v)
 	{
 		return { v.x * scale, v.y * scale };
 	}
-}
\ No newline at end of file
+
+	constexpr Vector2::Vector2(float _x, float _y) : x(_x), y(_y) {}
+
+	constexpr Vector2::Vector2(const Vector2& from, const Vector2& to) : x(to.x - from.x), y(to.y - from.y) {}
+
+	inline constexpr Vector2 Vector2::UnitX{ 1, 0 };
+	inline constexpr Vector2 Vector2::UnitY{ 0, 1 };
+	inline constexpr Vector2 Vector2::Zero{ 0, 0 };
+
+	inline float Vector2::Magnitude() const
+	{
+		return sqrtf(x * x + y * y);
+	}
+
+	constexpr float Vector2::SqrMagnitude() const
+	{
+		return x * x + y * y;
+	}
+
+	inline float Vector2::Normalize()
+	{
+		const float m = Magnitude();
+		x /= m;
+		y /= m;
+
+		return m;
+	}
+
+	inline Vector2 Vector2::Normalized() const
+	{
+		const float m = Magnitude();
+		return { x / m, y / m };
+	}
+
+	constexpr void Vector2::Clamp(float minX, float minY, float maxX, float maxY)
+	{
+		x = std::clamp(x, minX, maxX);
+		y = std::clamp(y, minY, maxY);
+	}
+
+	constexpr void Vector2::Clamp(float maxX, float maxY)
+	{
+		x = std::clamp(x, 0.f, maxX);
+		y = std::clamp(y, 0.f, maxY);
+	}
+
+	constexpr Vector2 Vector2::Min(const Vector2& v1, const Vector2& v2)
+	{
+		return{
+			std::min(v1.x, v2.x),
+			std::min(v1.y, v2.y),
+		};
+	}
+
+	constexpr Vector2 Vector2::Max(const Vector2& v1, const Vector2& v2)
+	{
+		return{
+			std::max(v1.x, v2.x),
+			std::max(v1.y, v2.y),
+		};
+	}
+
+	constexpr float Vector2::Dot(const Vector2& v1, const Vector2& v2)
+	{
+		return v1.x * v2.x + v1.y * v2.y;
+	}
+
+	constexpr float Vector2::Cross(const Vector2& v1, const Vector2& v2)
+	{
+		return v1.x * v2.y - v1.y * v2.x;
+	}
+
+#pragma region Operator Overloads
+	constexpr Vector2 Vector2::operator*(float scale) const
+	{
+		return { x * scale, y * scale };
+	}
+
+	constexpr Vector2 Vector2::operator/(float scale) const
+	{
+		return { x / scale, y / scale };
+	}
+
+	constexpr Vector2 Vector2::operator+(const Vector2& v) const
+	{
+		return { x + v.x, y + v.y };
+	}
+
+	constexpr Vector2 Vector2::operator-(const Vector2& v) const
+	{
+		return { x - v.x, y - v.y };
+	}
+
+	constexpr Vector2 Vector2::operator-() const
+	{
+		return { -x ,-y };
+	}
+
+	constexpr Vector2& Vector2::operator*=(float scale)
+	{
+		x *= scale;
+		y *= scale;
+		return *this;
+	}
+
+	constexpr Vector2& Vector2::operator/=(float scale)
+	{
+		x /= scale;
+		y /= scale;
+		return *this;
+	}
+
+	constexpr Vector2& Vector2::operator-=(const Vector2& v)
+	{
+		x -= v.x;
+		y -= v.y;
+		return *this;
+	}
+
+	constexpr Vector2& Vector2::operator+=(const Vector2& v)
+	{
+		x += v.x;
+		y += v.y;
+		return *this;
+	}
+
+	constexpr float& Vector2::operator[](int index)
+	{
+		assert(index <= 1 && index >= 0);
+		return index == 0 ? x : y;
+	}
+
+	constexpr float Vector2::operator[](int index) const
+	{
+		assert(index <= 1 && index >= 0);
+		return index == 0 ? x : y;
+	}
+#pragma endregion
+}
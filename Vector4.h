@@ -1,36 +1,188 @@
 #pragma once
+#include <cassert>
+#include <cmath>
+#include <type_traits>
+
+#include "Simd.h"
+#include "Vector2.h"
+#include "Vector3.h"
 
 namespace dae
 {
-	struct Vector2;
-	struct Vector3;
-	struct Vector4
+	//16-byte aligned so a Vector4 maps onto one SSE register, also used as the rows of Matrix
+	struct alignas(16) Vector4
 	{
-		float x;
-		float y;
-		float z;
-		float w;
+		float x{};
+		float y{};
+		float z{};
+		float w{};
 
 		Vector4() = default;
-		Vector4(float _x, float _y, float _z, float _w);
-		Vector4(const Vector3& v, float _w);
+		constexpr Vector4(float _x, float _y, float _z, float _w);
+		constexpr Vector4(const Vector3& v, float _w);
 
 		float Magnitude() const;
-		float SqrMagnitude() const;
+		constexpr float SqrMagnitude() const;
 		float Normalize();
 		Vector4 Normalized() const;
 
-		Vector2 GetXY() const;
-		Vector3 GetXYZ() const;
+		constexpr Vector2 GetXY() const;
+		constexpr Vector3 GetXYZ() const;
+
+		static constexpr float Dot(const Vector4& v1, const Vector4& v2);
 
-		static float Dot(const Vector4& v1, const Vector4& v2);
+#if RASTERIZER_SIMD_SSE
+		__m128 Load() const { return _mm_load_ps(&x); }
+		static Vector4 Store(__m128 v);
+#endif
 
 		// operator overloading
-		Vector4 operator*(float scale) const;
-		Vector4 operator+(const Vector4& v) const;
-		Vector4 operator-(const Vector4& v) const;
-		Vector4& operator+=(const Vector4& v);
-		float& operator[](int index);
-		float operator[](int index) const;
+		constexpr Vector4 operator*(float scale) const;
+		constexpr Vector4 operator+(const Vector4& v) const;
+		constexpr Vector4 operator-(const Vector4& v) const;
+		constexpr Vector4& operator+=(const Vector4& v);
+		constexpr float& operator[](int index);
+		constexpr float operator[](int index) const;
+		constexpr bool operator==(const Vector4& v) const;
 	};
+
+	constexpr Vector4::Vector4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+	constexpr Vector4::Vector4(const Vector3& v, float _w) : x(v.x), y(v.y), z(v.z), w(_w) {}
+
+#if RASTERIZER_SIMD_SSE
+	inline Vector4 Vector4::Store(__m128 v)
+	{
+		Vector4 result;
+		_mm_store_ps(&result.x, v);
+		return result;
+	}
+#endif
+
+	inline float Vector4::Magnitude() const
+	{
+		return sqrtf(SqrMagnitude());
+	}
+
+	constexpr float Vector4::SqrMagnitude() const
+	{
+		return Dot(*this, *this);
+	}
+
+	inline float Vector4::Normalize()
+	{
+		const float m = Magnitude();
+		x /= m;
+		y /= m;
+		z /= m;
+		w /= m;
+
+		return m;
+	}
+
+	inline Vector4 Vector4::Normalized() const
+	{
+		const float m = Magnitude();
+		return { x / m, y / m, z / m, w / m };
+	}
+
+	constexpr Vector2 Vector4::GetXY() const
+	{
+		return { x, y };
+	}
+
+	constexpr Vector3 Vector4::GetXYZ() const
+	{
+		return { x,y,z };
+	}
+
+	constexpr float Vector4::Dot(const Vector4& v1, const Vector4& v2)
+	{
+#if RASTERIZER_SIMD_SSE
+		if (!std::is_constant_evaluated())
+		{
+			return Simd::HorizontalAdd(_mm_mul_ps(v1.Load(), v2.Load()));
+		}
+#endif
+		return v1.x * v2.x + v1.y * v2.y + v1.z  * v2.z + v1.w * v2.w;
+	}
+
+#pragma region Operator Overloads
+	constexpr Vector4 Vector4::operator*(float scale) const
+	{
+#if RASTERIZER_SIMD_SSE
+		if (!std::is_constant_evaluated())
+		{
+			return Store(_mm_mul_ps(Load(), _mm_set1_ps(scale)));
+		}
+#endif
+		return { x * scale, y * scale, z * scale, w * scale };
+	}
+
+	constexpr Vector4 Vector4::operator+(const Vector4& v) const
+	{
+#if RASTERIZER_SIMD_SSE
+		if (!std::is_constant_evaluated())
+		{
+			return Store(_mm_add_ps(Load(), v.Load()));
+		}
+#endif
+		return { x + v.x, y + v.y, z + v.z, w + v.w };
+	}
+
+	constexpr Vector4 Vector4::operator-(const Vector4& v) const
+	{
+#if RASTERIZER_SIMD_SSE
+		if (!std::is_constant_evaluated())
+		{
+			return Store(_mm_sub_ps(Load(), v.Load()));
+		}
+#endif
+		return { x - v.x, y - v.y, z - v.z, w - v.w };
+	}
+
+	constexpr Vector4& Vector4::operator+=(const Vector4& v)
+	{
+		*this = *this + v;
+		return *this;
+	}
+
+	constexpr float& Vector4::operator[](int index)
+	{
+		assert(index <= 3 && index >= 0);
+
+		if (index == 0)return x;
+		if (index == 1)return y;
+		if (index == 2)return z;
+		return w;
+	}
+
+	constexpr float Vector4::operator[](int index) const
+	{
+		assert(index <= 3 && index >= 0);
+
+		if (index == 0)return x;
+		if (index == 1)return y;
+		if (index == 2)return z;
+		return w;
+	}
+
+	constexpr bool Vector4::operator==(const Vector4& v) const
+	{
+		return x == v.x && y == v.y && z == v.z && w == v.w;
+	}
+#pragma endregion
+
+#pragma region Vector3 Conversions
+	constexpr Vector3::Vector3(const Vector4& v) : x(v.x), y(v.y), z(v.z) {}
+
+	constexpr Vector4 Vector3::ToPoint4() const
+	{
+		return { x, y, z, 1 };
+	}
+
+	constexpr Vector4 Vector3::ToVector4() const
+	{
+		return { x, y, z, 0 };
+	}
+#pragma endregion
 }
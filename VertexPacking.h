@@ -0,0 +1,133 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "Vector2.h"
+#include "Vector3.h"
+
+namespace dae::VertexPacking
+{
+	//IEEE half precision, rounded to nearest even. Overflow saturates to infinity
+	inline uint16_t FloatToHalf(float value)
+	{
+		uint32_t bits{};
+		std::memcpy(&bits, &value, sizeof(bits));
+		const uint32_t sign{ (bits >> 16) & 0x8000u };
+		const uint32_t absBits{ bits & 0x7FFFFFFFu };
+
+		//NaN and infinity
+		if (absBits >= 0x7F800000u)
+			return static_cast<uint16_t>(sign | 0x7C00u | (absBits > 0x7F800000u ? 0x200u : 0u));
+		//Rounds up past the largest half (65504)
+		if (absBits >= 0x477FF000u)
+			return static_cast<uint16_t>(sign | 0x7C00u);
+
+		//Normal: rebias the exponent, a rounding carry ripples into it correctly
+		if (absBits >= 0x38800000u)
+		{
+			const uint32_t rounded{ absBits + 0x0FFFu + ((absBits >> 13) & 1u) };
+			return static_cast<uint16_t>(sign | ((rounded - 0x38000000u) >> 13));
+		}
+
+		//Below half the smallest subnormal
+		if (absBits < 0x33000000u)
+			return static_cast<uint16_t>(sign);
+
+		//Subnormal: mantissa * 2^-24
+		const uint32_t shift{ 126u - (absBits >> 23) };
+		const uint32_t mantissa{ (absBits & 0x7FFFFFu) | 0x800000u };
+		const uint32_t remainder{ mantissa & ((1u << shift) - 1u) };
+		const uint32_t halfway{ 1u << (shift - 1u) };
+		uint32_t half{ mantissa >> shift };
+		if (remainder > halfway || (remainder == halfway && (half & 1u)))
+			++half;
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	inline float HalfToFloat(uint16_t half)
+	{
+		const uint32_t sign{ static_cast<uint32_t>(half & 0x8000u) << 16 };
+		const uint32_t exponent{ (half >> 10) & 0x1Fu };
+		const uint32_t mantissa{ half & 0x3FFu };
+
+		if (exponent == 0)
+		{
+			const float value{ static_cast<float>(mantissa) * 0x1p-24f };
+			return sign ? -value : value;
+		}
+
+		uint32_t bits{};
+		if (exponent == 0x1F)
+			bits = sign | 0x7F800000u | (mantissa << 13);
+		else
+			bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+
+		float value{};
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	//Two halves, x in the low 16 bits
+	inline uint32_t PackHalf2(const Vector2& value)
+	{
+		return static_cast<uint32_t>(FloatToHalf(value.x)) | static_cast<uint32_t>(FloatToHalf(value.y)) << 16;
+	}
+
+	inline Vector2 UnpackHalf2(uint32_t packed)
+	{
+		return { HalfToFloat(static_cast<uint16_t>(packed & 0xFFFFu)), HalfToFloat(static_cast<uint16_t>(packed >> 16)) };
+	}
+
+	inline float SignNotZero(float value)
+	{
+		return value < 0.f ? -1.f : 1.f;
+	}
+
+	//Octahedral mapping of a direction to two snorm16 values, x in the low 16 bits.
+	//The error is below 0.01 degree, a zero vector encodes as +Z
+	inline uint32_t EncodeOctahedral(const Vector3& direction)
+	{
+		const float l1Norm{ std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z) };
+		if (l1Norm <= 0.f)
+			return 0;
+
+		const float invL1Norm{ 1.f / l1Norm };
+		float x{ direction.x * invL1Norm };
+		float y{ direction.y * invL1Norm };
+		//Fold the lower hemisphere over the diagonals
+		if (direction.z < 0.f)
+		{
+			const float foldedX{ (1.f - std::abs(y)) * SignNotZero(x) };
+			y = (1.f - std::abs(x)) * SignNotZero(y);
+			x = foldedX;
+		}
+
+		const auto toSnorm16 = [](float value)
+		{
+			const float clamped{ value < -1.f ? -1.f : (value > 1.f ? 1.f : value) };
+			//Round half away from zero
+			const float scaled{ clamped * 32767.f + (clamped < 0.f ? -0.5f : 0.5f) };
+			return static_cast<uint32_t>(static_cast<uint16_t>(static_cast<int16_t>(scaled)));
+		};
+		return toSnorm16(x) | toSnorm16(y) << 16;
+	}
+
+	//Returns a unit vector
+	inline Vector3 DecodeOctahedral(uint32_t packed)
+	{
+		constexpr float snormScale{ 1.f / 32767.f };
+		float x{ static_cast<float>(static_cast<int16_t>(packed & 0xFFFFu)) * snormScale };
+		float y{ static_cast<float>(static_cast<int16_t>(packed >> 16)) * snormScale };
+		const float z{ 1.f - std::abs(x) - std::abs(y) };
+		if (z < 0.f)
+		{
+			const float unfoldedX{ (1.f - std::abs(y)) * SignNotZero(x) };
+			y = (1.f - std::abs(x)) * SignNotZero(y);
+			x = unfoldedX;
+		}
+
+		const float invLength{ 1.f / std::sqrt(x * x + y * y + z * z) };
+		return { x * invLength, y * invLength, z * invLength };
+	}
+}
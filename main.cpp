@@ -1,15 +1,31 @@
 //External includes
+#if defined(_WIN32)
 #include "vld.h"
+#endif
 #include "SDL.h"
 #include "SDL_surface.h"
 #undef main
 
 //Standard includes
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
 
 //Project includes
 #include "Timer.h"
+#include "AllocationCounter.h"
+#include "Benchmark.h"
+#include "CameraPath.h"
+#include "MathBenchmark.h"
+#include "Model.h"
 #include "Renderer.h"
+#include "Trace.h"
 
 using namespace dae;
 
@@ -19,11 +35,605 @@ void ShutDown(SDL_Window* pWindow)
 	SDL_Quit();
 }
 
+struct HeadlessSettings
+{
+	int width{ 640 };
+	int height{ 480 };
+	int nrFrames{ 1 };
+	ImageFormat format{ ImageFormat::PPM };
+	std::string outputPrefix{ "frame" };
+	bool isMeshRotating{ false };
+	bool isWritingFrames{ true };
+	bool isPrintingStats{ false };
+	std::string traceFile{};
+	Renderer::RenderMode renderMode{ Renderer::RenderMode::Normal };
+	int nrViews{ 0 };
+	int nrThreads{ static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) };
+	int nrWorkers{ 0 };			//Job system workers of one renderer, 0 uses the default
+	bool isPinningWorkers{ false };
+	VertexFormat vertexFormat{ VertexFormat::Float };
+	int nrInstances{ 1 };
+	bool isOcclusionCulling{ true };
+	float lodPixelError{ 1.f };
+	bool isSortingDraws{ true };
+	float renderScale{ 1.f };
+	UpscaleFilter upscaleFilter{ UpscaleFilter::Bilinear };
+	int maxShadingRate{ 1 };
+	bool isCheckerboard{ false };
+	bool isMaterialAtlas{ false };
+	bool isMultisampling{ false };
+	int nrLocalLights{ 0 };
+};
+
+struct ViewerSettings
+{
+	bool isDynamicResolution{ true };
+	DynamicResolutionSettings dynamicResolution{};
+};
+
+void PrintPipelineStats(const Renderer& renderer)
+{
+	//A reused frame did no work, it only presented the previous image again
+	if (renderer.WasFrameReused())
+	{
+		std::cout << "Nothing changed, the last frame was presented again" << std::endl;
+		return;
+	}
+
+	const PipelineStats& stats{ renderer.GetPipelineStats() };
+	std::cout << "Instances: " << stats.instancesDrawn << " drawn, " << stats.instancesCulledFrustum << " outside frustum, "
+		<< stats.instancesCulledOcclusion << " occluded\n"
+		<< "LOD: " << stats.instancesReducedLod << " instances simplified, " << stats.trianglesSavedLod << " triangles left out\n"
+		<< "Clusters: " << stats.clustersDrawn << " drawn, " << stats.clustersCulledFrustum << " outside frustum, "
+		<< stats.clustersCulledOcclusion << " occluded\n"
+		<< "Vertices: " << stats.verticesTransformed << " transformed\n"
+		<< "Triangles: " << stats.trianglesSubmitted << " submitted, "
+		<< stats.trianglesCulledDegenerate << " degenerate, "
+		<< stats.trianglesCulledFrustum << " outside frustum, "
+		<< stats.trianglesCulledArea << " back facing/zero area, "
+		<< stats.trianglesCulledNoSample << " no sample, "
+		<< stats.trianglesRasterized << " rasterized\n"
+		<< "Raster paths: " << stats.trianglesSmall << " small, "
+		<< stats.trianglesSpan << " span, "
+		<< stats.trianglesRasterized - stats.trianglesSmall - stats.trianglesSpan << " bounding box\n"
+		<< "Pixels: " << stats.pixelsTested << " tested, "
+		<< stats.pixelsCovered << " covered, "
+		<< stats.pixelsDepthRejected << " depth rejected, "
+		<< stats.pixelsShaded << " shaded";
+	if (stats.pixelsShadedUnique)
+		std::cout << " (overdraw " << stats.GetOverdraw() << ")";
+	if (stats.trianglesCoarseShaded)
+		std::cout << "\nCoarse shading: " << stats.trianglesCoarseShaded << " triangles, "
+			<< stats.pixelsShadeReused << " pixels reused the shade of their block";
+	if (renderer.IsCheckerboard())
+		std::cout << "\nCheckerboard: " << stats.pixelsReprojected << " pixels reprojected, "
+			<< stats.pixelsInterpolated << " interpolated";
+	if (renderer.IsMaterialAtlas())
+		std::cout << "\nMaterial atlas: " << stats.shadesFromMaterialAtlas << " shades read the atlas";
+	if (renderer.IsMultisampling())
+		std::cout << "\nMSAA: " << stats.pixelsMultisampled << " pixels resolved from their samples";
+	if (stats.tileLightsTested)
+		std::cout << "\nLights: " << stats.lightsLocalVisible << " local lights visible, " << stats.tileLightsKept << " of "
+			<< stats.tileLightsTested << " tested against the tiles kept";
+	std::cout << "\nMemory: " << stats.arenaBytes << " arena bytes";
+	if (AllocationCounter::IsCompiledIn())
+		std::cout << ", " << stats.heapAllocations << " heap allocations";
+	std::cout << std::endl;
+}
+
+void BeginTrace(const std::string& traceFile)
+{
+	if (traceFile.empty())
+		return;
+
+	TRACE_THREAD_NAME("Main");
+	Trace::BeginCapture();
+}
+
+void EndTrace(const std::string& traceFile)
+{
+	if (traceFile.empty())
+		return;
+
+	//stderr, the benchmark report can be on stdout
+	if (!Trace::IsCompiledIn())
+		std::cerr << "Tracing is not compiled in, define RASTERIZER_TRACE to record zones" << std::endl;
+
+	Trace::EndCapture();
+	if (Trace::WriteChromeJson(traceFile))
+		std::cerr << "Trace written to " << traceFile << std::endl;
+	else
+		std::cerr << "Could not write " << traceFile << std::endl;
+}
+
+void PrintUsage()
+{
+	std::cout << "Usage: Rasterizer [--viewer [options] | --headless [options] | --benchmark [options] | --mathbench [options]]\n"
+		<< "Viewer options:\n"
+		<< "  --budget <ms>         Frame time the dynamic resolution holds (default 16.7)\n"
+		<< "  --min-scale <s>       Smallest render scale per axis (default 0.5)\n"
+		<< "  --max-scale <s>       Largest render scale per axis (default 1)\n"
+		<< "  --upscale bilinear|edge  Filter that scales the frame up to the window (default bilinear)\n"
+		<< "  --fixed-resolution    Always render at the window size (F12 toggles)\n"
+		<< "Headless options:\n"
+		<< "  --width <px>          Render target width (default 640)\n"
+		<< "  --height <px>         Render target height (default 480)\n"
+		<< "  --frames <n>          Number of frames to render (default 1)\n"
+		<< "  --format raw|ppm|png  Output format (default ppm)\n"
+		<< "  --output <prefix>     Output file prefix (default frame)\n"
+		<< "  --rotate              Rotate the mesh at a fixed 60Hz step\n"
+		<< "  --no-output           Render without writing any files\n"
+		<< "  --overdraw            Render the overdraw heat map instead of the shaded mesh\n"
+		<< "  --stats               Print the pipeline statistics of the last frame\n"
+		<< "  --trace <file>        Write a chrome://tracing timeline (needs RASTERIZER_TRACE)\n"
+		<< "  --views <n>           Render a turntable of n views around the mesh instead of frames\n"
+		<< "  --threads <n>         Threads used for --views (default: hardware threads)\n"
+		<< "  --workers <n>         Job system workers per frame (default: hardware threads, 1 per view for --views)\n"
+		<< "  --pin                 Pin the job system workers to hardware threads\n"
+		<< "  --compact             Load the mesh in the compact quantized vertex format\n"
+		<< "  --instances <n>       Draw n instances of the mesh on a grid (default 1)\n"
+		<< "  --no-occlusion        Disable occlusion culling\n"
+		<< "  --lod-error <px>      Screen error allowed for simplified meshes (default 1, 0 = full detail)\n"
+		<< "  --no-sort             Submit the draws in scene order instead of front to back\n"
+		<< "  --scale <s>           Render at this scale per axis and upscale to the output size (default 1)\n"
+		<< "  --upscale bilinear|edge  Filter used below scale 1 (default bilinear)\n"
+		<< "  --shading-rate 1|2|4  Shade blocks of up to this many pixels per axis once where detail allows (default 1)\n"
+		<< "  --checkerboard        Shade half of the pixels per frame, the rest is reprojected from the last frame\n"
+		<< "  --material-atlas      Read the shading inputs from a texture space atlas built once per model\n"
+		<< "  --msaa                4x multisample anti-aliasing, shaded once per pixel\n"
+		<< "  --lights <n>          Add n point and spot lights over the instances, culled per tile (default 0)\n"
+		<< "Benchmark options:\n"
+		<< "  --width <px>          Render target width (default 1280)\n"
+		<< "  --height <px>         Render target height (default 720)\n"
+		<< "  --frames <n>          Measured frames (default 300)\n"
+		<< "  --warmup <n>          Unmeasured warmup frames (default 30)\n"
+		<< "  --path <file>         Recorded camera path (F8 in the viewer), default path otherwise\n"
+		<< "  --report <file>       JSON report file, stdout otherwise\n"
+		<< "  --overdraw            Track overdraw (adds a small cost per frame)\n"
+		<< "  --trace <file>        Write a chrome://tracing timeline of the measured frames (needs RASTERIZER_TRACE)\n"
+		<< "  --workers <n>         Job system workers (default: hardware threads)\n"
+		<< "  --pin                 Pin the job system workers to hardware threads\n"
+		<< "  --compact             Load the mesh in the compact quantized vertex format\n"
+		<< "  --instances <n>       Draw n instances of the mesh on a grid (default 1)\n"
+		<< "  --no-occlusion        Disable occlusion culling\n"
+		<< "  --lod-error <px>      Screen error allowed for simplified meshes (default 1, 0 = full detail)\n"
+		<< "  --no-sort             Submit the draws in scene order instead of front to back\n"
+		<< "                        (--overdraw also reports the overdraw of the other order)\n"
+		<< "  --budget <ms>         Dynamic resolution: hold this frame time, off by default\n"
+		<< "  --min-scale <s>       Dynamic resolution: smallest render scale per axis (default 0.5)\n"
+		<< "  --max-scale <s>       Dynamic resolution: largest render scale per axis (default 1)\n"
+		<< "  --upscale bilinear|edge  Dynamic resolution: upscale filter (default bilinear)\n"
+		<< "  --shading-rate 1|2|4  Shade blocks of up to this many pixels per axis once where detail allows (default 1)\n"
+		<< "  --checkerboard        Shade half of the pixels per frame, also reports the PSNR against a full render\n"
+		<< "  --material-atlas      Read the shading inputs from a texture space atlas built once per model\n"
+		<< "  --msaa                4x multisample anti-aliasing, shaded once per pixel\n"
+		<< "  --lights <n>          Add n point and spot lights over the instances, culled per tile (default 0)\n"
+		<< "Math benchmark options:\n"
+		<< "  --iterations <n>      Passes per kernel (default 200)\n"
+		<< "  --elements <n>        Operands per pass (default 4096)\n";
+}
+
+bool ParseUpscaleFilter(const std::string& name, UpscaleFilter& filter)
+{
+	if (name == "bilinear")
+		filter = UpscaleFilter::Bilinear;
+	else if (name == "edge")
+		filter = UpscaleFilter::EdgeAware;
+	else
+		return false;
+	return true;
+}
+
+bool IsValidShadingRate(int rate)
+{
+	return rate == 1 || rate == 2 || rate == 4;
+}
+
+bool IsValid(const DynamicResolutionSettings& settings)
+{
+	return settings.frameBudgetMs > 0.f && settings.minScale > 0.f && settings.minScale <= settings.maxScale && settings.maxScale <= 1.f;
+}
+
+bool ParseViewerSettings(int argc, char* args[], ViewerSettings& settings)
+{
+	for (int i{ 2 }; i < argc; ++i)
+	{
+		const std::string arg{ args[i] };
+		if (arg == "--fixed-resolution")
+		{
+			settings.isDynamicResolution = false;
+			continue;
+		}
+		if (i + 1 >= argc)
+			return false;
+
+		if (arg == "--budget")
+			settings.dynamicResolution.frameBudgetMs = static_cast<float>(std::atof(args[++i]));
+		else if (arg == "--min-scale")
+			settings.dynamicResolution.minScale = static_cast<float>(std::atof(args[++i]));
+		else if (arg == "--max-scale")
+			settings.dynamicResolution.maxScale = static_cast<float>(std::atof(args[++i]));
+		else if (arg == "--upscale")
+		{
+			if (!ParseUpscaleFilter(args[++i], settings.dynamicResolution.upscaleFilter))
+				return false;
+		}
+		else return false;
+	}
+
+	return IsValid(settings.dynamicResolution);
+}
+
+bool ParseHeadlessSettings(int argc, char* args[], HeadlessSettings& settings)
+{
+	for (int i{ 2 }; i < argc; ++i)
+	{
+		const std::string arg{ args[i] };
+		const bool hasValue{ i + 1 < argc };
+
+		if (arg == "--width" && hasValue)
+			settings.width = std::atoi(args[++i]);
+		else if (arg == "--height" && hasValue)
+			settings.height = std::atoi(args[++i]);
+		else if (arg == "--frames" && hasValue)
+			settings.nrFrames = std::atoi(args[++i]);
+		else if (arg == "--output" && hasValue)
+			settings.outputPrefix = args[++i];
+		else if (arg == "--rotate")
+			settings.isMeshRotating = true;
+		else if (arg == "--no-output")
+			settings.isWritingFrames = false;
+		else if (arg == "--overdraw")
+			settings.renderMode = Renderer::RenderMode::Overdraw;
+		else if (arg == "--stats")
+			settings.isPrintingStats = true;
+		else if (arg == "--trace" && hasValue)
+			settings.traceFile = args[++i];
+		else if (arg == "--views" && hasValue)
+			settings.nrViews = std::atoi(args[++i]);
+		else if (arg == "--threads" && hasValue)
+			settings.nrThreads = std::atoi(args[++i]);
+		else if (arg == "--workers" && hasValue)
+			settings.nrWorkers = std::atoi(args[++i]);
+		else if (arg == "--pin")
+			settings.isPinningWorkers = true;
+		else if (arg == "--compact")
+			settings.vertexFormat = VertexFormat::Compact;
+		else if (arg == "--instances" && hasValue)
+			settings.nrInstances = std::atoi(args[++i]);
+		else if (arg == "--no-occlusion")
+			settings.isOcclusionCulling = false;
+		else if (arg == "--no-sort")
+			settings.isSortingDraws = false;
+		else if (arg == "--checkerboard")
+			settings.isCheckerboard = true;
+		else if (arg == "--material-atlas")
+			settings.isMaterialAtlas = true;
+		else if (arg == "--msaa")
+			settings.isMultisampling = true;
+		else if (arg == "--lights" && hasValue)
+			settings.nrLocalLights = std::atoi(args[++i]);
+		else if (arg == "--shading-rate" && hasValue)
+			settings.maxShadingRate = std::atoi(args[++i]);
+		else if (arg == "--scale" && hasValue)
+			settings.renderScale = static_cast<float>(std::atof(args[++i]));
+		else if (arg == "--upscale" && hasValue)
+		{
+			if (!ParseUpscaleFilter(args[++i], settings.upscaleFilter))
+				return false;
+		}
+		else if (arg == "--lod-error" && hasValue)
+			settings.lodPixelError = static_cast<float>(std::atof(args[++i]));
+		else if (arg == "--format" && hasValue)
+		{
+			const std::string format{ args[++i] };
+			if (format == "raw") settings.format = ImageFormat::Raw;
+			else if (format == "ppm") settings.format = ImageFormat::PPM;
+			else if (format == "png") settings.format = ImageFormat::PNG;
+			else return false;
+		}
+		else return false;
+	}
+
+	return settings.width > 0 && settings.height > 0 && settings.nrFrames > 0 && settings.nrViews >= 0 && settings.nrThreads > 0 && settings.nrWorkers >= 0 && settings.nrInstances > 0 && settings.lodPixelError >= 0.f
+		&& settings.nrLocalLights >= 0 && settings.renderScale > 0.f && settings.renderScale <= 1.f && IsValidShadingRate(settings.maxShadingRate);
+}
+
+bool ParseBenchmarkSettings(int argc, char* args[], BenchmarkSettings& settings)
+{
+	for (int i{ 2 }; i < argc; ++i)
+	{
+		const std::string arg{ args[i] };
+		if (arg == "--overdraw")
+		{
+			settings.isTrackingOverdraw = true;
+			continue;
+		}
+		if (arg == "--pin")
+		{
+			settings.isPinningWorkers = true;
+			continue;
+		}
+		if (arg == "--compact")
+		{
+			settings.vertexFormat = VertexFormat::Compact;
+			continue;
+		}
+		if (arg == "--no-occlusion")
+		{
+			settings.isOcclusionCulling = false;
+			continue;
+		}
+		if (arg == "--no-sort")
+		{
+			settings.isSortingDraws = false;
+			continue;
+		}
+		if (arg == "--checkerboard")
+		{
+			settings.isCheckerboard = true;
+			continue;
+		}
+		if (arg == "--material-atlas")
+		{
+			settings.isMaterialAtlas = true;
+			continue;
+		}
+		if (arg == "--msaa")
+		{
+			settings.isMultisampling = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+			return false;
+
+		if (arg == "--width")
+			settings.width = std::atoi(args[++i]);
+		else if (arg == "--height")
+			settings.height = std::atoi(args[++i]);
+		else if (arg == "--frames")
+			settings.nrFrames = std::atoi(args[++i]);
+		else if (arg == "--warmup")
+			settings.nrWarmupFrames = std::atoi(args[++i]);
+		else if (arg == "--path")
+			settings.pathFile = args[++i];
+		else if (arg == "--report")
+			settings.reportFile = args[++i];
+		else if (arg == "--trace")
+			settings.traceFile = args[++i];
+		else if (arg == "--workers")
+			settings.nrWorkers = std::atoi(args[++i]);
+		else if (arg == "--instances")
+			settings.nrInstances = std::atoi(args[++i]);
+		else if (arg == "--lights")
+			settings.nrLocalLights = std::atoi(args[++i]);
+		else if (arg == "--lod-error")
+			settings.lodPixelError = static_cast<float>(std::atof(args[++i]));
+		else if (arg == "--shading-rate")
+			settings.maxShadingRate = std::atoi(args[++i]);
+		else if (arg == "--budget")
+		{
+			settings.dynamicResolution.frameBudgetMs = static_cast<float>(std::atof(args[++i]));
+			settings.isDynamicResolution = true;
+		}
+		else if (arg == "--min-scale")
+			settings.dynamicResolution.minScale = static_cast<float>(std::atof(args[++i]));
+		else if (arg == "--max-scale")
+			settings.dynamicResolution.maxScale = static_cast<float>(std::atof(args[++i]));
+		else if (arg == "--upscale")
+		{
+			if (!ParseUpscaleFilter(args[++i], settings.dynamicResolution.upscaleFilter))
+				return false;
+		}
+		else return false;
+	}
+
+	return settings.width > 0 && settings.height > 0 && settings.nrFrames > 0 && settings.nrWarmupFrames >= 0 && settings.nrWorkers >= 0 && settings.nrInstances > 0 && settings.lodPixelError >= 0.f
+		&& settings.nrLocalLights >= 0 && IsValid(settings.dynamicResolution) && IsValidShadingRate(settings.maxShadingRate);
+}
+
+int RunBenchmark(const BenchmarkSettings& settings)
+{
+	Benchmark benchmark{ settings };
+	if (!benchmark.Run())
+		return 1;
+	EndTrace(settings.traceFile);
+
+	if (settings.reportFile.empty())
+	{
+		benchmark.WriteReport(std::cout);
+		return 0;
+	}
+
+	std::ofstream report{ settings.reportFile };
+	benchmark.WriteReport(report);
+	return report.good() ? 0 : 1;
+}
+
+bool ParseMathBenchmarkSettings(int argc, char* args[], MathBenchmarkSettings& settings)
+{
+	for (int i{ 2 }; i < argc; ++i)
+	{
+		const std::string arg{ args[i] };
+		if (i + 1 >= argc)
+			return false;
+
+		if (arg == "--iterations")
+			settings.nrIterations = std::atoi(args[++i]);
+		else if (arg == "--elements")
+			settings.nrElements = std::atoi(args[++i]);
+		else return false;
+	}
+
+	return settings.nrIterations > 0 && settings.nrElements > 0;
+}
+
+int RunMathBenchmark(const MathBenchmarkSettings& settings)
+{
+	MathBenchmark benchmark{ settings };
+	benchmark.Run();
+	benchmark.WriteReport(std::cout);
+	return 0;
+}
+
+const char* GetExtension(ImageFormat format)
+{
+	switch (format)
+	{
+	case ImageFormat::Raw: return "raw";
+	case ImageFormat::PPM: return "ppm";
+	default: return "png";
+	}
+}
+
+int RunTurntable(const HeadlessSettings& settings)
+{
+	//Load the assets once, every thread renders its views with its own renderer (camera, buffers, transformed vertices)
+	const std::shared_ptr<const Model> pModel{ Model::LoadVehicle(settings.vertexFormat) };
+	if (!pModel)
+		return 1;
+
+	const int nrThreads{ std::min(settings.nrThreads, settings.nrViews) };
+	std::atomic<int> nextView{ 0 };
+	std::atomic<int> nrFailedViews{ 0 };
+
+	const auto renderViews = [&]()
+	{
+		TRACE_THREAD_NAME("View worker");
+		Renderer renderer{ pModel, settings.width, settings.height };
+		//The views already run in parallel
+		renderer.SetNrWorkers(std::max(settings.nrWorkers, 1), settings.isPinningWorkers);
+		renderer.SetRenderMode(settings.renderMode);
+		renderer.SetMaterialAtlas(settings.isMaterialAtlas);
+		renderer.SetMultisampling(settings.isMultisampling);
+		renderer.SetLocalLights(settings.nrLocalLights);
+		CameraKey key{ renderer.GetCameraKey() };
+
+		for (int view{ nextView++ }; view < settings.nrViews; view = nextView++)
+		{
+			key.meshYaw = PI_2 * static_cast<float>(view) / static_cast<float>(settings.nrViews);
+			renderer.ApplyCameraKey(key);
+			renderer.Advance(0.f);
+			renderer.Render();
+
+			if (!settings.isWritingFrames)
+				continue;
+
+			char fileName[512]{};
+			std::snprintf(fileName, sizeof(fileName), "%s_view_%04d.%s", settings.outputPrefix.c_str(), view, GetExtension(settings.format));
+			if (!renderer.SaveBufferToFile(fileName, settings.format))
+				++nrFailedViews;
+		}
+	};
+
+	BeginTrace(settings.traceFile);
+	Timer timer{};
+	timer.Start();
+
+	std::vector<std::thread> threads{};
+	threads.reserve(nrThreads);
+	for (int i{}; i < nrThreads; ++i)
+		threads.emplace_back(renderViews);
+	for (std::thread& thread : threads)
+		thread.join();
+
+	timer.Update();
+	timer.Stop();
+	EndTrace(settings.traceFile);
+
+	std::cout << "Rendered " << settings.nrViews << " views at " << settings.width << "x" << settings.height
+		<< " on " << nrThreads << " threads in " << timer.GetTotal() << "s" << std::endl;
+
+	if (nrFailedViews > 0)
+	{
+		std::cout << nrFailedViews << " views could not be written" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int RunHeadless(const HeadlessSettings& settings)
+{
+	//No SDL_Init: the renderer only needs memory surfaces and the image loader
+	BeginTrace(settings.traceFile);
+	const auto pTimer = new Timer();
+	const auto pRenderer = new Renderer(settings.width, settings.height, settings.vertexFormat);
+	if (settings.nrInstances > 1)
+		pRenderer->SetInstanceGrid(settings.nrInstances);
+	pRenderer->SetOcclusionCulling(settings.isOcclusionCulling);
+	pRenderer->SetLodPixelError(settings.lodPixelError);
+	pRenderer->SetDrawSorting(settings.isSortingDraws);
+	pRenderer->SetMaxShadingRate(settings.maxShadingRate);
+	pRenderer->SetCheckerboard(settings.isCheckerboard);
+	pRenderer->SetMaterialAtlas(settings.isMaterialAtlas);
+	pRenderer->SetMultisampling(settings.isMultisampling);
+	pRenderer->SetLocalLights(settings.nrLocalLights);
+	pRenderer->SetUpscaleFilter(settings.upscaleFilter);
+	pRenderer->SetRenderScale(settings.renderScale);
+	if (settings.isMeshRotating)
+		pRenderer->ToggleMeshRotation();
+	pRenderer->SetRenderMode(settings.renderMode);
+	if (settings.nrWorkers > 0 || settings.isPinningWorkers)
+		pRenderer->SetNrWorkers(settings.nrWorkers > 0 ? settings.nrWorkers : pRenderer->GetNrWorkers(), settings.isPinningWorkers);
+
+	const char* extension{ GetExtension(settings.format) };
+	constexpr float fixedElapsedSec{ 1.f / 60.f };
+
+	int result{ 0 };
+	pTimer->Start();
+	for (int frame{}; frame < settings.nrFrames; ++frame)
+	{
+		pRenderer->Advance(fixedElapsedSec);
+		pRenderer->Render();
+
+		if (!settings.isWritingFrames)
+			continue;
+
+		char fileName[512]{};
+		std::snprintf(fileName, sizeof(fileName), "%s_%04d.%s", settings.outputPrefix.c_str(), frame, extension);
+		if (!pRenderer->SaveBufferToFile(fileName, settings.format))
+		{
+			std::cout << "Could not write " << fileName << std::endl;
+			result = 1;
+			break;
+		}
+	}
+	pTimer->Update();
+	pTimer->Stop();
+
+	std::cout << "Rendered " << settings.nrFrames << " frames at " << settings.width << "x" << settings.height
+		<< " in " << pTimer->GetTotal() << "s" << std::endl;
+	if (settings.isPrintingStats)
+		PrintPipelineStats(*pRenderer);
+	EndTrace(settings.traceFile);
+
+	delete pRenderer;
+	delete pTimer;
+	return result;
+}
+
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	//No arguments opens the viewer with its defaults
+	ViewerSettings viewerSettings{};
+	const bool isViewer{ argc == 1 || (std::strcmp(args[1], "--viewer") == 0 && ParseViewerSettings(argc, args, viewerSettings)) };
+	if (!isViewer)
+	{
+		HeadlessSettings headlessSettings{};
+		if (std::strcmp(args[1], "--headless") == 0 && ParseHeadlessSettings(argc, args, headlessSettings))
+			return headlessSettings.nrViews > 0 ? RunTurntable(headlessSettings) : RunHeadless(headlessSettings);
+
+		BenchmarkSettings benchmarkSettings{};
+		if (std::strcmp(args[1], "--benchmark") == 0 && ParseBenchmarkSettings(argc, args, benchmarkSettings))
+			return RunBenchmark(benchmarkSettings);
+
+		MathBenchmarkSettings mathBenchmarkSettings{};
+		if (std::strcmp(args[1], "--mathbench") == 0 && ParseMathBenchmarkSettings(argc, args, mathBenchmarkSettings))
+			return RunMathBenchmark(mathBenchmarkSettings);
+
+		PrintUsage();
+		return 1;
+	}
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
@@ -43,12 +653,16 @@ int main(int argc, char* args[])
 	//Initialize "framework"
 	const auto pTimer = new Timer();
 	const auto pRenderer = new Renderer(pWindow);
+	pRenderer->SetDynamicResolution(viewerSettings.dynamicResolution);
+	pRenderer->SetDynamicResolutionEnabled(viewerSettings.isDynamicResolution);
 
 	//Start loop
 	pTimer->Start();
 	float printTimer = 0.f;
 	bool isLooping = true;
 	bool takeScreenshot = false;
+	bool isRecordingPath = false;
+	CameraPath recordedPath{};
 	while (isLooping)
 	{
 		//--------- Get input events ---------
@@ -64,6 +678,16 @@ int main(int argc, char* args[])
 				if (e.key.keysym.scancode == SDL_SCANCODE_X)
 					takeScreenshot = true;
 
+				if (e.key.keysym.scancode == SDL_SCANCODE_M)
+					pRenderer->ToggleMultisampling();
+				if (e.key.keysym.scancode == SDL_SCANCODE_L)
+					pRenderer->ToggleLocalLights();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F1)
+					pRenderer->ToggleMaterialAtlas();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F2)
+					pRenderer->ToggleCheckerboard();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
+					pRenderer->ToggleShadingRate();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F4)
 					pRenderer->ToggleRenderMode();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F5)
@@ -72,6 +696,23 @@ int main(int argc, char* args[])
 					pRenderer->ToggleLightingMode();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
 					pRenderer->ToggleNormalMap();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+					PrintPipelineStats(*pRenderer);
+				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+					pRenderer->ToggleOcclusionCulling();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
+					pRenderer->ToggleDrawSorting();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F12)
+					pRenderer->ToggleDynamicResolution();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+				{
+					//Records one camera key per frame, replay with --benchmark --path CameraPath.txt
+					isRecordingPath = !isRecordingPath;
+					if (isRecordingPath)
+						recordedPath.Clear();
+					else if (recordedPath.SaveToFile("CameraPath.txt"))
+						std::cout << "Camera path saved! (" << recordedPath.GetNrKeys() << " frames)" << std::endl;
+				}
 				break;
 			}
 		}
@@ -81,6 +722,11 @@ int main(int argc, char* args[])
 
 		//--------- Render ---------
 		pRenderer->Render();
+		//Idle: sleep until input arrives instead of spinning on the same frame
+		if (pRenderer->WasFrameReused())
+			SDL_WaitEventTimeout(nullptr, 16);
+		if (isRecordingPath)
+			recordedPath.AddKey(pRenderer->GetCameraKey());
 
 		//--------- Timer ---------
 		pTimer->Update();
@@ -88,7 +734,10 @@ int main(int argc, char* args[])
 		if (printTimer >= 1.f)
 		{
 			printTimer = 0.f;
-			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			std::cout << "dFPS: " << pTimer->GetdFPS();
+			if (pRenderer->IsDynamicResolution())
+				std::cout << " (render scale " << pRenderer->GetRenderScale() << ")";
+			std::cout << std::endl;
 		}
 
 		//Save screenshot after full render